@@ -58,6 +58,20 @@ GearView::GearView(GameData *data, FileCache &cache, QWidget *parent)
             }))
         }
     };
+
+    // the callback above only runs while frames are drawn, so each change has to ask for one
+    for (const auto signal : {&GearView::gearChanged,
+                              &GearView::raceChanged,
+                              &GearView::subraceChanged,
+                              &GearView::genderChanged,
+                              &GearView::levelOfDetailChanged,
+                              &GearView::faceChanged,
+                              &GearView::hairChanged,
+                              &GearView::earChanged,
+                              &GearView::tailChanged}) {
+        connect(this, signal, mdlPart, &MDLPart::requestRender);
+    }
+    connect(this, &GearView::loadingChanged, mdlPart, &MDLPart::requestRender);
 }
 
 std::vector<std::pair<Race, Subrace>> GearView::supportedRaces() const
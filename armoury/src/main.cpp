@@ -9,6 +9,7 @@
 #include "mainwindow.h"
 #include "physis_logger.h"
 #include "settings.h"
+#include "trace.h"
 
 int main(int argc, char *argv[])
 {
@@ -24,6 +25,7 @@ int main(int argc, char *argv[])
     }
 
     setup_physis_logging();
+    setupTracing();
 
     const QString gameDir{getGameDirectory()};
     const std::string gameDirStd{gameDir.toStdString()};
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include "novuscommon_export.h"
+
+/// Starts tracing if the application was run with --trace=<file> or NOVUS_TRACE=<file>, and writes the trace to that file once it quits.
+/// Call this after the QCoreApplication is created.
+NOVUSCOMMON_EXPORT void setupTracing();
+
+/// Starts recording every NOVUS_TRACE_SCOPE, to be written to @p path as a Chrome trace by stopTracing().
+NOVUSCOMMON_EXPORT void startTracing(const QString &path);
+
+/// Stops tracing and writes what was recorded so far. The trace can be opened in chrome://tracing or https://ui.perfetto.dev.
+NOVUSCOMMON_EXPORT void stopTracing();
+
+NOVUSCOMMON_EXPORT bool isTracing();
+
+/// Records the time between its construction and destruction as an event on the current thread, if tracing is enabled.
+/// Use NOVUS_TRACE_SCOPE instead of constructing this directly.
+class NOVUSCOMMON_EXPORT TraceScope
+{
+public:
+    /// @p name has to be a string literal, it's kept as a pointer. @p detail is shown as the event's argument, such as the file being loaded.
+    explicit TraceScope(const char *name, const QString &detail = {});
+    ~TraceScope();
+
+private:
+    const char *m_name = nullptr;
+    QString m_detail;
+    QElapsedTimer m_timer;
+};
+
+#define NOVUS_TRACE_CONCAT_INNER(a, b) a##b
+#define NOVUS_TRACE_CONCAT(a, b) NOVUS_TRACE_CONCAT_INNER(a, b)
+
+/// Traces the rest of the enclosing scope. Takes a string literal name, and optionally a QString detail.
+#define NOVUS_TRACE_SCOPE(...) const TraceScope NOVUS_TRACE_CONCAT(novusTraceScope, __LINE__)(__VA_ARGS__)
@@ -5,6 +5,8 @@
 
 #include <physis.hpp>
 
+#include "trace.h"
+
 FileCache::FileCache(GameData &data)
     : data(data)
 {
@@ -15,6 +17,8 @@ physis_Buffer &FileCache::lookupFile(const QString &path)
     QMutexLocker locker(&bufferMutex);
 
     if (!cachedBuffers.contains(path)) {
+        NOVUS_TRACE_SCOPE("FileCache::lookupFile", path);
+
         std::string pathstd = path.toStdString();
         cachedBuffers[path] = physis_gamedata_extract_file(&data, pathstd.c_str());
     }
@@ -27,6 +31,8 @@ bool FileCache::fileExists(const QString &path)
     QMutexLocker locker(&existMutex);
 
     if (!cachedExist.contains(path)) {
+        NOVUS_TRACE_SCOPE("FileCache::fileExists", path);
+
         std::string pathstd = path.toStdString();
         cachedExist[path] = physis_gamedata_exists(&data, pathstd.c_str());
     }
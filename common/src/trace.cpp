@@ -0,0 +1,183 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace
+{
+struct TraceEvent {
+    const char *name = nullptr;
+    QString detail;
+    // both in nanoseconds, relative to when tracing started
+    qint64 start = 0;
+    qint64 duration = 0;
+};
+
+/// Each thread records into its own list, so the threads don't contend with each other.
+struct ThreadEvents {
+    // only contended while the trace is being written
+    QMutex mutex;
+    int id = 0;
+    QString name;
+    std::vector<TraceEvent> events;
+};
+
+std::atomic_bool tracing = false;
+QElapsedTimer traceClock;
+QString tracePath;
+
+// the lists are never freed, as an event may be recorded by a thread that has already exited by the time the trace is written
+QMutex threadsMutex;
+std::vector<std::unique_ptr<ThreadEvents>> threads;
+thread_local ThreadEvents *currentThreadEvents = nullptr;
+
+ThreadEvents &threadEvents()
+{
+    if (currentThreadEvents == nullptr) {
+        QMutexLocker locker(&threadsMutex);
+
+        auto &events = threads.emplace_back(std::make_unique<ThreadEvents>());
+        events->id = static_cast<int>(threads.size());
+
+        const QThread *thread = QThread::currentThread();
+        if (QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread()) {
+            events->name = QStringLiteral("Main thread");
+        } else if (!thread->objectName().isEmpty()) {
+            events->name = QStringLiteral("%1 %2").arg(thread->objectName()).arg(events->id);
+        } else {
+            events->name = QStringLiteral("Thread %1").arg(events->id);
+        }
+
+        currentThreadEvents = events.get();
+    }
+
+    return *currentThreadEvents;
+}
+}
+
+void setupTracing()
+{
+    QString path = qEnvironmentVariable("NOVUS_TRACE");
+
+    const QStringList arguments = QCoreApplication::arguments();
+    for (const auto &argument : arguments) {
+        if (argument.startsWith(QStringLiteral("--trace="))) {
+            path = argument.mid(8);
+        }
+    }
+
+    if (path.isEmpty()) {
+        return;
+    }
+
+    startTracing(path);
+    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, &stopTracing);
+}
+
+void startTracing(const QString &path)
+{
+    QMutexLocker locker(&threadsMutex);
+
+    tracePath = path;
+    traceClock.start();
+    tracing = true;
+
+    qInfo() << "Tracing to" << path;
+}
+
+void stopTracing()
+{
+    if (!tracing.exchange(false)) {
+        return;
+    }
+
+    QMutexLocker locker(&threadsMutex);
+
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray traceEvents;
+    for (const auto &thread : threads) {
+        QMutexLocker threadLocker(&thread->mutex);
+
+        if (thread->events.empty()) {
+            continue;
+        }
+
+        traceEvents.append(QJsonObject{{QStringLiteral("name"), QStringLiteral("thread_name")},
+                                       {QStringLiteral("ph"), QStringLiteral("M")},
+                                       {QStringLiteral("pid"), pid},
+                                       {QStringLiteral("tid"), thread->id},
+                                       {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), thread->name}}}});
+
+        for (const auto &event : thread->events) {
+            QJsonObject object{{QStringLiteral("name"), QLatin1String(event.name)},
+                               {QStringLiteral("ph"), QStringLiteral("X")},
+                               {QStringLiteral("pid"), pid},
+                               {QStringLiteral("tid"), thread->id},
+                               {QStringLiteral("ts"), event.start / 1000.0},
+                               {QStringLiteral("dur"), event.duration / 1000.0}};
+            if (!event.detail.isEmpty()) {
+                object[QStringLiteral("args")] = QJsonObject{{QStringLiteral("detail"), event.detail}};
+            }
+
+            traceEvents.append(object);
+        }
+
+        thread->events.clear();
+    }
+
+    QFile file(tracePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write the trace to" << tracePath;
+        return;
+    }
+
+    const QJsonObject trace{{QStringLiteral("traceEvents"), traceEvents}, {QStringLiteral("displayTimeUnit"), QStringLiteral("ms")}};
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+
+    qInfo() << "Wrote" << traceEvents.size() << "trace events to" << tracePath;
+}
+
+bool isTracing()
+{
+    return tracing.load(std::memory_order_relaxed);
+}
+
+TraceScope::TraceScope(const char *name, const QString &detail)
+{
+    // the only cost when tracing is off
+    if (!isTracing()) {
+        return;
+    }
+
+    m_name = name;
+    m_detail = detail;
+    m_timer.start();
+}
+
+TraceScope::~TraceScope()
+{
+    if (m_name == nullptr || !isTracing()) {
+        return;
+    }
+
+    const qint64 duration = m_timer.nsecsElapsed();
+    const qint64 end = traceClock.nsecsElapsed();
+
+    ThreadEvents &events = threadEvents();
+
+    QMutexLocker locker(&events.mutex);
+    events.events.push_back({m_name, std::move(m_detail), end - duration, duration});
+}
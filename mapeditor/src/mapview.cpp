@@ -43,7 +43,7 @@ void MapView::addTerrain(QString basePath, physis_Terrain terrain)
                               glm::vec3(terrain.plates[i].position[0], 0.0f, terrain.plates[i].position[1]),
                               QStringLiteral("terapart%1").arg(i),
                               {},
-                              0);
+                              DrawObject::automaticLod);
         }
     }
 }
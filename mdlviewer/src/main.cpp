@@ -9,6 +9,7 @@
 #include "aboutdata.h"
 #include "mainwindow.h"
 #include "settings.h"
+#include "trace.h"
 
 int main(int argc, char *argv[])
 {
@@ -27,6 +28,7 @@ int main(int argc, char *argv[])
     }
 
     setup_physis_logging();
+    setupTracing();
 
     const QString gameDir{getGameDirectory()};
     const std::string gameDirStd{gameDir.toStdString()};
@@ -14,6 +14,8 @@
 #include <QVBoxLayout>
 #include <physis.hpp>
 
+#include "trace.h"
+
 EXDPart::EXDPart(GameData *data, QWidget *parent)
     : QWidget(parent)
     , data(data)
@@ -36,6 +38,8 @@ EXDPart::EXDPart(GameData *data, QWidget *parent)
 
 void EXDPart::loadSheet(const QString &name, physis_Buffer buffer, const QString &definitionPath)
 {
+    NOVUS_TRACE_SCOPE("EXDPart::loadSheet", name);
+
     pageTabWidget->clear();
 
     QFile definitionFile(definitionPath);
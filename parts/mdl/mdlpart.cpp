@@ -15,6 +15,9 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include "filecache.h"
+#include "texturecache.h"
+#include "trace.h"
+#include "uniformring.h"
 #include "vulkanwindow.h"
 
 MDLPart::MDLPart(GameData *data, FileCache &cache, QWidget *parent)
@@ -46,6 +49,13 @@ MDLPart::MDLPart(GameData *data, FileCache &cache, QWidget *parent)
     connect(this, &MDLPart::skeletonChanged, this, &MDLPart::reloadBoneData);
 }
 
+MDLPart::~MDLPart()
+{
+    // the window still uses the renderer while its surface is destroyed
+    delete vkWindow;
+    delete renderer;
+}
+
 void MDLPart::exportModel(const QString &fileName)
 {
     auto &model = models[0];
@@ -59,13 +69,24 @@ DrawObject &MDLPart::getModel(const int index)
 
 void MDLPart::reloadModel(const int index)
 {
-    renderer->reloadDrawObject(models[index], 0);
+    renderer->reloadDrawObject(models[index], models[index].lod);
+
+    // the other placements of the same MDL were sharing the buffers that were just replaced
+    for (auto &model : models) {
+        if (&model != &models[index] && model.model.p_ptr == models[index].model.p_ptr) {
+            renderer->refreshDrawObject(model);
+        }
+    }
 
     Q_EMIT modelChanged();
 }
 
 void MDLPart::clear()
 {
+    for (const auto &model : models) {
+        releaseMaterials(model);
+        renderer->releaseDrawObject(model.model);
+    }
     models.clear();
 
     Q_EMIT modelChanged();
@@ -80,6 +101,8 @@ void MDLPart::addModel(physis_MDL mdl,
                        uint16_t fromBodyId,
                        uint16_t toBodyId)
 {
+    NOVUS_TRACE_SCOPE("MDLPart::addModel", name);
+
     qDebug() << "Adding model to MDLPart";
 
     auto model = renderer->addDrawObject(mdl, lod);
@@ -125,11 +148,18 @@ void MDLPart::reloadRenderer()
     reloadBoneData();
 
     vkWindow->models = models;
+    vkWindow->markDirty();
 }
 
 void MDLPart::enableFreemode()
 {
     vkWindow->freeMode = true;
+    vkWindow->markDirty();
+}
+
+void MDLPart::requestRender()
+{
+    vkWindow->markDirty();
 }
 
 bool MDLPart::event(QEvent *event)
@@ -207,17 +237,28 @@ void MDLPart::reloadBoneData()
                 }
             }
 
-            for (uint32_t i = 0; i < model.model.num_affected_bones; i++) {
+            // the renderers clamp bone ids to the palette, so vertices weighted to the bones that don't fit follow the last one instead
+            if (model.model.num_affected_bones > DrawObject::maxBones) {
+                qWarning() << "Model is affected by" << model.model.num_affected_bones << "bones, but only" << DrawObject::maxBones
+                           << "fit in a palette. Vertices weighted to the rest will be drawn wrong";
+            }
+
+            model.boneData.resize(std::min<size_t>(model.model.num_affected_bones, DrawObject::maxBones));
+            for (uint32_t i = 0; i < model.boneData.size(); i++) {
                 const int originalBoneId = boneMapping[i];
                 qInfo() << "Remapped" << originalBoneId << "to" << i;
-                model.boneData[i] = boneData[originalBoneId].localTransform * deformBones[i] * boneData[originalBoneId].inversePose;
+                model.boneData[i] = toBoneMatrix(boneData[originalBoneId].localTransform * deformBones[i] * boneData[originalBoneId].inversePose);
             }
+
+            model.boneDataVersion = UniformRing::nextVersion();
         }
     }
 }
 
 RenderMaterial MDLPart::createMaterial(const physis_Material &material)
 {
+    NOVUS_TRACE_SCOPE("MDLPart::createMaterial");
+
     RenderMaterial newMaterial;
 
     if (material.shpk_name != nullptr) {
@@ -237,31 +278,27 @@ RenderMaterial MDLPart::createMaterial(const physis_Material &material)
         }
 
         char type = t[t.length() - 5];
-        auto texture = physis_texture_parse(cache.lookupFile(QLatin1String(material.textures[i])));
-        if (texture.rgba != nullptr) {
+        const QString path = QLatin1String(material.textures[i]);
+        auto tex = renderer->textureCache().acquire(path, [this, &path] {
+            return cache.lookupFile(path);
+        });
+        if (tex != nullptr) {
             switch (type) {
             case 'm': {
-                auto tex = renderer->addTexture(texture.width, texture.height, texture.rgba, texture.rgba_size);
-
-                newMaterial.multiTexture = new RenderTexture(tex);
+                newMaterial.multiTexture = tex;
             } break;
             case 'd': {
-                auto tex = renderer->addTexture(texture.width, texture.height, texture.rgba, texture.rgba_size);
-
-                newMaterial.diffuseTexture = new RenderTexture(tex);
+                newMaterial.diffuseTexture = tex;
             } break;
             case 'n': {
-                auto tex = renderer->addTexture(texture.width, texture.height, texture.rgba, texture.rgba_size);
-
-                newMaterial.normalTexture = new RenderTexture(tex);
+                newMaterial.normalTexture = tex;
             } break;
             case 's': {
-                auto tex = renderer->addTexture(texture.width, texture.height, texture.rgba, texture.rgba_size);
-
-                newMaterial.specularTexture = new RenderTexture(tex);
+                newMaterial.specularTexture = tex;
             } break;
             default:
                 qDebug() << "unhandled type" << type;
+                renderer->textureCache().release(tex);
                 break;
             }
         } else {
@@ -269,9 +306,20 @@ RenderMaterial MDLPart::createMaterial(const physis_Material &material)
         }
     }
 
+    renderer->prepareMaterial(newMaterial);
+
     return newMaterial;
 }
 
+void MDLPart::releaseMaterials(const DrawObject &model)
+{
+    for (const auto &material : model.materials) {
+        for (const auto texture : {material.diffuseTexture, material.normalTexture, material.specularTexture, material.multiTexture}) {
+            renderer->textureCache().release(texture);
+        }
+    }
+}
+
 void MDLPart::calculateBoneInversePose(physis_Skeleton &skeleton, physis_Bone &bone, physis_Bone *parent_bone)
 {
     const glm::mat4 parentMatrix = parent_bone == nullptr ? glm::mat4(1.0f) : boneData[parent_bone->index].inversePose;
@@ -313,8 +361,13 @@ void MDLPart::removeModel(const physis_MDL &mdl)
 {
     models.erase(std::remove_if(models.begin(),
                                 models.end(),
-                                [mdl](const DrawObject &other) {
-                                    return mdl.p_ptr == other.model.p_ptr;
+                                [this, mdl](const DrawObject &other) {
+                                    if (mdl.p_ptr == other.model.p_ptr) {
+                                        releaseMaterials(other);
+                                        renderer->releaseDrawObject(other.model);
+                                        return true;
+                                    }
+                                    return false;
                                 }),
                  models.end());
     Q_EMIT modelChanged();
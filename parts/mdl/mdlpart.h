@@ -21,6 +21,7 @@ class MDLPart : public QWidget
 
 public:
     explicit MDLPart(GameData *data, FileCache &cache, QWidget *parent = nullptr);
+    ~MDLPart() override;
 
     void exportModel(const QString &fileName);
     DrawObject &getModel(int index);
@@ -78,11 +79,15 @@ public Q_SLOTS:
 
     void enableFreemode();
 
+    /// Draws another frame. Call this after changing anything the requestUpdate callback shows.
+    void requestRender();
+
 protected:
     bool event(QEvent *event) override;
 
 private:
     RenderMaterial createMaterial(const physis_Material &mat);
+    void releaseMaterials(const DrawObject &model);
 
     void calculateBoneInversePose(physis_Skeleton &skeleton, physis_Bone &bone, physis_Bone *parent_bone);
     void calculateBone(physis_Skeleton &skeleton, physis_Bone &bone, const physis_Bone *parent_bone);
@@ -16,6 +16,25 @@ VulkanWindow::VulkanWindow(MDLPart *part, RenderManager *renderer, QVulkanInstan
 {
     setSurfaceType(VulkanSurface);
     setVulkanInstance(instance);
+
+    m_continuous = qgetenv("NOVUS_CONTINUOUS_RENDERING") == QByteArrayLiteral("1");
+    m_maximumFrameRate = std::max(qEnvironmentVariableIntValue("NOVUS_MAX_FPS"), 0);
+
+    m_frameRateTimer.setSingleShot(true);
+    m_frameRateTimer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&m_frameRateTimer, &QTimer::timeout, this, &QWindow::requestUpdate);
+
+    // reported from a timer instead of render(), so it keeps reporting while nothing is drawn
+    if (qgetenv("NOVUS_RENDER_ACTIVITY") == QByteArrayLiteral("1")) {
+        m_activityElapsed.start();
+        m_activityCpuStart = std::clock();
+
+        m_activityTimer.setInterval(10000);
+        QObject::connect(&m_activityTimer, &QTimer::timeout, this, [this] {
+            logActivity();
+        });
+        m_activityTimer.start();
+    }
 }
 
 void VulkanWindow::exposeEvent(QExposeEvent *)
@@ -29,6 +48,8 @@ void VulkanWindow::exposeEvent(QExposeEvent *)
         } else {
             render();
         }
+    } else if (isExposed()) {
+        markDirty();
     }
 
     if (!isExposed() && m_initialized) {
@@ -41,6 +62,7 @@ bool VulkanWindow::event(QEvent *e)
 {
     switch (e->type()) {
     case QEvent::UpdateRequest:
+        m_frameScheduled = false;
         render();
         break;
     case QEvent::Resize: {
@@ -51,6 +73,8 @@ bool VulkanWindow::event(QEvent *e)
                                resizeEvent->size().width() * screen()->devicePixelRatio(),
                                resizeEvent->size().height() * screen()->devicePixelRatio());
         }
+
+        markDirty();
     } break;
     case QEvent::PlatformSurface:
         if (dynamic_cast<QPlatformSurfaceEvent *>(e)->surfaceEventType() == QPlatformSurfaceEvent::SurfaceAboutToBeDestroyed && m_initialized) {
@@ -101,6 +125,8 @@ bool VulkanWindow::event(QEvent *e)
 
             part->lastX = mouseEvent->position().x();
             part->lastY = mouseEvent->position().y();
+
+            markDirty();
         }
     } break;
     case QEvent::Wheel: {
@@ -109,6 +135,8 @@ bool VulkanWindow::event(QEvent *e)
         if (part->isEnabled()) {
             part->cameraDistance -= (scrollEvent->angleDelta().y() / 120.0f) * 0.1f; // FIXME: why 120?
             part->cameraDistance = std::clamp(part->cameraDistance, part->minimumCameraDistance, 4.0f);
+
+            markDirty();
         }
     } break;
     case QEvent::KeyPress: {
@@ -129,6 +157,11 @@ bool VulkanWindow::event(QEvent *e)
                 pressed_keys[3] = true;
                 break;
             }
+
+            // frames keep being drawn while the keys are held, see isAnimating()
+            if (freeMode) {
+                markDirty();
+            }
         }
     } break;
     case QEvent::KeyRelease: {
@@ -164,6 +197,9 @@ void VulkanWindow::render()
         return;
     }
 
+    // also where the NOVUS_MAX_FPS interval is measured from
+    m_frameIntervalTimer.start();
+
     ImGui::SetCurrentContext(m_renderer->ctx);
 
     auto &io = ImGui::GetIO();
@@ -174,6 +210,8 @@ void VulkanWindow::render()
     if (part->requestUpdate)
         part->requestUpdate();
 
+    m_renderer->drawProfilerOverlay();
+
     ImGui::Render();
 
     if (freeMode) {
@@ -215,5 +253,62 @@ void VulkanWindow::render()
 
     m_renderer->render(models);
     m_instance->presentQueued(this);
+
+    m_activityFrames++;
+    m_activityRenderNsecs += m_frameIntervalTimer.nsecsElapsed();
+
+    if (m_dirtyFrames > 0) {
+        m_dirtyFrames--;
+    }
+
+    if (m_continuous || m_dirtyFrames > 0 || isAnimating() || m_renderer->hasPendingWork() || m_renderer->isProfiling()) {
+        scheduleFrame();
+    }
+}
+
+void VulkanWindow::markDirty()
+{
+    // ImGui only sizes a new window after its first frame, so anything that changes what it shows needs a second one
+    m_dirtyFrames = 2;
+
+    scheduleFrame();
+}
+
+void VulkanWindow::scheduleFrame()
+{
+    if (m_frameScheduled) {
+        return;
+    }
+
+    m_frameScheduled = true;
+
+    if (m_maximumFrameRate > 0 && m_frameIntervalTimer.isValid()) {
+        const qint64 remaining = 1000 / m_maximumFrameRate - m_frameIntervalTimer.elapsed();
+        if (remaining > 0) {
+            m_frameRateTimer.start(static_cast<int>(remaining));
+            return;
+        }
+    }
+
     requestUpdate();
 }
+
+bool VulkanWindow::isAnimating() const
+{
+    return freeMode && part->isEnabled() && (pressed_keys[0] || pressed_keys[1] || pressed_keys[2] || pressed_keys[3]);
+}
+
+void VulkanWindow::logActivity()
+{
+    const double seconds = m_activityElapsed.restart() / 1000.0;
+    const std::clock_t cpuNow = std::clock();
+    const double cpuSeconds = static_cast<double>(cpuNow - m_activityCpuStart) / CLOCKS_PER_SEC;
+    m_activityCpuStart = cpuNow;
+
+    // every rendered frame is one submission, so no frames means the GPU had nothing to do for this window
+    qInfo() << "Rendered" << m_activityFrames << "frames in" << seconds << "s (" << m_activityFrames / seconds << "fps ), spent"
+            << m_activityRenderNsecs / 1000000.0 << "ms rendering, process CPU usage" << cpuSeconds / seconds * 100.0 << "%";
+
+    m_activityFrames = 0;
+    m_activityRenderNsecs = 0;
+}
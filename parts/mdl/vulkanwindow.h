@@ -3,7 +3,10 @@
 
 #pragma once
 
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QWindow>
+#include <ctime>
 
 #include "imgui.h"
 #include "mdlpart.h"
@@ -19,13 +22,39 @@ public:
 
     void render();
 
+    /// Draws another frame, because the camera, the scene or something the ImGui callback shows has changed.
+    /// Unless NOVUS_CONTINUOUS_RENDERING is set, nothing is drawn until this is called.
+    void markDirty();
+
     std::vector<DrawObject> models;
     bool freeMode = false;
 
 private:
+    /// Requests the next frame, delayed by the NOVUS_MAX_FPS cap if needed.
+    void scheduleFrame();
+    /// Whether the camera keeps moving without any new input.
+    bool isAnimating() const;
+    void logActivity();
+
     bool m_initialized = false;
     RenderManager *m_renderer;
     QVulkanInstance *m_instance;
     MDLPart *part;
     bool pressed_keys[4] = {};
+
+    bool m_continuous = false;
+    bool m_frameScheduled = false;
+    // frames still to draw after the last change
+    int m_dirtyFrames = 0;
+
+    int m_maximumFrameRate = 0;
+    QElapsedTimer m_frameIntervalTimer;
+    QTimer m_frameRateTimer;
+
+    // what was rendered since the last NOVUS_RENDER_ACTIVITY report
+    QTimer m_activityTimer;
+    QElapsedTimer m_activityElapsed;
+    int m_activityFrames = 0;
+    qint64 m_activityRenderNsecs = 0;
+    std::clock_t m_activityCpuStart = 0;
 };
\ No newline at end of file
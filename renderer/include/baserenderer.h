@@ -14,6 +14,7 @@
 #include <vulkan/vulkan.h>
 
 class Renderer;
+struct CullingStatistics;
 struct DrawObject;
 struct Camera;
 struct Texture;
@@ -25,11 +26,22 @@ public:
     virtual ~BaseRenderer() = default;
 
     /// Perform any operations required on resize, such as recreating images.
+    /// This is called once after construction, and again on every resize after waiting for the GPU to be done with the old resources.
     virtual void resize() = 0;
 
-    /// Render a frame into @p commandBuffer. @p currentFrame is the same value as SwapChain::currentFrame for convenience.
+    /// Render a frame into @p commandBuffer. @p currentFrame is FrameScheduler::frameIndex(), for indexing per-frame resources.
     virtual void render(VkCommandBuffer commandBuffer, uint32_t currentFrame, Camera &camera, const std::vector<DrawObject> &models) = 0;
 
     /// The final composite texture that is drawn into with render()
     virtual Texture &getCompositeTexture() = 0;
+
+    /// What was culled in the last render()
+    virtual const CullingStatistics &cullingStatistics() const = 0;
+
+    /// Whether something was left out of the last render() because it's still being prepared, so a later frame will look different.
+    virtual bool hasPendingWork() const = 0;
+
+    /// Frees the descriptor sets that sample the RenderTexture with @p textureId, which is being destroyed.
+    /// This is only called once the GPU is done with every frame that could have used them.
+    virtual void textureDestroyed(uint64_t textureId) = 0;
 };
\ No newline at end of file
@@ -5,10 +5,12 @@
 
 #include <vulkan/vulkan.h>
 
+#include "memoryallocator.h"
+
 class Buffer
 {
 public:
     VkBuffer buffer = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    Allocation allocation;
     size_t size = 0;
-};
\ No newline at end of file
+};
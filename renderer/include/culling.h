@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+struct Camera;
+struct DrawObject;
+struct RenderLod;
+struct RenderPart;
+struct Vertex;
+
+/// An axis-aligned box, in the model's space.
+struct BoundingBox {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    /// The smallest box containing the positions of @p vertices.
+    static BoundingBox fromVertices(const Vertex *vertices, size_t count);
+
+    /// The smallest box containing both this and @p other.
+    BoundingBox merged(const BoundingBox &other) const;
+};
+
+/// A sphere around the same positions as a BoundingBox, which is cheaper to test but not as tight.
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    /// The sphere centered on @p box, just big enough to contain the positions of @p vertices.
+    static BoundingSphere fromVertices(const BoundingBox &box, const Vertex *vertices, size_t count);
+};
+
+/// The six planes of a camera's view volume, with the normals pointing inwards.
+class Frustum
+{
+public:
+    /// Extracts the planes from @p viewProjection, which must use a depth range of 0 to 1.
+    explicit Frustum(const glm::mat4 &viewProjection);
+
+    bool intersects(const BoundingSphere &sphere, const glm::vec3 &translation) const;
+    bool intersects(const BoundingBox &box, const glm::vec3 &translation) const;
+
+    /// Left, right, bottom, top, near and far, as (normal, distance).
+    const std::array<glm::vec4, 6> &planes() const;
+
+private:
+    std::array<glm::vec4, 6> m_planes;
+};
+
+struct CullingStatistics {
+    uint32_t visibleObjects = 0;
+    uint32_t culledObjects = 0;
+    uint32_t visibleParts = 0;
+    uint32_t culledParts = 0;
+};
+
+/// Tests DrawObjects and their parts against the camera, and counts what was culled in the current frame.
+/// Culling can be turned off with NOVUS_NO_CULLING=1, to compare against drawing everything.
+class FrustumCuller
+{
+public:
+    FrustumCuller();
+
+    /// Starts a new frame seen through @p camera, and resets the statistics.
+    void beginFrame(const Camera &camera);
+
+    /// Whether @p model is in view when drawn at @p translation. The sphere is tested first, and the box only if that's inconclusive.
+    /// If it isn't, the parts of @p lod are counted as culled along with it.
+    bool isVisible(const DrawObject &model, const RenderLod &lod, const glm::vec3 &translation);
+    bool isVisible(const RenderPart &part, const glm::vec3 &translation);
+
+    /// For parts culled somewhere else, like on the GPU.
+    void addPartStatistics(uint32_t visible, uint32_t culled);
+
+    /// What was culled since the last beginFrame().
+    const CullingStatistics &statistics() const;
+
+    const Frustum &frustum() const;
+
+private:
+    Frustum m_frustum;
+    CullingStatistics m_statistics;
+    bool m_enabled = true;
+};
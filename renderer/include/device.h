@@ -6,12 +6,20 @@
 #include <string_view>
 #include <vector>
 
+#include <QMutex>
 #include <vulkan/vulkan.h>
 
 #include "buffer.h"
 #include "texture.h"
 
+class FrameScheduler;
+class MemoryAllocator;
+class PipelineCache;
+class Profiler;
+class SamplerCache;
+class StagingRing;
 class SwapChain;
+class TextureUploader;
 
 class Device
 {
@@ -19,13 +27,27 @@ public:
     VkInstance instance = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device = VK_NULL_HANDLE;
-    VkQueue graphicsQueue = VK_NULL_HANDLE, presentQueue = VK_NULL_HANDLE;
+    VkQueue graphicsQueue = VK_NULL_HANDLE, presentQueue = VK_NULL_HANDLE, transferQueue = VK_NULL_HANDLE;
+    uint32_t graphicsFamilyIndex = 0, transferFamilyIndex = 0;
+    bool textureCompressionBC = false;
+    bool drawIndirectCount = false; // both multiDrawIndirect and drawIndirectCount are enabled
+    QMutex queueMutex; // the transfer queue may be the same as the graphics queue, so submits have to be serialized
     VkCommandPool commandPool = VK_NULL_HANDLE;
     SwapChain *swapChain = nullptr;
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    MemoryAllocator *allocator = nullptr;
+    StagingRing *stagingRing = nullptr;
+    TextureUploader *textureUploader = nullptr;
+    SamplerCache *samplerCache = nullptr;
+    PipelineCache *pipelineCache = nullptr;
+    Profiler *profiler = nullptr;
+    FrameScheduler *frameScheduler = nullptr;
 
-    Buffer createBuffer(size_t size, VkBufferUsageFlags usageFlags);
+    Buffer createBuffer(size_t size,
+                        VkBufferUsageFlags usageFlags,
+                        VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     void copyToBuffer(Buffer &buffer, void *data, size_t size);
+    void destroyBuffer(Buffer &buffer);
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
@@ -34,6 +56,7 @@ public:
     VkShaderModule loadShaderFromDisk(std::string_view path);
 
     Texture createTexture(int width, int height, VkFormat format, VkImageUsageFlags usage);
+    void destroyTexture(Texture &texture);
 
     Texture createDummyTexture();
     Buffer createDummyBuffer();
@@ -3,39 +3,90 @@
 
 #pragma once
 
+#include "culling.h"
+
 struct RenderPart {
     size_t numIndices;
 
-    Buffer vertexBuffer, indexBuffer;
+    // where this part starts in the DrawObject's index and vertex buffers
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
 
     int materialIndex = 0;
+
+    /// Bounds of this part's vertices, before the DrawObject's position is applied.
+    BoundingBox boundingBox;
+    BoundingSphere boundingSphere;
+};
+
+/// One level of detail of a DrawObject. The parts of every LOD are packed into the same vertex and index buffers.
+struct RenderLod {
+    std::vector<RenderPart> parts;
+
+    // the vertices of every part, which are next to each other in the vertex buffer
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
 };
 
 struct RenderTexture {
+    /// Never reused, unlike the address once the TextureCache destroys it, so cached descriptor sets are keyed on this.
+    uint64_t id = 0;
+
     VkImage handle = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    Allocation allocation;
     VkImageView view = VK_NULL_HANDLE;
     VkSampler sampler = VK_NULL_HANDLE;
+
+    /// The TextureUploader value signalled once the image contents are uploaded.
+    uint64_t uploadValue = 0;
 };
 
 enum class MaterialType { Object, Skin };
 
 struct RenderMaterial {
     MaterialType type = MaterialType::Object;
-    physis_SHPK shaderPackage;
+    physis_SHPK shaderPackage{};
 
     RenderTexture *diffuseTexture = nullptr;
     RenderTexture *normalTexture = nullptr;
     RenderTexture *specularTexture = nullptr;
     RenderTexture *multiTexture = nullptr;
+
+    /// The shader package node for the main subview, filled in by RenderManager::prepareMaterial().
+    /// It's only valid while the shader package and type are the same ones it was resolved from.
+    physis_SHPKNode shaderNode{};
+    const void *shaderNodePackage = nullptr;
+    MaterialType shaderNodeType = MaterialType::Object;
 };
 
+/// Packs an affine @p transform into the 3x4 format of DrawObject::boneData, which is the same one the game's shaders use.
+inline glm::mat3x4 toBoneMatrix(const glm::mat4 &transform)
+{
+    return glm::mat3x4(glm::transpose(transform));
+}
+
 struct DrawObject {
     QString name;
 
+    /// Tells placements apart, since several DrawObjects can share the same physis_MDL and buffers. Assigned by RenderManager::addDrawObject().
+    uint64_t id = 0;
+
     physis_MDL model;
-    std::vector<RenderPart> parts;
-    std::array<glm::mat4, 128> boneData;
+
+    /// Every LOD of the model, starting from the most detailed one. There's always at least one.
+    std::vector<RenderLod> lods;
+
+    /// The index into lods to draw, or automaticLod to let the renderer pick one each frame with a LodSelector.
+    int lod = 0;
+    static constexpr int automaticLod = -1;
+
+    Buffer vertexBuffer, indexBuffer;
+
+    /// The skinning matrix of each bone the model is affected by, at most maxBones of them.
+    /// They're stored as the top three rows of the transform, see toBoneMatrix(), which both renderers upload as is.
+    std::vector<glm::mat3x4> boneData;
+    /// How many bones SimpleRenderer and the skinning pass can hold. The game's g_JointMatrixArray only has room for 64, see GameRenderer.
+    static constexpr size_t maxBones = 128;
     std::vector<RenderMaterial> materials;
     glm::vec3 position;
     bool skinned = false;
@@ -43,5 +94,10 @@ struct DrawObject {
     uint16_t from_body_id = 101;
     uint16_t to_body_id = 101;
 
-    Buffer boneInfoBuffer;
+    /// Bump this with UniformRing::nextVersion() whenever boneData changes, so renderers know to upload it again.
+    uint64_t boneDataVersion = 0;
+
+    /// Bounds of every part of every LOD together, before position is applied. Calculated in RenderManager::reloadDrawObject().
+    BoundingBox boundingBox;
+    BoundingSphere boundingSphere;
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <QMutex>
+#include <vulkan/vulkan.h>
+
+class Device;
+
+/// Paces recording against the GPU with a timeline semaphore, which every frame signals when it's finished.
+/// Each frame in flight has its own command pool and acquire semaphore, and is only reused once the GPU timeline passes it.
+/// The number of frames in flight can be lowered with NOVUS_FRAMES_IN_FLIGHT, to trade throughput for latency.
+class FrameScheduler
+{
+public:
+    /// Per-frame resources elsewhere are sized to this, and indexed with frameIndex().
+    static constexpr uint32_t maxFramesInFlight = 3;
+
+    explicit FrameScheduler(Device &device);
+    ~FrameScheduler();
+
+    uint32_t framesInFlight() const;
+
+    /// Waits until the GPU is done with the next frame in flight, runs everything retired before it, and resets its command pool.
+    /// @return The frame's command buffer, ready to record into.
+    VkCommandBuffer beginFrame();
+
+    /// Call this once the frame from beginFrame() was submitted, signalling timelineSemaphore() with frameValue().
+    /// If the submit failed, call beginFrame() again without this and the same frame is recorded again.
+    void endFrame();
+
+    /// Which of the frames in flight is being recorded, less than framesInFlight().
+    uint32_t frameIndex() const;
+
+    /// The timeline semaphore frames signal when they're finished.
+    VkSemaphore timelineSemaphore() const;
+
+    /// The value the frame being recorded has to signal.
+    uint64_t frameValue() const;
+
+    /// Binary semaphores for acquiring and presenting the frame's swapchain image, which can't use a timeline semaphore.
+    VkSemaphore imageAvailableSemaphore() const;
+    /// Presenting isn't covered by the timeline, so this belongs to the swapchain image at @p imageIndex instead of the frame.
+    /// It can only be signalled again once that image is acquired again, which means its last present is done with it.
+    VkSemaphore renderFinishedSemaphore(uint32_t imageIndex) const;
+
+    /// Makes sure there's a render finished semaphore for each of the @p imageCount swapchain images.
+    void setSwapchainImageCount(uint32_t imageCount);
+
+    /// Calls @p destroy once the GPU is done with every frame submitted so far, including the one being recorded.
+    /// This is safe to call from any thread.
+    void retire(std::function<void()> destroy);
+
+    /// Blocks until every submitted frame is finished, and destroys everything retired. Only call this between frames.
+    void waitIdle();
+
+private:
+    void wait(uint64_t value);
+    void collectRetired();
+
+    struct Frame {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkSemaphore imageAvailable = VK_NULL_HANDLE;
+
+        // the timeline value of the last time this frame was submitted
+        uint64_t value = 0;
+    };
+
+    struct Retired {
+        uint64_t value = 0;
+        std::function<void()> destroy;
+    };
+
+    Device &m_device;
+    VkSemaphore m_timeline = VK_NULL_HANDLE;
+    uint32_t m_framesInFlight = maxFramesInFlight;
+    std::array<Frame, maxFramesInFlight> m_frames;
+    // indexed by swapchain image, and only ever grows since a present may still wait on them
+    std::vector<VkSemaphore> m_renderFinished;
+
+    uint32_t m_frameIndex = 0;
+    // the value the last submitted frame signals, the one being recorded signals the next
+    uint64_t m_submittedValue = 0;
+
+    // sorted by value, since it only ever grows
+    std::deque<Retired> m_retired;
+    // also guards m_submittedValue, which retire() reads
+    QMutex m_retiredMutex;
+};
@@ -0,0 +1,35 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <QString>
+
+/// Buckets how long each frame took to record and submit, to spot hitches.
+class FrameTimeHistogram
+{
+public:
+    /// Frames slower than this count as a hitch.
+    static constexpr double hitchThreshold = 50.0;
+
+    void record(double milliseconds);
+    void reset();
+
+    uint64_t frameCount() const;
+    uint64_t hitchCount() const;
+
+    /// A one line summary of every bucket, for logging.
+    QString summary() const;
+
+private:
+    // upper limits in milliseconds, anything slower ends up in the last bucket
+    static constexpr std::array<double, 7> bucketLimits = {4.0, 8.0, 16.7, 33.3, 50.0, 100.0, 250.0};
+
+    std::array<uint64_t, bucketLimits.size() + 1> m_buckets = {};
+    uint64_t m_frameCount = 0;
+    uint64_t m_hitchCount = 0;
+    double m_slowest = 0.0;
+};
@@ -3,8 +3,17 @@
 
 #pragma once
 
+#include <QByteArray>
 #include <QDebug>
+#include <QMutex>
+#include <QThreadPool>
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <tuple>
+#include <unordered_set>
 
 #include <glm/glm.hpp>
 #include <physis.hpp>
@@ -15,9 +24,15 @@
 
 #include "baserenderer.h"
 #include "buffer.h"
+#include "culling.h"
 #include "drawobject.h"
+#include "lodselector.h"
+#include "rendergraph.h"
+#include "shadercache.h"
 #include "shaderstructs.h"
+#include "skinningpass.h"
 #include "texture.h"
+#include "uniformring.h"
 
 class Device;
 struct DrawObject;
@@ -27,6 +42,8 @@ class GameRenderer : public BaseRenderer
 {
 public:
     GameRenderer(Device &device, GameData *data);
+    /// The GPU has to be done with every frame this recorded.
+    ~GameRenderer() override;
 
     void resize() override;
 
@@ -34,11 +51,41 @@ public:
 
     Texture &getCompositeTexture() override;
 
+    const CullingStatistics &cullingStatistics() const override;
+
+    bool hasPendingWork() const override;
+
+    void textureDestroyed(uint64_t textureId) override;
+
+    /// Resolves the shader package node @p material uses for the main subview, so it isn't looked up every frame.
+    static void prepareMaterial(RenderMaterial &material);
+
 private:
+    /// Everything a pipeline created by bindPipeline depends on.
+    struct PipelineKey {
+        uint64_t vertexShaderHash = 0;
+        uint64_t pixelShaderHash = 0;
+        uint32_t pass = 0;
+        // the formats of the render graph pass it draws in
+        uint32_t colorAttachmentCount = 0;
+        std::array<VkFormat, RenderGraph::maxColorAttachments> colorAttachmentFormats = {};
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+        uint32_t vertexStride = 0;
+        VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+
+        bool operator==(const PipelineKey &other) const = default;
+    };
+
+    struct PipelineKeyHash {
+        size_t operator()(const PipelineKey &key) const;
+    };
+
     struct RequestedBinding {
         VkDescriptorType type;
         VkShaderStageFlags stageFlags;
         bool used = false;
+        // empty if the shader doesn't name it
+        std::string name;
     };
 
     struct RequestedSet {
@@ -47,39 +94,99 @@ private:
         std::vector<RequestedBinding> bindings;
     };
 
+    /// Uniform data that is written into the UniformRing each frame, and bound with a dynamic offset.
+    enum DynamicUniform { CameraUniform, ModelUniform, MaterialUniform, JointMatrixUniform, DynamicUniformCount };
+    using DynamicOffsets = std::array<uint32_t, DynamicUniformCount>;
+
+    struct CachedDescriptor {
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        // which uniform each dynamic binding in the set uses, in binding order
+        std::vector<DynamicUniform> dynamicUniforms;
+    };
+
     struct CachedPipeline {
         VkPipeline pipeline = VK_NULL_HANDLE;
         VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
         std::vector<VkDescriptorSetLayout> setLayouts;
-        std::map<uint64_t, VkDescriptorSet> cachedDescriptors;
+        // keyed by the set index and the RenderTexture::id of the normal texture bound in it, which is the only per-material resource
+        // 0 is the placeholder texture
+        std::map<std::pair<int, uint64_t>, CachedDescriptor> cachedDescriptors;
         std::vector<RequestedSet> requestedSets;
-        physis_Shader vertexShader, pixelShader;
     };
 
-    void beginPass(uint32_t imageIndex, VkCommandBuffer commandBuffer, std::string_view passName);
-    void endPass(VkCommandBuffer commandBuffer, std::string_view passName);
-    CachedPipeline &bindPipeline(VkCommandBuffer commandBuffer, std::string_view passName, physis_Shader &vertexShader, physis_Shader &pixelShader);
-    VkShaderModule convertShaderModule(const physis_Shader &shader, spv::ExecutionModel executionModel);
-    spirv_cross::CompilerGLSL getShaderModuleResources(const physis_Shader &shader);
+    /// What createPipeline() needs from a physis_Shader. It's copied out of the shader package on the render thread,
+    /// since the package may be freed while the pipeline is still compiling in the background.
+    struct ShaderSource {
+        QByteArray bytecode;
+        std::vector<std::string> scalarParameters;
+        std::vector<std::string> resourceParameters;
+    };
+
+    /// Draws every model with the shaders their materials use in @p passName. @p passIndex is its index in the shader package nodes.
+    void drawModels(VkCommandBuffer commandBuffer, std::string_view passName, int passIndex);
+    /// Draws a plane covering the screen, with the shaders @p node uses in @p passName.
+    void drawFullscreen(VkCommandBuffer commandBuffer, std::string_view passName, int passIndex, const physis_SHPK &shaderPackage, const physis_SHPKNode &node);
+    /// Binds the pipeline for these shaders. If it isn't compiled yet, this queues it up and returns nullptr.
+    CachedPipeline *bindPipeline(VkCommandBuffer commandBuffer, std::string_view passName, const physis_SHPK &shaderPackage, const Pass &pass);
+    CachedPipeline createPipeline(const PipelineKey &key, const ShaderSource &vertexShader, const ShaderSource &pixelShader);
+    void collectFinishedPipelines();
+    PipelineKey pipelineKey(std::string_view passName, const physis_SHPK &shaderPackage, const Pass &pass);
+    uint64_t shaderHash(const physis_SHPK &shaderPackage, bool pixelShader, uint32_t index);
+    void resolveBindings(std::vector<RequestedSet> &requestedSets, const ShaderSource &vertexShader, const ShaderSource &pixelShader);
+    static std::optional<DynamicUniform> dynamicUniformFor(const char *name);
+    static physis_SHPKNode shaderNodeFor(const RenderMaterial &material);
+    static ShaderSource copyShader(const physis_Shader &shader);
+    VkShaderModule convertShaderModule(const ShaderSource &shader, spv::ExecutionModel executionModel);
+    spirv_cross::CompilerGLSL getShaderModuleResources(const ShaderSource &shader);
 
     void createImageResources();
+    /// Frees the descriptor sets of every pipeline, so they're created again with the current images.
+    void freeDescriptors();
 
     physis_SHPK directionalLightningShpk;
     physis_SHPK createViewPositionShpk;
 
-    // combined vertex + pixel code length
-    std::unordered_map<uint32_t, CachedPipeline> m_cachedPipelines;
+    // the lighting passes always use the same keys, so their nodes are resolved once
+    physis_SHPKNode m_directionalLightningNode{};
+    physis_SHPKNode m_createViewPositionNode{};
+
+    std::unordered_map<PipelineKey, CachedPipeline, PipelineKeyHash> m_cachedPipelines;
+
+    struct ShaderHash {
+        // what was hashed, in case the shader package was freed and another one took its place
+        const void *bytecode = nullptr;
+        uint32_t length = 0;
+        uint64_t hash = 0;
+    };
+
+    // the content hash of each shader, keyed by its shader package, whether it's a pixel shader, and its index in the package
+    std::map<std::tuple<const void *, bool, uint32_t>, ShaderHash> m_shaderHashes;
+
+    // pipelines being compiled in m_pipelinePool, and the ones that finished since the last frame
+    std::unordered_set<PipelineKey, PipelineKeyHash> m_pendingPipelines;
+    std::vector<std::pair<PipelineKey, CachedPipeline>> m_finishedPipelines;
+    QMutex m_finishedPipelinesMutex;
+    bool m_synchronousPipelines = false;
 
     Device &m_device;
     GameData *m_data = nullptr;
 
-    VkDescriptorSet createDescriptorFor(const DrawObject *object, const CachedPipeline &cachedPipeline, int i, const RenderMaterial *material);
-    void bindDescriptorSets(VkCommandBuffer commandBuffer, CachedPipeline &pipeline, const DrawObject *object, const RenderMaterial *material);
+    CachedDescriptor createDescriptorFor(const CachedPipeline &cachedPipeline, int i, const RenderTexture *normalTexture);
+    bool bindDescriptorSets(VkCommandBuffer commandBuffer, CachedPipeline &pipeline, const DynamicOffsets &offsets, const RenderMaterial *material);
+
+    UniformRing m_uniformRing;
+    ShaderCache m_shaderCache;
+
+    CameraParameter m_cameraParameter{};
+    uint64_t m_cameraVersion = 0;
+    ModelParameter m_modelParameter{};
+    uint64_t m_modelVersion = 0;
+    MaterialParameters m_materialParameter{};
+    uint64_t m_materialVersion = 0;
+    JointMatrixArray m_identityJoints{};
+    uint64_t m_identityJointsVersion = 0;
 
-    Buffer g_CameraParameter;
     Buffer g_InstanceParameter;
-    Buffer g_ModelParameter;
-    Buffer g_MaterialParameter;
     Buffer g_CommonParameter;
     Buffer g_LightParam;
     Buffer g_SceneParameter;
@@ -87,11 +194,32 @@ private:
 
     Buffer m_planeVertexBuffer;
 
-    Texture m_normalGBuffer;
-    Texture m_viewPositionBuffer;
-    Texture m_depthBuffer;
-    Texture m_compositeBuffer;
+    RenderGraph m_renderGraph;
+    RenderGraph::ResourceId m_normalGBuffer = 0;
+    RenderGraph::ResourceId m_viewPositionBuffer = 0;
+    RenderGraph::ResourceId m_depthBuffer = 0;
+    RenderGraph::ResourceId m_compositeBuffer = 0;
+
+    // what the render graph's passes need from the frame that's being recorded
+    struct FrameContext {
+        const std::vector<DrawObject> *models = nullptr;
+        DynamicOffsets offsets{};
+        std::vector<std::optional<uint32_t>> jointOffsets;
+        // the LOD each model is drawn at
+        std::vector<const RenderLod *> lods;
+        // whether each part survived culling, the parts of model j start at firstPart[j]
+        std::vector<size_t> firstPart;
+        std::vector<bool> partVisible;
+    };
+    FrameContext m_frame;
+    FrustumCuller m_culler;
+    LodSelector m_lodSelector;
+    SkinningPass m_skinning;
+
     Texture m_dummyTex;
-    VkSampler m_sampler;
+    VkSampler m_sampler = VK_NULL_HANDLE;
     Buffer m_dummyBuffer;
+
+    // declared last, so any compile jobs are finished before the rest of the renderer is destroyed
+    QThreadPool m_pipelinePool;
 };
\ No newline at end of file
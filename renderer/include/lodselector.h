@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+struct Camera;
+struct DrawObject;
+struct RenderLod;
+
+/// Picks the level of detail DrawObjects are drawn at, from how much of the screen their bounding sphere covers.
+/// A model has to get a bit past the point where it switched LODs before it switches back, so it doesn't pop between two of them.
+/// NOVUS_LOD_BIAS shifts every choice by that many LODs, positive values preferring less detailed ones.
+class LodSelector
+{
+public:
+    LodSelector();
+
+    /// Starts a new frame seen through @p camera. Models that weren't selected for in the last frame are forgotten.
+    void beginFrame(const Camera &camera);
+
+    /// The LOD of @p model to draw at @p translation. Models with a fixed LOD always get that one.
+    const RenderLod &select(const DrawObject &model, const glm::vec3 &translation);
+
+    float bias() const;
+    void setBias(float bias);
+
+private:
+    /// How many LODs down from the most detailed one @p model should be drawn, before rounding.
+    float level(const DrawObject &model, const glm::vec3 &translation) const;
+
+    glm::vec3 m_cameraPosition = glm::vec3(0.0f);
+    // turns a distance into the fraction of the screen height a unit covers at it
+    float m_projectionScale = 1.0f;
+    float m_bias = 0.0f;
+
+    // the LOD chosen for each DrawObject id, in the last and current frame
+    std::unordered_map<uint64_t, uint32_t> m_previousLods;
+    std::unordered_map<uint64_t, uint32_t> m_currentLods;
+};
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+#include <vulkan/vulkan.h>
+
+class Device;
+
+/// A range of device memory handed out by MemoryAllocator.
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    /// Points to the start of this range if the memory is host visible, otherwise nullptr.
+    void *mapped = nullptr;
+
+    uint32_t memoryType = 0;
+};
+
+/// Sub-allocates buffers and images out of large VkDeviceMemory blocks, so creating a resource doesn't need a driver allocation.
+class MemoryAllocator
+{
+public:
+    explicit MemoryAllocator(Device &device);
+    ~MemoryAllocator();
+
+    /// Hands out a range fitting @p requirements from a memory type with @p properties. @p linear should be true for buffers and linear images.
+    Allocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear);
+
+    /// Returns the range to its block. The caller must make sure the GPU is no longer using it.
+    void free(const Allocation &allocation);
+
+    struct Statistics {
+        uint32_t blockCount = 0;
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize usedBytes = 0;
+    };
+
+    Statistics statistics();
+
+private:
+    struct Range {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+    };
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void *mapped = nullptr;
+        uint32_t memoryType = 0;
+
+        // buffers and optimal images are kept in separate blocks so we never have to care about bufferImageGranularity
+        bool linear = true;
+
+        // only holds a single resource, and is released as soon as it's freed
+        bool dedicated = false;
+
+        // sorted by offset, adjacent ranges are always merged
+        std::vector<Range> freeRanges;
+        VkDeviceSize usedBytes = 0;
+    };
+
+    Block *createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated);
+    void destroyBlock(Block *block);
+    static bool allocateFromBlock(Block &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+
+    VkDeviceSize preferredBlockSize(uint32_t memoryType) const;
+
+    Device &m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+    std::vector<std::unique_ptr<Block>> m_blocks;
+    QMutex m_mutex;
+};
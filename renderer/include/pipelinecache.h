@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QMetaObject>
+#include <QString>
+#include <vulkan/vulkan.h>
+
+class Device;
+
+/// Owns the VkPipelineCache every pipeline is created with, and keeps it on disk between sessions.
+/// The cache is loaded from the cache directory on creation, and written back when the application quits.
+class PipelineCache
+{
+public:
+    explicit PipelineCache(Device &device);
+    ~PipelineCache();
+
+    VkPipelineCache handle() const;
+
+    /// Writes the cache to disk. This is called automatically when the application is about to quit.
+    void save();
+
+private:
+    /// Whether @p data was written by the same driver and device, and can be handed to Vulkan.
+    bool isCompatible(const QByteArray &data) const;
+
+    Device &m_device;
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_properties{};
+    QString m_path;
+    QMetaObject::Connection m_quitConnection;
+};
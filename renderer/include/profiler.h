@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <vulkan/vulkan.h>
+
+#include "framescheduler.h"
+
+class Device;
+
+/// Measures where frame time goes. Sections of the frame are timed on the CPU with timers, and on the GPU with timestamp queries,
+/// which are read back once the frame in flight that wrote them is finished. Enabled with NOVUS_PROFILER=1, otherwise everything is a no-op.
+class Profiler
+{
+public:
+    explicit Profiler(Device &device);
+    ~Profiler();
+
+    /// Things counted while recording each frame.
+    enum Counter {
+        DrawCalls,
+        Dispatches,
+        PipelineBinds,
+        DescriptorBinds,
+        // lookups that found a compiled pipeline, and ones that didn't and had to create or wait for one
+        PipelineHits,
+        PipelineMisses,
+        Triangles,
+        UniformBytes,
+        UniformDrops,
+        CounterCount
+    };
+
+    bool isEnabled() const;
+
+    /// Starts recording into @p commandBuffer for @p frameIndex, whose previous use must be finished on the GPU.
+    /// This reads back its timestamps and resets its queries, so it has to be called outside of any render pass.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    /// Ends the frame that's being recorded, once it has been submitted.
+    void endFrame();
+
+    /// Adds @p amount to @p counter for the current frame. This is safe to call from any thread.
+    void count(Counter counter, uint64_t amount = 1);
+
+    /// Times the scope it lives in on the CPU. Only use it on the thread calling beginFrame().
+    class CpuScope
+    {
+    public:
+        CpuScope(Profiler &profiler, std::string_view name);
+        ~CpuScope();
+
+    private:
+        Profiler &m_profiler;
+        std::string_view m_name;
+        QElapsedTimer m_timer;
+    };
+
+    /// Times the commands recorded into a primary command buffer during the scope it lives in.
+    class GpuScope
+    {
+    public:
+        GpuScope(Profiler &profiler, VkCommandBuffer commandBuffer, std::string_view name);
+        ~GpuScope();
+
+    private:
+        Profiler &m_profiler;
+        VkCommandBuffer m_commandBuffer;
+        // noSection if the profiler is disabled or out of queries
+        uint32_t m_section;
+    };
+
+    /// Draws the timings of every section and last frame's counters into the current ImGui window.
+    void drawOverlay() const;
+
+private:
+    /// Timings of a section over the last historySize frames it appeared in.
+    struct History {
+        std::string name;
+        bool gpu = false;
+        static constexpr size_t historySize = 240;
+        std::array<double, historySize> samples{};
+        size_t sampleCount = 0;
+        size_t nextSample = 0;
+
+        void add(double milliseconds);
+    };
+
+    struct GpuSection {
+        std::string name;
+        uint32_t beginQuery = 0;
+        uint32_t endQuery = 0;
+    };
+
+    struct FrameQueries {
+        std::vector<GpuSection> sections;
+        uint32_t queryCount = 0;
+        // the queries are only valid to read if the frame was submitted
+        bool submitted = false;
+    };
+
+    History &history(std::string_view name, bool gpu);
+    void addCpuSample(std::string_view name, double milliseconds);
+    uint32_t beginGpuSection(VkCommandBuffer commandBuffer, std::string_view name);
+    void endGpuSection(VkCommandBuffer commandBuffer, uint32_t section);
+    void resolveQueries(uint32_t frameIndex);
+
+    static constexpr uint32_t maxQueriesPerFrame = 128;
+    static constexpr uint32_t noSection = UINT32_MAX;
+
+    Device &m_device;
+    bool m_enabled = false;
+    bool m_timestamps = false;
+    double m_timestampPeriod = 1.0;
+    uint64_t m_timestampMask = ~0ULL;
+
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    std::array<FrameQueries, FrameScheduler::maxFramesInFlight> m_frames;
+    uint32_t m_currentFrame = 0;
+
+    // CPU sections can appear more than once a frame, so they're summed up until endFrame()
+    std::vector<std::pair<std::string, double>> m_cpuSamples;
+
+    std::vector<History> m_histories;
+
+    std::array<std::atomic<uint64_t>, CounterCount> m_counters = {};
+    std::array<uint64_t, CounterCount> m_lastCounters = {};
+};
@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <QString>
+#include <vulkan/vulkan.h>
+
+#include "memoryallocator.h"
+#include "texture.h"
+
+class Device;
+
+/// Records a fixed set of passes that declare which images they read and write.
+/// From those declarations the graph places the barriers between passes, skips passes whose results are never used,
+/// and lets images that are never alive at the same time share memory.
+class RenderGraph
+{
+public:
+    using ResourceId = uint32_t;
+    using ExecuteFunction = std::function<void(VkCommandBuffer)>;
+
+    /// Every device supports at least this many color attachments.
+    static constexpr uint32_t maxColorAttachments = 4;
+
+    /// The attachment formats a pipeline drawing in a pass has to be created with.
+    struct AttachmentFormats {
+        uint32_t colorCount = 0;
+        // slots added with skipColor() are VK_FORMAT_UNDEFINED
+        std::array<VkFormat, maxColorAttachments> color = {};
+        VkFormat depth = VK_FORMAT_UNDEFINED;
+    };
+
+    /// Declares what a pass added with addPass() reads and writes. Color attachments are bound in the order they're declared.
+    class PassBuilder
+    {
+    public:
+        /// Renders into @p image. If @p clearColor is set the previous contents are discarded, otherwise they're loaded.
+        PassBuilder &writeColor(ResourceId image, std::optional<VkClearColorValue> clearColor = std::nullopt);
+
+        /// Adds a color attachment slot without an image, for shaders with more outputs than we keep.
+        PassBuilder &skipColor();
+
+        /// Uses @p image as the depth attachment. If @p clearDepth is set the previous contents are discarded, otherwise they're loaded.
+        PassBuilder &writeDepth(ResourceId image, std::optional<float> clearDepth = std::nullopt);
+
+        /// Samples @p image in the fragment shader.
+        PassBuilder &read(ResourceId image);
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph &graph, size_t pass);
+
+        RenderGraph &m_graph;
+        size_t m_pass;
+    };
+
+    explicit RenderGraph(Device &device);
+    ~RenderGraph();
+
+    /// Declares an image the size of the render area. Its contents only last for the frame, unless it's marked as an output.
+    ResourceId createImage(std::string_view name, VkFormat format);
+
+    /// Keeps @p image after the last pass, in a layout it can be sampled from.
+    void markOutput(ResourceId image);
+
+    /// Adds a pass, which is run in the order it was added. @p execute records the draws, the graph begins and ends rendering around it.
+    PassBuilder addPass(std::string_view name, ExecuteFunction execute);
+
+    /// Culls passes nobody uses the results of, then creates the images and barriers for @p extent.
+    /// This has to be called before execute(), and again whenever the extent changes.
+    void compile(VkExtent2D extent);
+
+    void execute(VkCommandBuffer commandBuffer);
+
+    /// The formats of the attachments the pass named @p passName renders into, or none if there is no such pass.
+    AttachmentFormats attachmentFormats(std::string_view passName) const;
+
+    /// The image backing @p image. The handles are null if every pass using it was culled.
+    Texture &texture(ResourceId image);
+
+    /// The graph in Graphviz format, with culled passes drawn dashed and the memory each image is placed in.
+    QString toDot() const;
+
+private:
+    enum class Access { ColorWrite, DepthWrite, Read };
+
+    struct Use {
+        ResourceId image = 0;
+        Access access = Access::Read;
+
+        // only for writes, whether the previous contents are thrown away
+        bool clear = false;
+        VkClearValue clearValue{};
+    };
+
+    struct Pass {
+        std::string name;
+        ExecuteFunction execute;
+        std::vector<Use> uses;
+
+        // indices into uses, std::nullopt for slots added with skipColor()
+        std::vector<std::optional<size_t>> colorAttachments;
+        std::optional<size_t> depthAttachment;
+
+        bool culled = false;
+
+        // filled in by compile()
+        std::vector<VkImageMemoryBarrier> barriers;
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkRenderingAttachmentInfo> colorAttachmentInfos;
+        VkRenderingAttachmentInfo depthAttachmentInfo{};
+    };
+
+    struct Image {
+        std::string name;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        bool output = false;
+
+        // filled in by compile()
+        Texture texture{};
+        VkImageUsageFlags usage = 0;
+        int firstPass = -1;
+        int lastPass = -1;
+        int memorySlot = -1;
+    };
+
+    /// A piece of memory shared by images whose lifetimes don't overlap.
+    struct MemorySlot {
+        VkMemoryRequirements requirements{};
+        Allocation allocation;
+        std::vector<ResourceId> images;
+    };
+
+    void cullPasses();
+    void createImages();
+    void createBarriers();
+    void destroyImages();
+
+    static VkImageLayout layoutFor(Access access);
+    static VkPipelineStageFlags stagesFor(Access access);
+    static VkAccessFlags accessFlagsFor(Access access);
+    static bool isDepthFormat(VkFormat format);
+
+    Device &m_device;
+    VkExtent2D m_extent{};
+    std::vector<Pass> m_passes;
+    std::vector<Image> m_images;
+    std::vector<MemorySlot> m_memorySlots;
+
+    // moves the outputs into a readable layout after the last pass
+    std::vector<VkImageMemoryBarrier> m_finalBarriers;
+    VkPipelineStageFlags m_finalSrcStages = 0;
+};
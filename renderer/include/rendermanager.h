@@ -5,8 +5,11 @@
 
 #include <array>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
+#include <QByteArray>
+#include <QElapsedTimer>
 #include <QString>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <physis.hpp>
@@ -15,8 +18,10 @@
 #include "camera.h"
 #include "device.h"
 #include "drawobject.h"
+#include "frametimehistogram.h"
 
 class ImGuiPass;
+class TextureCache;
 struct ImGuiContext;
 class BaseRenderer;
 
@@ -25,18 +30,49 @@ class RenderManager
 {
 public:
     RenderManager(GameData *data);
+    ~RenderManager();
 
     bool initSwapchain(VkSurfaceKHR surface, int width, int height);
     void resize(VkSurfaceKHR surface, int width, int height);
 
+    /// Renders into an image of this size instead of a surface, so no window or swapchain is needed.
+    /// Use renderOffscreen() to draw into it. This can't be combined with initSwapchain().
+    bool initOffscreen(int width, int height);
+
     void destroySwapchain();
 
+    /// Uploads every LOD of @p model. @p lod is the one to draw, or DrawObject::automaticLod to pick one from the model's size on screen.
+    /// Adding the same physis_MDL again reuses its buffers, and the renderers draw every placement of it together with instancing.
+    /// Every call must be paired with releaseDrawObject().
     DrawObject addDrawObject(const physis_MDL &model, int lod);
-    void reloadDrawObject(DrawObject &model, uint32_t lod);
+
+    /// Uploads @p model's physis_MDL again after it was changed, replacing the buffers every placement of it shares.
+    /// The old buffers are freed once the GPU is done with them, so other placements have to be updated with refreshDrawObject().
+    void reloadDrawObject(DrawObject &model, int lod);
+
+    /// Points @p model at the buffers its physis_MDL was last uploaded to, after another placement of it was reloaded.
+    void refreshDrawObject(DrawObject &model);
+
+    /// Drops a placement of @p model taken by addDrawObject(). Once none are left, its buffers are freed when the GPU is done with them.
+    void releaseDrawObject(const physis_MDL &model);
+
+    /// If there isn't enough memory for the texture, the returned texture has a null handle.
     RenderTexture addTexture(uint32_t width, uint32_t height, const uint8_t *data, uint32_t data_size);
 
+    /// Uploads a .tex file in its original block format with every mip level, decoding to RGBA only when the device can't sample it.
+    /// If the file couldn't be loaded, the returned texture has a null handle.
+    RenderTexture addGameTexture(const physis_Buffer &file);
+
+    /// Resolves everything about @p material that only depends on its shader package, so it isn't done every frame.
+    /// Call this again after changing the material's type or shader package.
+    void prepareMaterial(RenderMaterial &material);
+
     void render(const std::vector<DrawObject> &models);
 
+    /// Renders @p models after initOffscreen(), waiting until any textures and pipelines they use are ready.
+    /// @return The image as BGRA8 pixels, four bytes per pixel and no padding between rows, or an empty array on failure.
+    QByteArray renderOffscreen(const std::vector<DrawObject> &models);
+
     VkRenderPass presentationRenderPass() const;
 
     Camera camera;
@@ -44,12 +80,37 @@ public:
     ImGuiContext *ctx = nullptr;
 
     Device &device();
+    TextureCache &textureCache();
+
+    /// Frees whatever the renderer created for the RenderTexture with @p textureId. Only call this once the GPU is done with it.
+    void textureDestroyed(uint64_t textureId);
+
+    /// How long each frame took to record and submit, since the renderer was created.
+    const FrameTimeHistogram &frameTimes() const;
+
+    /// How many DrawObjects and parts were outside of the camera in the last frame.
+    const CullingStatistics &cullingStatistics() const;
+
+    /// Whether textures or pipelines are still being prepared. Until they are, later frames look different even if nothing else changes.
+    bool hasPendingWork() const;
+
+    /// Whether NOVUS_PROFILER=1 is set. Timings are only useful if frames keep being drawn, so callers should render continuously while it is.
+    bool isProfiling() const;
+
+    /// Draws an ImGui window with the profiler's timings and counters, along with upload, memory and culling statistics.
+    /// Call this between ImGui::NewFrame() and ImGui::Render(). This does nothing unless isProfiling() is true.
+    void drawProfilerOverlay();
 
 private:
+    RenderTexture createTexture(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format);
+    bool canSampleFormat(VkFormat format) const;
+
+    /// Creates everything drawing into the swapchain images needs, for either kind of swapchain.
+    bool initFrameResources();
     void updateCamera(Camera &camera);
     void initBlitPipeline();
-
-    std::array<VkCommandBuffer, 3> m_commandBuffers;
+    /// Destroys what initBlitPipeline() created, which samples the renderer's composite texture and draws in m_renderPass.
+    void destroyBlitPipeline();
 
     VkRenderPass m_renderPass = VK_NULL_HANDLE;
     VkPipeline m_pipeline = VK_NULL_HANDLE;
@@ -60,8 +121,31 @@ private:
 
     std::vector<VkFramebuffer> m_framebuffers;
 
+    // where the offscreen image is copied at the end of each frame
+    Buffer m_readbackBuffer;
+
     ImGuiPass *m_imGuiPass = nullptr;
     Device *m_device = nullptr;
+    TextureCache *m_textureCache = nullptr;
     BaseRenderer *m_renderer = nullptr;
     GameData *m_data = nullptr;
+
+    FrameTimeHistogram m_frameTimes;
+    QElapsedTimer m_frameTimeLogTimer;
+    bool m_logFrameTimes = false;
+
+    struct UploadedModel {
+        DrawObject drawObject;
+        // how many DrawObjects from addDrawObject() place it
+        int refCount = 0;
+    };
+
+    /// Frees @p model's vertex and index buffers, once the GPU is done with them.
+    void retireBuffers(const DrawObject &model);
+
+    /// Copies everything about the uploaded mesh from @p uploaded into @p model, but not the placement itself.
+    static void shareUploadedModel(const DrawObject &uploaded, DrawObject &model);
+
+    // the last upload of each physis_MDL, whose buffers are shared with every DrawObject placing it
+    std::unordered_map<const void *, UploadedModel> m_uploadedModels;
 };
\ No newline at end of file
@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <map>
+#include <tuple>
+
+#include <QMutex>
+#include <vulkan/vulkan.h>
+
+class Device;
+
+/// Hands out shared samplers, so textures with the same sampling state don't each create their own.
+class SamplerCache
+{
+public:
+    explicit SamplerCache(Device &device);
+    ~SamplerCache();
+
+    /// Returns a sampler using @p filter for magnification, minification and mipmaps. It's owned by the cache.
+    VkSampler sampler(VkFilter filter, VkSamplerAddressMode addressMode, float maxLod = VK_LOD_CLAMP_NONE);
+
+private:
+    Device &m_device;
+    std::map<std::tuple<VkFilter, VkSamplerAddressMode, float>, VkSampler> m_samplers;
+    QMutex m_mutex;
+};
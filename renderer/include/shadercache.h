@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <vector>
+
+#include <QByteArrayView>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+/// Caches the SPIR-V translation of game shaders, in memory and in the cache directory.
+/// Entries are keyed by a SHA-256 of the DXBC bytecode, so a shader is translated once no matter how many packages share it.
+class ShaderCache
+{
+public:
+    ShaderCache();
+
+    /// Returns the SPIR-V for the DXBC @p bytecode of a shader, only translating it if it isn't cached yet.
+    std::vector<uint32_t> spirv(QByteArrayView bytecode);
+
+private:
+    QByteArray key(QByteArrayView bytecode) const;
+    std::vector<uint32_t> loadFromDisk(const QByteArray &key) const;
+    void saveToDisk(const QByteArray &key, const std::vector<uint32_t> &code) const;
+
+    QString m_directory;
+    QHash<QByteArray, std::vector<uint32_t>> m_cache;
+    int m_translatedCount = 0;
+    QMutex m_mutex;
+};
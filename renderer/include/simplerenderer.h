@@ -4,7 +4,10 @@
 #pragma once
 
 #include <QDebug>
+#include <QThreadPool>
+#include <array>
 #include <string_view>
+#include <utility>
 
 #include <glm/glm.hpp>
 #include <physis.hpp>
@@ -14,19 +17,29 @@
 #include <vulkan/vulkan.h>
 
 #include "baserenderer.h"
+#include "buffer.h"
+#include "culling.h"
+#include "framescheduler.h"
+#include "lodselector.h"
+#include "skinningpass.h"
 #include "texture.h"
+#include "uniformring.h"
 
 class Renderer;
 struct RenderModel;
 class Device;
 struct DrawObject;
+struct RenderLod;
 struct RenderMaterial;
+struct RenderPart;
 
 /// Performs rendering with a basic set of shaders. Can be run without real game data.
 class SimpleRenderer : public BaseRenderer
 {
 public:
     explicit SimpleRenderer(Device &device);
+    /// The GPU has to be done with every frame this recorded.
+    ~SimpleRenderer() override;
 
     void resize() override;
 
@@ -34,14 +47,58 @@ public:
 
     Texture &getCompositeTexture() override;
 
+    const CullingStatistics &cullingStatistics() const override;
+
+    bool hasPendingWork() const override;
+
+    void textureDestroyed(uint64_t textureId) override;
+
 private:
     void initRenderPass();
     void initPipeline();
     void initDescriptors();
     void initTextures(int width, int height);
-
-    VkDescriptorSet createDescriptorFor(const DrawObject &model, const RenderMaterial &material);
-    uint64_t hash(const DrawObject &model, const RenderMaterial &material);
+    /// Destroys what resize() creates again for the new size: the pipelines, which have the viewport baked in, and the images.
+    void destroySizedResources();
+
+    /// Everything recording a model needs that comes from the caches, which are only safe to use from the render thread.
+    struct PreparedModel {
+        const DrawObject *model = nullptr;
+        const RenderLod *lod = nullptr;
+        uint32_t boneOffset = 0;
+        // index of the model's first part in m_preparedParts
+        size_t firstPart = 0;
+        // drawn by recordInstances() instead of recordModels()
+        bool instanced = false;
+    };
+
+    struct PreparedPart {
+        // VK_NULL_HANDLE if the part can't be drawn
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        int materialType = 0;
+    };
+
+    void prepareModels(const std::vector<DrawObject> &models, Camera &camera);
+    void recordModels(VkCommandBuffer commandBuffer, size_t begin, size_t end, const glm::mat4 &viewProjection);
+    /// Splits the prepared models across m_recordingThreads, each recording into a secondary command buffer.
+    void recordInParallel(VkCommandBuffer commandBuffer, uint32_t currentFrame, const glm::mat4 &viewProjection);
+
+    /// Groups the visible parts of unskinned models by mesh and material, and uploads the transform of each placement.
+    void prepareInstances(uint32_t currentFrame);
+    void recordInstances(VkCommandBuffer commandBuffer, uint32_t currentFrame, const glm::mat4 &viewProjection);
+
+    void initGpuCulling();
+    /// Uploads the prepared parts and culls them in cull.comp, which writes the indirect draws for recordIndirect().
+    void cullOnGpu(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+    void recordIndirect(VkCommandBuffer commandBuffer, uint32_t currentFrame, const glm::mat4 &viewProjection);
+
+    /// The RenderTexture::id of the diffuse, normal, specular and multi textures, 0 for the ones that use the placeholder,
+    /// and the number of bones the set binds, since the bones are bound with exactly the range of the model's palette.
+    using DescriptorKey = std::pair<std::array<uint64_t, 4>, size_t>;
+
+    VkDescriptorSet createDescriptorFor(const RenderMaterial &material, size_t boneCount);
+    static DescriptorKey descriptorKey(const RenderMaterial &material, size_t boneCount);
+    bool texturesReady(const RenderMaterial &material) const;
 
     Texture m_dummyTex;
     VkSampler m_sampler = VK_NULL_HANDLE;
@@ -50,19 +107,105 @@ private:
     VkPipeline m_skinnedPipeline = VK_NULL_HANDLE;
     VkPipeline m_pipelineWireframe = VK_NULL_HANDLE;
     VkPipeline m_skinnedPipelineWireframe = VK_NULL_HANDLE;
+    VkPipeline m_instancedPipeline = VK_NULL_HANDLE;
+    VkPipeline m_instancedPipelineWireframe = VK_NULL_HANDLE;
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
     bool m_wireframe = false;
 
-    VkFramebuffer m_framebuffer;
+    VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
 
     VkRenderPass m_renderPass = VK_NULL_HANDLE;
 
     VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
 
-    std::map<uint64_t, VkDescriptorSet> cachedDescriptors;
+    std::map<DescriptorKey, VkDescriptorSet> cachedDescriptors;
 
     Texture m_depthTexture;
     Texture m_compositeTexture;
 
     Device &m_device;
+    UniformRing m_uniformRing;
+
+    FrustumCuller m_culler;
+    LodSelector m_lodSelector;
+    SkinningPass m_skinning;
+    std::vector<PreparedModel> m_preparedModels;
+    std::vector<PreparedPart> m_preparedParts;
+    // the LOD each model is drawn at, or nullptr if it isn't, for the skinning pass
+    std::vector<const RenderLod *> m_modelLods;
+
+    // one pool per recording job and frame in flight, so they can be reset without waiting on the GPU
+    struct RecordingPool {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    };
+    std::array<std::vector<RecordingPool>, FrameScheduler::maxFramesInFlight> m_recordingPools;
+    bool m_parallelRecording = false;
+
+    /// Every placement of the same part of a mesh with the same material, drawn with one vkCmdDrawIndexed.
+    struct InstanceBatch {
+        // the first placement, whose buffers the others share
+        const DrawObject *model = nullptr;
+        const RenderPart *part = nullptr;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        int materialType = 0;
+        uint32_t boneOffset = 0;
+        uint32_t firstInstance = 0;
+        std::vector<glm::mat4> transforms;
+    };
+
+    struct InstanceBuffer {
+        Buffer buffer;
+        size_t capacity = 0;
+    };
+
+    bool m_instancing = true;
+    std::vector<InstanceBatch> m_instanceBatches;
+    std::array<InstanceBuffer, FrameScheduler::maxFramesInFlight> m_instanceBuffers;
+
+    // matches Instance in cull.comp
+    struct GpuInstance {
+        glm::vec4 sphere;
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+        uint32_t group = 0;
+        uint32_t firstCommand = 0;
+        uint32_t padding[3] = {};
+    };
+
+    struct CullPushConstants {
+        std::array<glm::vec4, 6> planes;
+        uint32_t instanceCount = 0;
+    };
+
+    /// Parts of a model that share a descriptor set, drawn with a single vkCmdDrawIndexedIndirectCount.
+    struct IndirectGroup {
+        size_t model = 0;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        int materialType = 0;
+        uint32_t firstCommand = 0;
+        uint32_t maxCount = 0;
+    };
+
+    struct GpuCullingFrame {
+        Buffer instances, commands, counts;
+        size_t instanceCapacity = 0;
+        size_t groupCapacity = 0;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+        // what was last uploaded, so the counts can be read back once the GPU is done
+        uint32_t instanceCount = 0;
+        uint32_t groupCount = 0;
+    };
+
+    bool m_gpuCulling = false;
+    std::vector<IndirectGroup> m_indirectGroups;
+    std::array<GpuCullingFrame, FrameScheduler::maxFramesInFlight> m_gpuCullingFrames;
+    VkDescriptorSetLayout m_cullSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+
+    // declared last, so recording jobs are finished before anything they use is destroyed
+    QThreadPool m_recordingThreads;
 };
\ No newline at end of file
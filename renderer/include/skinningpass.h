@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "framescheduler.h"
+#include "uniformring.h"
+
+class Device;
+struct DrawObject;
+struct RenderLod;
+
+/// Skins the vertices of skinned DrawObjects in a compute shader, into a buffer that every later pass draws like an unskinned mesh.
+/// Only the LOD a model is drawn at is skinned, and it's only skinned again once its boneDataVersion or LOD changes,
+/// so a pose that holds still costs nothing after the first frame.
+/// This can be turned off with NOVUS_NO_COMPUTE_SKINNING=1, then the vertex shaders skin every vertex in every pass instead.
+class SkinningPass
+{
+public:
+    explicit SkinningPass(Device &device);
+    ~SkinningPass();
+
+    bool enabled() const;
+
+    /// Skins every model in @p models whose pose or LOD changed since it was last skinned. Has to be recorded outside of a render pass.
+    /// @p lods is the LOD each model is drawn at this frame, in the same order, or nullptr for models that aren't drawn.
+    void update(VkCommandBuffer commandBuffer, uint32_t currentFrame, const std::vector<DrawObject> &models, const std::vector<const RenderLod *> &lods);
+
+    struct SkinnedVertices {
+        /// VK_NULL_HANDLE if the model isn't skinned by this pass, and has to be skinned while drawing instead.
+        VkBuffer buffer = VK_NULL_HANDLE;
+        /// The buffer only holds the vertices of the LOD that was skinned, so this is subtracted from RenderPart::vertexOffset.
+        int32_t firstVertex = 0;
+    };
+
+    /// The skinned vertices of @p model, laid out like the range of its vertex buffer the LOD it's drawn at covers.
+    SkinnedVertices skinnedVertices(const DrawObject &model) const;
+
+private:
+    struct SkinnedModel {
+        Buffer vertices;
+        // the vertex buffer, range of it and pose the vertices were skinned from
+        VkBuffer source = VK_NULL_HANDLE;
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint64_t boneDataVersion = 0;
+        // the bones are bound with the range of the palette, so the set is written again when its size changes
+        size_t boneCount = 0;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        bool skinned = false;
+        bool seen = false;
+    };
+
+    struct PushConstants {
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t stride = 0;
+        uint32_t positionOffset = 0;
+        uint32_t normalOffset = 0;
+        uint32_t bitangentOffset = 0;
+        uint32_t boneWeightOffset = 0;
+        uint32_t boneIdOffset = 0;
+    };
+
+    void initPipeline();
+    bool createSkinnedModel(SkinnedModel &skinnedModel, const DrawObject &model, const RenderLod &lod);
+    void release(SkinnedModel &skinnedModel, uint32_t currentFrame);
+
+    Device &m_device;
+    bool m_enabled = false;
+
+    UniformRing m_boneRing;
+    std::unordered_map<uint64_t, SkinnedModel> m_models;
+
+    // resources of models that went away, destroyed once the frame that last used them is finished
+    std::array<std::vector<Buffer>, FrameScheduler::maxFramesInFlight> m_retiredBuffers;
+    std::array<std::vector<VkDescriptorSet>, FrameScheduler::maxFramesInFlight> m_retiredDescriptorSets;
+
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+};
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <QMutex>
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "framescheduler.h"
+
+class Device;
+
+/// Streams data into device local buffers through a persistently mapped staging buffer.
+/// Uploads can be queued from any thread, and are recorded into the next frame's command buffer.
+class StagingRing
+{
+public:
+    StagingRing(Device &device, VkDeviceSize size);
+    ~StagingRing();
+
+    /// Copies @p size bytes of @p data into @p buffer at @p offset. If the ring is full, this falls back to a blocking upload.
+    void uploadToBuffer(const Buffer &buffer, const void *data, size_t size, VkDeviceSize offset = 0);
+
+    /// Records all pending copies into @p commandBuffer, followed by a barrier so they are visible to vertex input and compute shaders.
+    void flush(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    /// Drops every copy into @p buffer that wasn't recorded yet. Call this before @p buffer is destroyed or retired.
+    void cancel(VkBuffer buffer);
+
+    /// Call this once the frame at @p frameIndex is known to be finished on the GPU, releasing its part of the ring.
+    void retireFrame(uint32_t frameIndex);
+
+    /// How many bytes were recorded in the last flush.
+    VkDeviceSize bytesUploadedLastFrame() const;
+
+private:
+    void uploadImmediately(const Buffer &buffer, const void *data, size_t size, VkDeviceSize offset);
+
+    struct PendingCopy {
+        VkBuffer destination = VK_NULL_HANDLE;
+        VkBufferCopy region = {};
+    };
+
+    Device &m_device;
+    Buffer m_buffer;
+
+    // these grow forever, and are wrapped around the ring size when used as an offset
+    VkDeviceSize m_head = 0;
+    VkDeviceSize m_tail = 0;
+    std::array<VkDeviceSize, FrameScheduler::maxFramesInFlight> m_frameHeads = {};
+
+    std::vector<PendingCopy> m_pendingCopies;
+    VkDeviceSize m_pendingBytes = 0;
+    VkDeviceSize m_lastFrameBytes = 0;
+
+    mutable QMutex m_mutex;
+};
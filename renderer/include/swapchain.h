@@ -3,29 +3,44 @@
 
 #pragma once
 
-#include <array>
 #include <vector>
 
 #include <vulkan/vulkan.h>
 
+#include "texture.h"
+
 class Device;
 
+/// The images frames are drawn into. Synchronizing with them is handled by the FrameScheduler.
+/// The present mode can be picked with NOVUS_PRESENT_MODE=fifo, mailbox or immediate, to measure latency without vsync.
+/// Otherwise MAILBOX is used when it's available.
 class SwapChain
 {
 public:
     SwapChain(Device &device, VkSurfaceKHR surface, int width, int height);
 
+    /// Renders into a single image instead of a surface, for when there's no window to present to.
+    /// The image is left in TRANSFER_SRC_OPTIMAL at the end of each frame, so it can be read back.
+    SwapChain(Device &device, int width, int height);
+
     void resize(VkSurfaceKHR surface, int width, int height);
 
+    /// Whether this renders into offscreenImage, and there's nothing to acquire or present.
+    bool isOffscreen() const;
+
     VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     VkExtent2D extent;
     std::vector<VkImage> swapchainImages;
     std::vector<VkImageView> swapchainViews;
-    std::array<VkFence, 3> inFlightFences;
-    std::array<VkSemaphore, 3> imageAvailableSemaphores, renderFinishedSemaphores;
-    uint32_t currentFrame = 0;
     VkFormat surfaceFormat;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+    Texture offscreenImage{};
 
 private:
+    VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR> &presentModes) const;
+
     Device &m_device;
+    // a windowed swapchain can also have a null handle, if the window was zero sized when it was created
+    bool m_offscreen = false;
 };
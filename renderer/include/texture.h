@@ -5,10 +5,12 @@
 
 #include <vulkan/vulkan.h>
 
+#include "memoryallocator.h"
+
 class Texture
 {
 public:
     VkImage image;
     VkImageView imageView;
-    VkDeviceMemory imageMemory;
-};
\ No newline at end of file
+    Allocation allocation;
+};
@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <functional>
+#include <list>
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+#include <physis.hpp>
+#include <vulkan/vulkan.h>
+
+class RenderManager;
+struct RenderTexture;
+
+/// Shares uploaded game textures between materials, keyed by their game path.
+/// Textures are kept around for a while after their last reference is released, so swapping gear back and forth doesn't upload them again.
+/// Once the unreferenced ones go over a memory budget, the least recently used are destroyed.
+class TextureCache
+{
+public:
+    explicit TextureCache(RenderManager &renderer);
+    ~TextureCache();
+
+    /// Returns the texture at @p path, calling @p loadFile and uploading it if it isn't resident yet.
+    /// Different textures are loaded in parallel, while concurrent calls for the same one wait for a single load.
+    /// Returns nullptr if the texture couldn't be loaded. Every successful call must be paired with release().
+    RenderTexture *acquire(const QString &path, const std::function<physis_Buffer()> &loadFile);
+
+    /// Drops a reference taken by acquire().
+    void release(RenderTexture *texture);
+
+    /// The number of textures currently resident.
+    qsizetype residentCount();
+
+private:
+    struct Entry {
+        RenderTexture *texture = nullptr;
+        int refCount = 0;
+
+        // another thread is loading it, and texture is still nullptr
+        bool loading = false;
+
+        // where it is in m_unused, if refCount is 0
+        std::list<QString>::iterator unused{};
+    };
+
+    /// Destroys unreferenced textures, starting with the least recently used, until they fit in the budget.
+    void evict();
+
+    /// Destroys @p texture once the GPU is no longer sampling it.
+    void destroy(RenderTexture *texture);
+
+    RenderManager &m_renderer;
+    QHash<QString, Entry> m_entries;
+    QHash<RenderTexture *, QString> m_paths;
+
+    // paths of textures without references, the least recently used first
+    std::list<QString> m_unused;
+    VkDeviceSize m_unusedBytes = 0;
+
+    QMutex m_mutex;
+    QWaitCondition m_loadFinished;
+};
@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <vector>
+
+#include <QMutex>
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+
+class Device;
+
+/// Uploads image data on the transfer queue without blocking the caller.
+/// Uploads are batched into a single submission, and completion is tracked with a timeline semaphore.
+class TextureUploader
+{
+public:
+    explicit TextureUploader(Device &device);
+    ~TextureUploader();
+
+    /// Copies @p data into a staging buffer and queues @p regions to be copied into @p image, which is left in SHADER_READ_ONLY_OPTIMAL.
+    /// The buffer offsets in @p regions are relative to @p data.
+    /// @return The timeline value that is signalled once the image is ready to be sampled.
+    uint64_t queueUpload(VkImage image, uint32_t mipLevels, const std::vector<VkBufferImageCopy> &regions, const void *data, size_t size);
+
+    /// Submits every queued upload in one batch. This is called by RenderManager each frame.
+    void submit();
+
+    /// Whether the upload that returned @p value is finished, as of the last submit() or wait().
+    bool isComplete(uint64_t value) const;
+
+    /// Blocks until the upload that returned @p value is finished, submitting it first if needed.
+    void wait(uint64_t value);
+
+    /// Whether nothing is queued or still being uploaded, as of the last submit().
+    bool isIdle() const;
+
+    /// The last value known to be signalled, which frames can safely wait on.
+    uint64_t completedValue() const;
+
+    VkSemaphore semaphore() const;
+
+private:
+    void collectFinishedBatches();
+
+    struct PendingUpload {
+        VkImage image = VK_NULL_HANDLE;
+        uint32_t mipLevels = 1;
+        Buffer stagingBuffer;
+        std::vector<VkBufferImageCopy> regions;
+    };
+
+    struct Batch {
+        uint64_t value = 0;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        std::vector<Buffer> stagingBuffers;
+    };
+
+    Device &m_device;
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+    VkSemaphore m_semaphore = VK_NULL_HANDLE;
+
+    std::vector<PendingUpload> m_pendingUploads;
+    size_t m_pendingBytes = 0;
+    std::vector<Batch> m_batches;
+
+    // the value the next submit() will signal
+    uint64_t m_nextValue = 1;
+    uint64_t m_completedValue = 0;
+
+    mutable QMutex m_mutex;
+};
@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <optional>
+#include <unordered_map>
+
+#include <QElapsedTimer>
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "framescheduler.h"
+
+class Device;
+
+/// A persistently mapped buffer for uniform and storage data, bound with dynamic offsets.
+/// Every frame in flight writes into its own region, so nothing is overwritten while the GPU may still be reading it.
+class UniformRing
+{
+public:
+    UniformRing(Device &device, VkDeviceSize sizePerFrame);
+    ~UniformRing();
+
+    /// Starts writing into the region for @p frameIndex. The previous frame that used it must be finished on the GPU.
+    void beginFrame(uint32_t frameIndex);
+
+    /// Copies @p data into the current region. At least @p reservedSize bytes are set aside for it,
+    /// for data bound with a larger range than it fills.
+    /// @return The dynamic offset to bind it at, or std::nullopt if the region is full. Those are counted in droppedLastFrame().
+    std::optional<uint32_t> push(const void *data, size_t size, size_t reservedSize = 0);
+
+    /// Same as above, but remembers the data as @p key at @p version.
+    std::optional<uint32_t> push(uint64_t key, uint64_t version, const void *data, size_t size, size_t reservedSize = 0);
+
+    /// If @p key was already pushed at @p version into the current region, returns its offset so it doesn't need to be copied again.
+    std::optional<uint32_t> find(uint64_t key, uint64_t version) const;
+
+    VkBuffer buffer() const;
+
+    /// How many bytes were copied into the ring during the last frame.
+    VkDeviceSize bytesWrittenLastFrame() const;
+
+    /// How many pushes didn't fit into the ring during the last frame, and were left out of it.
+    uint32_t droppedLastFrame() const;
+
+    /// Returns a version that has never been used before, for data pushed with a key.
+    static uint64_t nextVersion();
+
+private:
+    struct Entry {
+        uint64_t version = 0;
+        uint32_t offset = 0;
+    };
+
+    struct Region {
+        VkDeviceSize head = 0;
+        std::unordered_map<uint64_t, Entry> entries;
+    };
+
+    Device &m_device;
+    Buffer m_buffer;
+    VkDeviceSize m_regionSize = 0;
+    VkDeviceSize m_alignment = 0;
+
+    std::array<Region, FrameScheduler::maxFramesInFlight> m_regions;
+    uint32_t m_currentRegion = 0;
+
+    VkDeviceSize m_bytesWritten = 0;
+    VkDeviceSize m_lastFrameBytes = 0;
+
+    uint32_t m_dropped = 0;
+    uint32_t m_lastFrameDropped = 0;
+    QElapsedTimer m_dropWarningTimer;
+};
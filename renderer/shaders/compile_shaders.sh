@@ -3,7 +3,6 @@
 # SPDX-License-Identifier: CC0-1.0
 
 glslc mesh.vert -o mesh.vert.spv &&
-glslc skinned.vert -o skinned.vert.spv &&
 glslc mesh.frag -o mesh.frag.spv &&
 glslc imgui.vert -o imgui.vert.spv &&
 glslc imgui.frag -o imgui.frag.spv &&
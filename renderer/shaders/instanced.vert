@@ -0,0 +1,36 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: CC0-1.0
+
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV0;
+layout(location = 2) in vec2 inUV1;
+layout(location = 3) in vec3 inNormal;
+layout(location = 4) in vec4 inBiTangent;
+layout(location = 5) in vec4 inColor;
+layout(location = 6) in vec4 inBoneWeights;
+layout(location = 7) in uvec4 inBoneIds;
+
+// per instance, instead of the model matrix in the push constants
+layout(location = 8) in mat4 inModel;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec3 outFragPos;
+layout(location = 2) out vec2 outUV;
+
+layout(std430, push_constant) uniform PushConstant {
+	mat4 vp, model;
+	int boneOffset;
+    int type;
+};
+
+void main() {
+    vec4 bPos = inModel * vec4(inPosition, 1.0);
+    vec4 bNor = vec4(inNormal, 0.0);
+
+    gl_Position = vp * bPos;
+    outNormal = bNor.xyz;
+    outFragPos = bPos.xyz;
+    outUV = inUV0;
+}
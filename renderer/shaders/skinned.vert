@@ -27,20 +27,24 @@ layout(std430, push_constant) uniform PushConstant {
     int type;
 };
 
+// the top three rows of each bone's transform, bound with exactly the range of the model's palette
 layout(std430, binding = 2) buffer readonly BoneInformation {
-    mat4 bones[128];
+    mat3x4 bones[];
 };
 
-void main() {
-    mat4 BoneTransform = bones[boneOffset + inBoneIds[0]] * inBoneWeights[0];
-    BoneTransform += bones[boneOffset + inBoneIds[1]] * inBoneWeights[1];
-    BoneTransform += bones[boneOffset + inBoneIds[2]] * inBoneWeights[2];
-    BoneTransform += bones[boneOffset + inBoneIds[3]] * inBoneWeights[3];
+// ids past the palette, from a model that was affected by more bones than fit, are clamped to stay inside of it
+mat3x4 bone(uint id) {
+    return bones[min(id, uint(bones.length()) - 1)];
+}
 
-    BoneTransform = model * BoneTransform;
+void main() {
+    mat3x4 BoneTransform = bone(inBoneIds[0]) * inBoneWeights[0];
+    BoneTransform += bone(inBoneIds[1]) * inBoneWeights[1];
+    BoneTransform += bone(inBoneIds[2]) * inBoneWeights[2];
+    BoneTransform += bone(inBoneIds[3]) * inBoneWeights[3];
 
-    vec4 bPos = BoneTransform * vec4(inPosition, 1.0);
-    vec4 bNor = BoneTransform * vec4(inNormal, 0.0);
+    vec4 bPos = model * vec4(vec4(inPosition, 1.0) * BoneTransform, 1.0);
+    vec4 bNor = model * vec4(vec4(inNormal, 0.0) * BoneTransform, 0.0);
 
     gl_Position = vp * bPos;
     outNormal = bNor.xyz;
@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "culling.h"
+
+#include <QByteArray>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <physis.hpp>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "camera.h"
+#include "drawobject.h"
+
+BoundingBox BoundingBox::fromVertices(const Vertex *vertices, const size_t count)
+{
+    if (count == 0) {
+        return {};
+    }
+
+#if defined(__SSE__)
+    // the position is followed by more floats in Vertex, so reading four at a time stays inside it. the fourth lane is ignored
+    __m128 minimum = _mm_loadu_ps(vertices[0].position);
+    __m128 maximum = minimum;
+    for (size_t i = 1; i < count; i++) {
+        const __m128 position = _mm_loadu_ps(vertices[i].position);
+        minimum = _mm_min_ps(minimum, position);
+        maximum = _mm_max_ps(maximum, position);
+    }
+
+    alignas(16) float minimumLanes[4];
+    alignas(16) float maximumLanes[4];
+    _mm_store_ps(minimumLanes, minimum);
+    _mm_store_ps(maximumLanes, maximum);
+
+    return {glm::vec3(minimumLanes[0], minimumLanes[1], minimumLanes[2]), glm::vec3(maximumLanes[0], maximumLanes[1], maximumLanes[2])};
+#else
+    BoundingBox box;
+    box.min = glm::vec3(std::numeric_limits<float>::max());
+    box.max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3 position(vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]);
+        box.min = glm::min(box.min, position);
+        box.max = glm::max(box.max, position);
+    }
+
+    return box;
+#endif
+}
+
+BoundingBox BoundingBox::merged(const BoundingBox &other) const
+{
+    return {glm::min(min, other.min), glm::max(max, other.max)};
+}
+
+BoundingSphere BoundingSphere::fromVertices(const BoundingBox &box, const Vertex *vertices, const size_t count)
+{
+    BoundingSphere sphere;
+    sphere.center = (box.min + box.max) * 0.5f;
+
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3 position(vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]);
+        const glm::vec3 offset = position - sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    sphere.radius = std::sqrt(radiusSquared);
+
+    return sphere;
+}
+
+Frustum::Frustum(const glm::mat4 &viewProjection)
+{
+    // rows of the matrix, glm stores it column-major
+    const auto row = [&viewProjection](const int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+
+    m_planes[0] = row(3) + row(0); // left
+    m_planes[1] = row(3) - row(0); // right
+    m_planes[2] = row(3) + row(1); // bottom
+    m_planes[3] = row(3) - row(1); // top
+    m_planes[4] = row(2); // near, the depth range starts at 0 instead of -1
+    m_planes[5] = row(3) - row(2); // far
+
+    for (auto &plane : m_planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersects(const BoundingSphere &sphere, const glm::vec3 &translation) const
+{
+    const glm::vec3 center = sphere.center + translation;
+    return std::all_of(m_planes.cbegin(), m_planes.cend(), [&center, &sphere](const glm::vec4 &plane) {
+        return glm::dot(glm::vec3(plane), center) + plane.w >= -sphere.radius;
+    });
+}
+
+bool Frustum::intersects(const BoundingBox &box, const glm::vec3 &translation) const
+{
+    const glm::vec3 min = box.min + translation;
+    const glm::vec3 max = box.max + translation;
+
+    // only the corner furthest along the plane's normal needs to be tested
+    return std::all_of(m_planes.cbegin(), m_planes.cend(), [&min, &max](const glm::vec4 &plane) {
+        const glm::vec3 corner(plane.x > 0.0f ? max.x : min.x, plane.y > 0.0f ? max.y : min.y, plane.z > 0.0f ? max.z : min.z);
+        return glm::dot(glm::vec3(plane), corner) + plane.w >= 0.0f;
+    });
+}
+
+const std::array<glm::vec4, 6> &Frustum::planes() const
+{
+    return m_planes;
+}
+
+FrustumCuller::FrustumCuller()
+    : m_frustum(glm::mat4(1.0f))
+{
+    m_enabled = qgetenv("NOVUS_NO_CULLING") != QByteArrayLiteral("1");
+}
+
+void FrustumCuller::beginFrame(const Camera &camera)
+{
+    m_frustum = Frustum(camera.perspective * camera.view);
+    m_statistics = {};
+}
+
+bool FrustumCuller::isVisible(const DrawObject &model, const RenderLod &lod, const glm::vec3 &translation)
+{
+    const bool visible = !m_enabled
+        || (m_frustum.intersects(model.boundingSphere, translation) && m_frustum.intersects(model.boundingBox, translation));
+
+    if (visible) {
+        m_statistics.visibleObjects++;
+    } else {
+        m_statistics.culledObjects++;
+        // none of its parts are looked at, but they still count as culled
+        m_statistics.culledParts += lod.parts.size();
+    }
+
+    return visible;
+}
+
+bool FrustumCuller::isVisible(const RenderPart &part, const glm::vec3 &translation)
+{
+    const bool visible = !m_enabled
+        || (m_frustum.intersects(part.boundingSphere, translation) && m_frustum.intersects(part.boundingBox, translation));
+
+    if (visible) {
+        m_statistics.visibleParts++;
+    } else {
+        m_statistics.culledParts++;
+    }
+
+    return visible;
+}
+
+void FrustumCuller::addPartStatistics(const uint32_t visible, const uint32_t culled)
+{
+    m_statistics.visibleParts += visible;
+    m_statistics.culledParts += culled;
+}
+
+const CullingStatistics &FrustumCuller::statistics() const
+{
+    return m_statistics;
+}
+
+const Frustum &FrustumCuller::frustum() const
+{
+    return m_frustum;
+}
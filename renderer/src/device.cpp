@@ -5,10 +5,11 @@
 
 #include <QFile>
 
-Buffer Device::createBuffer(const size_t size, const VkBufferUsageFlags usageFlags)
-{
-    vkDeviceWaitIdle(device);
+#include "memoryallocator.h"
+#include "stagingring.h"
 
+Buffer Device::createBuffer(const size_t size, const VkBufferUsageFlags usageFlags, const VkMemoryPropertyFlags memoryProperties)
+{
     // create buffer
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -19,29 +20,38 @@ Buffer Device::createBuffer(const size_t size, const VkBufferUsageFlags usageFla
     VkBuffer handle;
     vkCreateBuffer(device, &bufferInfo, nullptr, &handle);
 
-    // allocate memory
+    // sub-allocate memory
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, handle, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    VkDeviceMemory memory;
-    vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+    const Allocation allocation = allocator->allocate(memRequirements, memoryProperties, true);
+    if (allocation.memory == VK_NULL_HANDLE) {
+        qFatal("Failed to allocate memory for a buffer of %zu bytes!", size);
+    }
 
-    vkBindBufferMemory(device, handle, memory, 0);
+    vkBindBufferMemory(device, handle, allocation.memory, allocation.offset);
 
-    return {handle, memory, size};
+    return {handle, allocation, size};
 }
 
 void Device::copyToBuffer(Buffer &buffer, void *data, const size_t size)
 {
-    void *mapped_data;
-    vkMapMemory(device, buffer.memory, 0, size, 0, &mapped_data);
-    memcpy(mapped_data, data, size);
-    vkUnmapMemory(device, buffer.memory);
+    // host visible allocations are persistently mapped
+    memcpy(buffer.allocation.mapped, data, size);
+}
+
+void Device::destroyBuffer(Buffer &buffer)
+{
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        // a copy recorded after this would write into a freed handle
+        if (stagingRing != nullptr) {
+            stagingRing->cancel(buffer.buffer);
+        }
+        vkDestroyBuffer(device, buffer.buffer, nullptr);
+    }
+    allocator->free(buffer.allocation);
+
+    buffer = {};
 }
 
 uint32_t Device::findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties)
@@ -88,7 +98,6 @@ Texture Device::createTexture(const int width, const int height, const VkFormat
 {
     VkImage image;
     VkImageView imageView;
-    VkDeviceMemory imageMemory;
 
     VkImageCreateInfo imageCreateInfo = {};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -110,14 +119,12 @@ Texture Device::createTexture(const int width, const int height, const VkFormat
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = memRequirements.size;
-    allocateInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    vkAllocateMemory(device, &allocateInfo, nullptr, &imageMemory);
+    const Allocation allocation = allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    if (allocation.memory == VK_NULL_HANDLE) {
+        qFatal("Failed to allocate memory for a %dx%d image!", width, height);
+    }
 
-    vkBindImageMemory(device, image, imageMemory, 0);
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
 
     VkImageViewCreateInfo viewCreateInfo = {};
     viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -131,45 +138,27 @@ Texture Device::createTexture(const int width, const int height, const VkFormat
 
     vkCreateImageView(device, &viewCreateInfo, nullptr, &imageView);
 
-    return {image, imageView, imageMemory};
+    return {image, imageView, allocation};
 }
 
-Texture Device::createDummyTexture()
+void Device::destroyTexture(Texture &texture)
 {
-    auto texture = createTexture(1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-
-    // copy image data
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    vkDestroyImageView(device, texture.imageView, nullptr);
+    vkDestroyImage(device, texture.image, nullptr);
+    allocator->free(texture.allocation);
 
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = 4;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer);
-
-    // allocate staging memory
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    vkAllocateMemory(device, &allocInfo, nullptr, &stagingBufferMemory);
+    texture = {};
+}
 
-    vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0);
+Texture Device::createDummyTexture()
+{
+    auto texture = createTexture(1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 
     uint8_t dummydata[4] = {255, 255, 255, 255};
 
     // copy to staging buffer
-    void *mapped_data;
-    vkMapMemory(device, stagingBufferMemory, 0, 4 * sizeof(uint8_t), 0, &mapped_data);
-    memcpy(mapped_data, dummydata, 4 * sizeof(uint8_t));
-    vkUnmapMemory(device, stagingBufferMemory);
+    auto stagingBuffer = createBuffer(4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    copyToBuffer(stagingBuffer, dummydata, 4 * sizeof(uint8_t));
 
     // copy staging buffer to image
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -195,7 +184,7 @@ Texture Device::createDummyTexture()
     region.imageSubresource.layerCount = 1;
     region.imageExtent = {(uint32_t)1, (uint32_t)1, 1};
 
-    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
     inlineTransitionImageLayout(commandBuffer,
                                 texture.image,
@@ -207,6 +196,8 @@ Texture Device::createDummyTexture()
 
     endSingleTimeCommands(commandBuffer);
 
+    destroyBuffer(stagingBuffer);
+
     return texture;
 }
 
@@ -248,8 +239,11 @@ void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer)
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    {
+        QMutexLocker locker(&queueMutex);
+        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(graphicsQueue);
+    }
 
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "framescheduler.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+#include "device.h"
+
+FrameScheduler::FrameScheduler(Device &device)
+    : m_device(device)
+{
+    if (qEnvironmentVariableIsSet("NOVUS_FRAMES_IN_FLIGHT")) {
+        const int framesInFlight = qEnvironmentVariableIntValue("NOVUS_FRAMES_IN_FLIGHT");
+        m_framesInFlight = std::clamp<uint32_t>(framesInFlight, 1, maxFramesInFlight);
+        qInfo() << "Using" << m_framesInFlight << "frames in flight";
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo timelineCreateInfo = {};
+    timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineCreateInfo.pNext = &timelineInfo;
+
+    vkCreateSemaphore(m_device.device, &timelineCreateInfo, nullptr, &m_timeline);
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    // the whole pool is reset at the start of each frame, instead of each command buffer
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = m_device.graphicsFamilyIndex;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        Frame &frame = m_frames[i];
+
+        vkCreateCommandPool(m_device.device, &poolInfo, nullptr, &frame.commandPool);
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        vkAllocateCommandBuffers(m_device.device, &allocInfo, &frame.commandBuffer);
+
+        vkCreateSemaphore(m_device.device, &semaphoreInfo, nullptr, &frame.imageAvailable);
+    }
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    waitIdle();
+
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        Frame &frame = m_frames[i];
+
+        vkDestroySemaphore(m_device.device, frame.imageAvailable, nullptr);
+        vkDestroyCommandPool(m_device.device, frame.commandPool, nullptr);
+    }
+
+    for (const auto semaphore : m_renderFinished) {
+        vkDestroySemaphore(m_device.device, semaphore, nullptr);
+    }
+
+    vkDestroySemaphore(m_device.device, m_timeline, nullptr);
+}
+
+uint32_t FrameScheduler::framesInFlight() const
+{
+    return m_framesInFlight;
+}
+
+VkCommandBuffer FrameScheduler::beginFrame()
+{
+    Frame &frame = m_frames[m_frameIndex];
+
+    wait(frame.value);
+    collectRetired();
+
+    vkResetCommandPool(m_device.device, frame.commandPool, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+
+    return frame.commandBuffer;
+}
+
+void FrameScheduler::endFrame()
+{
+    {
+        QMutexLocker locker(&m_retiredMutex);
+        m_submittedValue++;
+    }
+
+    m_frames[m_frameIndex].value = m_submittedValue;
+    m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
+}
+
+uint32_t FrameScheduler::frameIndex() const
+{
+    return m_frameIndex;
+}
+
+VkSemaphore FrameScheduler::timelineSemaphore() const
+{
+    return m_timeline;
+}
+
+uint64_t FrameScheduler::frameValue() const
+{
+    return m_submittedValue + 1;
+}
+
+VkSemaphore FrameScheduler::imageAvailableSemaphore() const
+{
+    return m_frames[m_frameIndex].imageAvailable;
+}
+
+VkSemaphore FrameScheduler::renderFinishedSemaphore(const uint32_t imageIndex) const
+{
+    return m_renderFinished[imageIndex];
+}
+
+void FrameScheduler::setSwapchainImageCount(const uint32_t imageCount)
+{
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    while (m_renderFinished.size() < imageCount) {
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        vkCreateSemaphore(m_device.device, &semaphoreInfo, nullptr, &semaphore);
+        m_renderFinished.push_back(semaphore);
+    }
+}
+
+void FrameScheduler::retire(std::function<void()> destroy)
+{
+    QMutexLocker locker(&m_retiredMutex);
+
+    // the frame being recorded may already use it, so it has to finish too
+    m_retired.push_back({m_submittedValue + 1, std::move(destroy)});
+}
+
+void FrameScheduler::waitIdle()
+{
+    wait(m_submittedValue);
+
+    QMutexLocker locker(&m_retiredMutex);
+    while (!m_retired.empty()) {
+        m_retired.front().destroy();
+        m_retired.pop_front();
+    }
+}
+
+void FrameScheduler::wait(const uint64_t value)
+{
+    if (value == 0) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_timeline;
+    waitInfo.pValues = &value;
+
+    vkWaitSemaphores(m_device.device, &waitInfo, std::numeric_limits<uint64_t>::max());
+}
+
+void FrameScheduler::collectRetired()
+{
+    uint64_t completedValue = 0;
+    vkGetSemaphoreCounterValue(m_device.device, m_timeline, &completedValue);
+
+    QMutexLocker locker(&m_retiredMutex);
+    while (!m_retired.empty() && m_retired.front().value <= completedValue) {
+        m_retired.front().destroy();
+        m_retired.pop_front();
+    }
+}
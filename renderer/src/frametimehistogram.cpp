@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "frametimehistogram.h"
+
+#include <QStringList>
+#include <algorithm>
+
+void FrameTimeHistogram::record(const double milliseconds)
+{
+    const auto limit = std::lower_bound(bucketLimits.cbegin(), bucketLimits.cend(), milliseconds);
+    m_buckets[std::distance(bucketLimits.cbegin(), limit)]++;
+
+    m_frameCount++;
+    if (milliseconds > hitchThreshold) {
+        m_hitchCount++;
+    }
+    m_slowest = std::max(m_slowest, milliseconds);
+}
+
+void FrameTimeHistogram::reset()
+{
+    m_buckets = {};
+    m_frameCount = 0;
+    m_hitchCount = 0;
+    m_slowest = 0.0;
+}
+
+uint64_t FrameTimeHistogram::frameCount() const
+{
+    return m_frameCount;
+}
+
+uint64_t FrameTimeHistogram::hitchCount() const
+{
+    return m_hitchCount;
+}
+
+QString FrameTimeHistogram::summary() const
+{
+    QStringList buckets;
+    for (size_t i = 0; i < m_buckets.size(); i++) {
+        const QString label = i < bucketLimits.size() ? QStringLiteral("<%1ms").arg(bucketLimits[i]) : QStringLiteral(">%1ms").arg(bucketLimits.back());
+        buckets.push_back(QStringLiteral("%1: %2").arg(label).arg(m_buckets[i]));
+    }
+
+    return QStringLiteral("%1 frames, %2 hitches, slowest %3ms [%4]")
+        .arg(m_frameCount)
+        .arg(m_hitchCount)
+        .arg(m_slowest, 0, 'f', 1)
+        .arg(buckets.join(QStringLiteral(", ")));
+}
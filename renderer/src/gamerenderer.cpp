@@ -3,9 +3,14 @@
 
 #include "gamerenderer.h"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 
 #include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
 
 #include <glm/ext/matrix_clip_space.hpp>
 #include <physis.hpp>
@@ -14,8 +19,11 @@
 #include "camera.h"
 #include "dxbc_module.h"
 #include "dxbc_reader.h"
+#include "pipelinecache.h"
+#include "profiler.h"
 #include "rendermanager.h"
 #include "swapchain.h"
+#include "textureuploader.h"
 
 // TODO: maybe need UV?
 // note: SQEX passes the vertice positions as UV coordinates (yes, -1 to 1.) the shaders then transform them back with the g_CommonParameter.m_RenderTarget vec4
@@ -31,6 +39,10 @@ const std::vector<glm::vec4> planeVertices = {
 
 dxvk::Logger dxvk::Logger::s_instance("dxbc.log");
 
+// DrawObject::boneData is copied into g_JointMatrixArray without repacking, which has less room than a palette can have
+const size_t maxJoints = sizeof(JointMatrixArray) / sizeof(glm::mat3x4);
+static_assert(maxJoints <= DrawObject::maxBones);
+
 const std::array<std::string, 14> passes = {
     // Shadows?
     "PASS_0",
@@ -54,10 +66,23 @@ const std::array<std::string, 14> passes = {
 
 const int INVALID_PASS = 255;
 
+/// Where @p name is in passes, which is also its index in a shader package node.
+static int passIndex(const std::string_view name)
+{
+    return std::distance(passes.cbegin(), std::find(passes.cbegin(), passes.cend(), name));
+}
+
 GameRenderer::GameRenderer(Device &device, GameData *data)
     : m_device(device)
     , m_data(data)
+    , m_uniformRing(device, 4 * 1024 * 1024)
+    , m_renderGraph(device)
+    , m_skinning(device)
 {
+    // compiling in the background can be turned off, to compare frame times against the old behavior
+    m_synchronousPipelines = qgetenv("NOVUS_SYNC_PIPELINES") == QByteArrayLiteral("1");
+    m_pipelinePool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() / 2));
+
     m_dummyTex = m_device.createDummyTexture();
     m_dummyBuffer = m_device.createDummyBuffer();
 
@@ -68,9 +93,96 @@ GameRenderer::GameRenderer(Device &device, GameData *data)
     directionalLightningShpk = physis_parse_shpk(physis_gamedata_extract_file(m_data, "shader/sm5/shpk/directionallighting.shpk"));
     createViewPositionShpk = physis_parse_shpk(physis_gamedata_extract_file(m_data, "shader/sm5/shpk/createviewposition.shpk"));
 
-    // camera data
     {
-        g_CameraParameter = m_device.createBuffer(sizeof(CameraParameter), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        std::vector<uint32_t> systemKeys = {
+            physis_shpk_crc("DecodeDepthBuffer_RAWZ"),
+        };
+        std::vector<uint32_t> sceneKeys = {
+            physis_shpk_crc("GetDirectionalLight_Enable"),
+            physis_shpk_crc("GetFakeSpecular_Disable"),
+            physis_shpk_crc("GetUnderWaterLighting_Disable"),
+        };
+        std::vector<uint32_t> subviewKeys = {
+            physis_shpk_crc("Default"),
+            physis_shpk_crc("SUB_VIEW_MAIN"),
+        };
+
+        const uint32_t viewPositionSelector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
+                                                                                       systemKeys.size(),
+                                                                                       nullptr,
+                                                                                       0,
+                                                                                       nullptr,
+                                                                                       0,
+                                                                                       subviewKeys.data(),
+                                                                                       subviewKeys.size());
+        m_createViewPositionNode = physis_shpk_get_node(&createViewPositionShpk, viewPositionSelector);
+
+        const uint32_t directionalLightingSelector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
+                                                                                             systemKeys.size(),
+                                                                                             sceneKeys.data(),
+                                                                                             sceneKeys.size(),
+                                                                                             nullptr,
+                                                                                             0,
+                                                                                             subviewKeys.data(),
+                                                                                             subviewKeys.size());
+        m_directionalLightningNode = physis_shpk_get_node(&directionalLightningShpk, directionalLightingSelector);
+    }
+
+    // the passes we know how to render, images are created when the graph is compiled in createImageResources()
+    {
+        const VkClearColorValue clearColor = {{0.24f, 0.24f, 0.24f, 1.0f}};
+
+        m_normalGBuffer = m_renderGraph.createImage("normal", VK_FORMAT_R8G8B8A8_UNORM);
+        m_viewPositionBuffer = m_renderGraph.createImage("view position", VK_FORMAT_R8G8B8A8_UNORM);
+        m_depthBuffer = m_renderGraph.createImage("depth", VK_FORMAT_D32_SFLOAT);
+        m_compositeBuffer = m_renderGraph.createImage("composite", VK_FORMAT_R8G8B8A8_UNORM);
+        m_renderGraph.markOutput(m_compositeBuffer);
+
+        const int zOpaqueIndex = passIndex("PASS_Z_OPAQUE");
+        m_renderGraph
+            .addPass("PASS_Z_OPAQUE",
+                     [this, zOpaqueIndex](VkCommandBuffer commandBuffer) {
+                         drawModels(commandBuffer, "PASS_Z_OPAQUE", zOpaqueIndex);
+                     })
+            .writeColor(m_compositeBuffer, clearColor)
+            .skipColor();
+
+        // normals, and two more outputs we don't know the purpose of yet
+        const int gOpaqueIndex = passIndex("PASS_G_OPAQUE");
+        m_renderGraph
+            .addPass("PASS_G_OPAQUE",
+                     [this, gOpaqueIndex](VkCommandBuffer commandBuffer) {
+                         drawModels(commandBuffer, "PASS_G_OPAQUE", gOpaqueIndex);
+                     })
+            .writeColor(m_normalGBuffer, clearColor)
+            .skipColor()
+            .skipColor()
+            .writeDepth(m_depthBuffer, 1.0f);
+
+        // the lighting pass first needs the view positions, which are generated by createviewposition
+        const int lightingIndex = passIndex("PASS_LIGHTING_OPAQUE");
+        m_renderGraph
+            .addPass("PASS_LIGHTING_OPAQUE_VIEWPOSITION",
+                     [this, lightingIndex](VkCommandBuffer commandBuffer) {
+                         drawFullscreen(commandBuffer,
+                                        "PASS_LIGHTING_OPAQUE_VIEWPOSITION",
+                                        lightingIndex,
+                                        createViewPositionShpk,
+                                        m_createViewPositionNode);
+                     })
+            .read(m_depthBuffer)
+            .writeColor(m_viewPositionBuffer, clearColor);
+
+        m_renderGraph
+            .addPass("PASS_LIGHTING_OPAQUE",
+                     [this, lightingIndex](VkCommandBuffer commandBuffer) {
+                         drawFullscreen(commandBuffer, "PASS_LIGHTING_OPAQUE", lightingIndex, directionalLightningShpk, m_directionalLightningNode);
+                     })
+            .read(m_normalGBuffer)
+            .read(m_viewPositionBuffer)
+            .read(m_depthBuffer)
+            .writeColor(m_compositeBuffer, clearColor)
+            .skipColor();
     }
 
     // instance data
@@ -81,22 +193,24 @@ GameRenderer::GameRenderer(Device &device, GameData *data)
         m_device.copyToBuffer(g_InstanceParameter, &instanceParameter, sizeof(InstanceParameter));
     }
 
-    // model data
+    // model data, this and the material data are written into the uniform ring when their version changes
     {
-        g_ModelParameter = m_device.createBuffer(sizeof(ModelParameter), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        m_modelVersion = UniformRing::nextVersion();
+    }
 
-        ModelParameter modelParameter{};
-        m_device.copyToBuffer(g_ModelParameter, &modelParameter, sizeof(ModelParameter));
+    // joints for models that were already skinned in a compute shader, so the game's shaders leave them where they are
+    {
+        for (auto &jointMatrix : m_identityJoints.g_JointMatrixArray) {
+            jointMatrix = toBoneMatrix(glm::mat4(1.0f));
+        }
+        m_identityJointsVersion = UniformRing::nextVersion();
     }
 
     // material data
     {
-        g_MaterialParameter = m_device.createBuffer(sizeof(MaterialParameters), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-
-        MaterialParameters materialParameter{};
-        materialParameter.parameters[0] = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
-        materialParameter.parameters[5].z = 1.0f;
-        m_device.copyToBuffer(g_MaterialParameter, &materialParameter, sizeof(MaterialParameters));
+        m_materialParameter.parameters[0] = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+        m_materialParameter.parameters[5].z = 1.0f;
+        m_materialVersion = UniformRing::nextVersion();
     }
 
     // light data
@@ -153,6 +267,30 @@ GameRenderer::GameRenderer(Device &device, GameData *data)
     createImageResources();
 }
 
+GameRenderer::~GameRenderer()
+{
+    // anything still compiling is added to the cache first, so it's destroyed with the rest
+    m_pipelinePool.waitForDone();
+    collectFinishedPipelines();
+
+    freeDescriptors();
+
+    for (const auto &[key, pipeline] : m_cachedPipelines) {
+        vkDestroyPipeline(m_device.device, pipeline.pipeline, nullptr);
+        vkDestroyPipelineLayout(m_device.device, pipeline.pipelineLayout, nullptr);
+        for (const auto setLayout : pipeline.setLayouts) {
+            vkDestroyDescriptorSetLayout(m_device.device, setLayout, nullptr);
+        }
+    }
+
+    for (auto buffer : {&g_InstanceParameter, &g_CommonParameter, &g_LightParam, &g_SceneParameter, &g_CustomizeParameter, &m_planeVertexBuffer, &m_dummyBuffer}) {
+        m_device.destroyBuffer(*buffer);
+    }
+
+    m_device.destroyTexture(m_dummyTex);
+    vkDestroySampler(m_device.device, m_sampler, nullptr);
+}
+
 void GameRenderer::render(VkCommandBuffer commandBuffer, uint32_t imageIndex, Camera &camera, const std::vector<DrawObject> &models)
 {
     // TODO: this shouldn't be here
@@ -173,741 +311,802 @@ void GameRenderer::render(VkCommandBuffer commandBuffer, uint32_t imageIndex, Ca
     cameraParameter.m_EyePosition = glm::vec3(5.0f); // placeholder
     cameraParameter.m_LookAtVector = glm::vec3(0.0f); // placeholder
 
-    m_device.copyToBuffer(g_CameraParameter, &cameraParameter, sizeof(CameraParameter));
-
-    int i = 0;
-    for (const auto pass : passes) {
-        // hardcoded to the known pass for now
-        if (pass == "PASS_G_OPAQUE" || pass == "PASS_Z_OPAQUE") {
-            beginPass(imageIndex, commandBuffer, pass);
-
-            for (auto &model : models) {
-                // copy bone data
-                {
-                    const size_t bufferSize = sizeof(glm::mat3x4) * 64;
-                    void *mapped_data = nullptr;
-                    vkMapMemory(m_device.device, model.boneInfoBuffer.memory, 0, bufferSize, 0, &mapped_data);
+    // only bump the version when the camera actually moved, so a still frame doesn't copy anything
+    if (m_cameraVersion == 0 || memcmp(&cameraParameter, &m_cameraParameter, sizeof(CameraParameter)) != 0) {
+        m_cameraParameter = cameraParameter;
+        m_cameraVersion = UniformRing::nextVersion();
+    }
 
-                    std::vector<glm::mat3x4> newBoneData(model.boneData.size());
-                    for (int i = 0; i < 64; i++) {
-                        newBoneData[i] = glm::transpose(model.boneData[i]);
-                    }
+    m_uniformRing.beginFrame(imageIndex);
+
+    Profiler &profiler = *m_device.profiler;
+    profiler.count(Profiler::UniformBytes, m_uniformRing.bytesWrittenLastFrame());
+    profiler.count(Profiler::UniformDrops, m_uniformRing.droppedLastFrame());
+
+    collectFinishedPipelines();
+
+    // every pass draws the same models, so their LOD is picked and they're culled only once
+    // the model's position isn't applied here yet, so its bounds are tested where it's actually drawn
+    m_culler.beginFrame(camera);
+    m_lodSelector.beginFrame(camera);
+    m_frame.lods.clear();
+    m_frame.firstPart.clear();
+    m_frame.partVisible.clear();
+    // and only the LOD of models that are drawn at all is skinned
+    std::vector<const RenderLod *> skinnedLods;
+    skinnedLods.reserve(models.size());
+    for (const auto &model : models) {
+        const RenderLod &lod = m_lodSelector.select(model, glm::vec3(0.0f));
+        m_frame.lods.push_back(&lod);
+        m_frame.firstPart.push_back(m_frame.partVisible.size());
+
+        if (!m_culler.isVisible(model, lod, glm::vec3(0.0f))) {
+            m_frame.partVisible.insert(m_frame.partVisible.end(), lod.parts.size(), false);
+            skinnedLods.push_back(nullptr);
+            continue;
+        }
 
-                    memcpy(mapped_data, newBoneData.data(), bufferSize);
+        for (const auto &part : lod.parts) {
+            m_frame.partVisible.push_back(m_culler.isVisible(part, glm::vec3(0.0f)));
+        }
+        skinnedLods.push_back(&lod);
+    }
 
-                    VkMappedMemoryRange range = {};
-                    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-                    range.memory = model.boneInfoBuffer.memory;
-                    range.size = bufferSize;
-                    vkFlushMappedMemoryRanges(m_device.device, 1, &range);
+    // recorded before any pass begins rendering, and before the joints below are picked
+    {
+        Profiler::GpuScope scope(profiler, commandBuffer, "Skinning");
+        m_skinning.update(commandBuffer, imageIndex, models, skinnedLods);
+    }
 
-                    vkUnmapMemory(m_device.device, model.boneInfoBuffer.memory);
-                }
+    // data shared by every draw this frame, the joint matrices are filled in per model
+    DynamicOffsets frameOffsets{};
+    {
+        const auto pushUniform = [this](const DynamicUniform uniform, const uint64_t version, const void *data, const size_t size) {
+            auto offset = m_uniformRing.find(uniform, version);
+            if (!offset) {
+                offset = m_uniformRing.push(uniform, version, data, size);
+            }
+            return offset;
+        };
 
-                for (const auto &part : model.parts) {
-                    auto &renderMaterial = model.materials[part.materialIndex];
+        const auto cameraOffset = pushUniform(CameraUniform, m_cameraVersion, &m_cameraParameter, sizeof(CameraParameter));
+        const auto modelOffset = pushUniform(ModelUniform, m_modelVersion, &m_modelParameter, sizeof(ModelParameter));
+        const auto materialOffset = pushUniform(MaterialUniform, m_materialVersion, &m_materialParameter, sizeof(MaterialParameters));
+        if (!cameraOffset || !modelOffset || !materialOffset) {
+            return;
+        }
 
-                    if (renderMaterial.shaderPackage.p_ptr == nullptr) {
-                        qWarning() << "Invalid shader package!";
-                    }
+        frameOffsets[CameraUniform] = *cameraOffset;
+        frameOffsets[ModelUniform] = *modelOffset;
+        frameOffsets[MaterialUniform] = *materialOffset;
+    }
 
-                    std::vector<uint32_t> systemKeys;
-                    if (renderMaterial.type == MaterialType::Skin) {
-                        systemKeys.push_back(physis_shpk_crc("DecodeDepthBuffer_RAWZ"));
-                    }
-                    std::vector<uint32_t> sceneKeys = {
-                        physis_shpk_crc("TransformViewSkin"),
-                        physis_shpk_crc("GetAmbientLight_SH"),
-                        physis_shpk_crc("GetReflectColor_Texture"),
-                        physis_shpk_crc("GetAmbientOcclusion_None"),
-                        physis_shpk_crc("ApplyDitherClipOff"),
-                    };
-                    std::vector<uint32_t> materialKeys;
-                    for (int j = 0; j < renderMaterial.shaderPackage.num_material_keys; j++) {
-                        auto value = renderMaterial.shaderPackage.material_keys[j].default_value;
-                        materialKeys.push_back(renderMaterial.shaderPackage.material_keys[j].default_value);
-                    }
-                    std::vector<uint32_t> subviewKeys = {physis_shpk_crc("Default"), physis_shpk_crc("SUB_VIEW_MAIN")};
+    // the same joint matrices are used in every pass, so upload them once up front
+    std::vector<std::optional<uint32_t>> jointOffsets(models.size());
+    for (size_t j = 0; j < models.size(); j++) {
+        const auto &model = models[j];
 
-                    const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
-                                                                                       systemKeys.size(),
-                                                                                       sceneKeys.data(),
-                                                                                       sceneKeys.size(),
-                                                                                       materialKeys.data(),
-                                                                                       materialKeys.size(),
-                                                                                       subviewKeys.data(),
-                                                                                       subviewKeys.size());
-                    const physis_SHPKNode node = physis_shpk_get_node(&renderMaterial.shaderPackage, selector);
+        if (m_skinning.skinnedVertices(model).buffer != VK_NULL_HANDLE) {
+            jointOffsets[j] = m_uniformRing.find(JointMatrixUniform, m_identityJointsVersion);
+            if (!jointOffsets[j]) {
+                jointOffsets[j] = m_uniformRing.push(JointMatrixUniform, m_identityJointsVersion, &m_identityJoints, sizeof(JointMatrixArray));
+            }
+            continue;
+        }
 
-                    // check if invalid
-                    if (node.pass_count == 0) {
-                        continue;
-                    }
+        // keys below DynamicUniformCount are taken by the per-frame data
+        const uint64_t jointKey = DynamicUniformCount + model.id;
 
-                    // this is an index into the node's pass array, not to get confused with the global one we always follow.
-                    const int passIndice = node.pass_indices[i];
-                    if (passIndice != INVALID_PASS) {
-                        const Pass currentPass = node.passes[passIndice];
+        // the game's shaders bind the whole array, so the joints past the palette are identity instead of what was left in the ring.
+        // bones past maxJoints can't be drawn here, only the skinning pass has room for them
+        jointOffsets[j] = m_uniformRing.find(jointKey, model.boneDataVersion);
+        if (!jointOffsets[j]) {
+            JointMatrixArray joints = m_identityJoints;
+            std::copy_n(model.boneData.cbegin(), std::min(model.boneData.size(), maxJoints), joints.g_JointMatrixArray);
+            jointOffsets[j] = m_uniformRing.push(jointKey, model.boneDataVersion, &joints, sizeof(JointMatrixArray));
+        }
+    }
 
-                        const uint32_t vertexShaderIndice = currentPass.vertex_shader;
-                        const uint32_t pixelShaderIndice = currentPass.pixel_shader;
+    m_frame.models = &models;
+    m_frame.offsets = frameOffsets;
+    m_frame.jointOffsets = std::move(jointOffsets);
 
-                        physis_Shader vertexShader = renderMaterial.shaderPackage.vertex_shaders[vertexShaderIndice];
-                        physis_Shader pixelShader = renderMaterial.shaderPackage.pixel_shaders[pixelShaderIndice];
+    // everything before this is counted as part of the "Renderer" section
+    Profiler::CpuScope recordScope(profiler, "Record passes");
+    m_renderGraph.execute(commandBuffer);
+}
 
-                        auto &pipeline = bindPipeline(commandBuffer, pass, vertexShader, pixelShader);
-                        bindDescriptorSets(commandBuffer, pipeline, &model, &renderMaterial);
+void GameRenderer::drawModels(VkCommandBuffer commandBuffer, const std::string_view passName, const int passIndex)
+{
+    const auto &models = *m_frame.models;
 
-                        VkDeviceSize offsets[] = {0};
-                        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &part.vertexBuffer.buffer, offsets);
-                        vkCmdBindIndexBuffer(commandBuffer, part.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    for (size_t j = 0; j < models.size(); j++) {
+        const auto &model = models[j];
+        if (!m_frame.jointOffsets[j]) {
+            continue;
+        }
 
-                        vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, 0, 0, 0);
-                    }
-                }
-            }
+        DynamicOffsets modelOffsets = m_frame.offsets;
+        modelOffsets[JointMatrixUniform] = *m_frame.jointOffsets[j];
 
-            endPass(commandBuffer, pass);
-        } else if (pass == "PASS_LIGHTING_OPAQUE") {
-            // first we need to generate the view positions with createviewpositions
-            beginPass(imageIndex, commandBuffer, "PASS_LIGHTING_OPAQUE_VIEWPOSITION");
-            {
-                std::vector<uint32_t> systemKeys = {
-                    physis_shpk_crc("DecodeDepthBuffer_RAWZ"),
-                };
-                std::vector<uint32_t> subviewKeys = {
-                    physis_shpk_crc("Default"),
-                    physis_shpk_crc("SUB_VIEW_MAIN"),
-                };
+        // models already skinned in a compute shader are drawn from their skinned vertices, with the identity joints from render()
+        // those only hold the vertices of the drawn LOD, so the parts' vertex offsets are moved back by where it starts
+        const SkinningPass::SkinnedVertices skinnedVertices = m_skinning.skinnedVertices(model);
+        const VkBuffer vertexBuffer = skinnedVertices.buffer != VK_NULL_HANDLE ? skinnedVertices.buffer : model.vertexBuffer.buffer;
 
-                const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
-                                                                                   systemKeys.size(),
-                                                                                   nullptr,
-                                                                                   0,
-                                                                                   nullptr,
-                                                                                   0,
-                                                                                   subviewKeys.data(),
-                                                                                   subviewKeys.size());
-                const physis_SHPKNode node = physis_shpk_get_node(&createViewPositionShpk, selector);
-
-                // check if invalid
-                if (node.pass_count == 0) {
-                    continue;
-                }
+        // every part shares the same buffers, and so do placements of the same model
+        if (vertexBuffer != boundVertexBuffer) {
+            boundVertexBuffer = vertexBuffer;
 
-                const int passIndice = node.pass_indices[i];
-                if (passIndice != INVALID_PASS) {
-                    const Pass currentPass = node.passes[passIndice];
+            VkDeviceSize offsets[] = {0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+        }
 
-                    const uint32_t vertexShaderIndice = currentPass.vertex_shader;
-                    const uint32_t pixelShaderIndice = currentPass.pixel_shader;
+        const RenderLod &lod = *m_frame.lods[j];
+        for (size_t k = 0; k < lod.parts.size(); k++) {
+            if (!m_frame.partVisible[m_frame.firstPart[j] + k]) {
+                continue;
+            }
 
-                    physis_Shader vertexShader = createViewPositionShpk.vertex_shaders[vertexShaderIndice];
-                    physis_Shader pixelShader = createViewPositionShpk.pixel_shaders[pixelShaderIndice];
+            const auto &part = lod.parts[k];
+            auto &renderMaterial = model.materials[part.materialIndex];
 
-                    auto &pipeline = bindPipeline(commandBuffer, "PASS_LIGHTING_OPAQUE_VIEWPOSITION", vertexShader, pixelShader);
-                    bindDescriptorSets(commandBuffer, pipeline, nullptr, nullptr);
+            if (renderMaterial.shaderPackage.p_ptr == nullptr) {
+                qWarning() << "Invalid shader package!";
+            }
 
-                    VkDeviceSize offsets[] = {0};
-                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_planeVertexBuffer.buffer, offsets);
+            // resolved when the material was created, but look it up again if it changed since then
+            const bool nodeIsCurrent = renderMaterial.shaderNodePackage == renderMaterial.shaderPackage.p_ptr
+                && renderMaterial.shaderNodeType == renderMaterial.type;
+            const physis_SHPKNode node = nodeIsCurrent ? renderMaterial.shaderNode : shaderNodeFor(renderMaterial);
 
-                    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-                }
+            // check if invalid
+            if (node.pass_count == 0) {
+                continue;
             }
-            endPass(commandBuffer, pass);
 
-            beginPass(imageIndex, commandBuffer, pass);
-            // then run the directionallighting shader
-            {
-                std::vector<uint32_t> systemKeys = {
-                    physis_shpk_crc("DecodeDepthBuffer_RAWZ"),
-                };
-                std::vector<uint32_t> sceneKeys = {
-                    physis_shpk_crc("GetDirectionalLight_Enable"),
-                    physis_shpk_crc("GetFakeSpecular_Disable"),
-                    physis_shpk_crc("GetUnderWaterLighting_Disable"),
-                };
-                std::vector<uint32_t> subviewKeys = {
-                    physis_shpk_crc("Default"),
-                    physis_shpk_crc("SUB_VIEW_MAIN"),
-                };
+            // this is an index into the node's pass array, not to get confused with the global one we always follow.
+            const int passIndice = node.pass_indices[passIndex];
+            if (passIndice != INVALID_PASS) {
+                const Pass currentPass = node.passes[passIndice];
 
-                const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
-                                                                                   systemKeys.size(),
-                                                                                   sceneKeys.data(),
-                                                                                   sceneKeys.size(),
-                                                                                   nullptr,
-                                                                                   0,
-                                                                                   subviewKeys.data(),
-                                                                                   subviewKeys.size());
-                const physis_SHPKNode node = physis_shpk_get_node(&directionalLightningShpk, selector);
-
-                // check if invalid
-                if (node.pass_count == 0) {
+                auto pipeline = bindPipeline(commandBuffer, passName, renderMaterial.shaderPackage, currentPass);
+                if (pipeline == nullptr || !bindDescriptorSets(commandBuffer, *pipeline, modelOffsets, &renderMaterial)) {
                     continue;
                 }
 
-                const int passIndice = node.pass_indices[i];
-                if (passIndice != INVALID_PASS) {
-                    const Pass currentPass = node.passes[passIndice];
-
-                    const uint32_t vertexShaderIndice = currentPass.vertex_shader;
-                    const uint32_t pixelShaderIndice = currentPass.pixel_shader;
-
-                    physis_Shader vertexShader = directionalLightningShpk.vertex_shaders[vertexShaderIndice];
-                    physis_Shader pixelShader = directionalLightningShpk.pixel_shaders[pixelShaderIndice];
-
-                    auto &pipeline = bindPipeline(commandBuffer, pass, vertexShader, pixelShader);
-                    bindDescriptorSets(commandBuffer, pipeline, nullptr, nullptr);
-
-                    VkDeviceSize offsets[] = {0};
-                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_planeVertexBuffer.buffer, offsets);
-
-                    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-                }
+                vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, part.firstIndex, part.vertexOffset - skinnedVertices.firstVertex, 0);
+                m_device.profiler->count(Profiler::DrawCalls);
+                m_device.profiler->count(Profiler::Triangles, part.numIndices / 3);
             }
-            endPass(commandBuffer, pass);
         }
-
-        i++;
     }
 }
 
-void GameRenderer::resize()
+void GameRenderer::drawFullscreen(VkCommandBuffer commandBuffer,
+                                  const std::string_view passName,
+                                  const int passIndex,
+                                  const physis_SHPK &shaderPackage,
+                                  const physis_SHPKNode &node)
 {
-    // TODO: this is because of our terrible resource handling. an image referenced in these may be gone due to resizing, for example
-    for (auto &[hash, cachedPipeline] : m_cachedPipelines) {
-        cachedPipeline.cachedDescriptors.clear();
+    const int passIndice = node.pass_count > 0 ? node.pass_indices[passIndex] : INVALID_PASS;
+    if (passIndice == INVALID_PASS) {
+        return;
     }
 
-    createImageResources();
-}
+    const Pass currentPass = node.passes[passIndice];
 
-void GameRenderer::beginPass(uint32_t imageIndex, VkCommandBuffer commandBuffer, const std::string_view passName)
-{
-    VkRenderingInfo renderingInfo{VK_STRUCTURE_TYPE_RENDERING_INFO};
-    renderingInfo.renderArea.extent = m_device.swapChain->extent;
-
-    std::vector<VkRenderingAttachmentInfo> colorAttachments;
-    VkRenderingAttachmentInfo depthStencilAttachment{};
-
-    if (passName == "PASS_G_OPAQUE") {
-        // normals, it seems like
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = m_normalGBuffer.imageView;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-            attachmentInfo.clearValue.color.float32[0] = 0.24;
-            attachmentInfo.clearValue.color.float32[1] = 0.24;
-            attachmentInfo.clearValue.color.float32[2] = 0.24;
-            attachmentInfo.clearValue.color.float32[3] = 1.0;
-
-            colorAttachments.push_back(attachmentInfo);
-        }
+    auto pipeline = bindPipeline(commandBuffer, passName, shaderPackage, currentPass);
+    if (pipeline != nullptr && bindDescriptorSets(commandBuffer, *pipeline, m_frame.offsets, nullptr)) {
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_planeVertexBuffer.buffer, offsets);
 
-        // unknown, seems to be background?
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = VK_NULL_HANDLE;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+        m_device.profiler->count(Profiler::DrawCalls);
+        m_device.profiler->count(Profiler::Triangles, 2);
+    }
+}
 
-            colorAttachments.push_back(attachmentInfo);
-        }
 
-        // unknown, seems to be background?
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = VK_NULL_HANDLE;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+void GameRenderer::prepareMaterial(RenderMaterial &material)
+{
+    material.shaderNode = shaderNodeFor(material);
+    material.shaderNodePackage = material.shaderPackage.p_ptr;
+    material.shaderNodeType = material.type;
+}
 
-            colorAttachments.push_back(attachmentInfo);
-        }
+physis_SHPKNode GameRenderer::shaderNodeFor(const RenderMaterial &material)
+{
+    if (material.shaderPackage.p_ptr == nullptr) {
+        return {};
+    }
 
-        // depth
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = m_depthBuffer.imageView;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-            attachmentInfo.clearValue.depthStencil.depth = 1.0f;
+    std::vector<uint32_t> systemKeys;
+    if (material.type == MaterialType::Skin) {
+        systemKeys.push_back(physis_shpk_crc("DecodeDepthBuffer_RAWZ"));
+    }
+    std::vector<uint32_t> sceneKeys = {
+        physis_shpk_crc("TransformViewSkin"),
+        physis_shpk_crc("GetAmbientLight_SH"),
+        physis_shpk_crc("GetReflectColor_Texture"),
+        physis_shpk_crc("GetAmbientOcclusion_None"),
+        physis_shpk_crc("ApplyDitherClipOff"),
+    };
+    std::vector<uint32_t> materialKeys;
+    for (int k = 0; k < material.shaderPackage.num_material_keys; k++) {
+        materialKeys.push_back(material.shaderPackage.material_keys[k].default_value);
+    }
+    std::vector<uint32_t> subviewKeys = {physis_shpk_crc("Default"), physis_shpk_crc("SUB_VIEW_MAIN")};
+
+    const uint32_t selector = physis_shpk_build_selector_from_all_keys(systemKeys.data(),
+                                                                       systemKeys.size(),
+                                                                       sceneKeys.data(),
+                                                                       sceneKeys.size(),
+                                                                       materialKeys.data(),
+                                                                       materialKeys.size(),
+                                                                       subviewKeys.data(),
+                                                                       subviewKeys.size());
+    return physis_shpk_get_node(&material.shaderPackage, selector);
+}
 
-            depthStencilAttachment = attachmentInfo;
-        }
-    } else if (passName == "PASS_LIGHTING_OPAQUE") {
-        // normals, it seems like
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = m_compositeBuffer.imageView;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-            attachmentInfo.clearValue.color.float32[0] = 0.24;
-            attachmentInfo.clearValue.color.float32[1] = 0.24;
-            attachmentInfo.clearValue.color.float32[2] = 0.24;
-            attachmentInfo.clearValue.color.float32[3] = 1.0;
-
-            colorAttachments.push_back(attachmentInfo);
-        }
+void GameRenderer::resize()
+{
+    // the render graph's images are created again, and the descriptor sets sampling them would point at the old ones
+    freeDescriptors();
 
-        // unknown
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = VK_NULL_HANDLE;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    createImageResources();
+}
 
-            colorAttachments.push_back(attachmentInfo);
-        }
-    } else if (passName == "PASS_LIGHTING_OPAQUE_VIEWPOSITION") {
-        // TODO: Hack we should not be using a special pass for this, we should just design our API better
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = m_viewPositionBuffer.imageView;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-            attachmentInfo.clearValue.color.float32[0] = 0.24;
-            attachmentInfo.clearValue.color.float32[1] = 0.24;
-            attachmentInfo.clearValue.color.float32[2] = 0.24;
-            attachmentInfo.clearValue.color.float32[3] = 1.0;
-
-            colorAttachments.push_back(attachmentInfo);
-        }
-    } else if (passName == "PASS_Z_OPAQUE") {
-        // normals, it seems like
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = m_compositeBuffer.imageView;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-            attachmentInfo.clearValue.color.float32[0] = 0.24;
-            attachmentInfo.clearValue.color.float32[1] = 0.24;
-            attachmentInfo.clearValue.color.float32[2] = 0.24;
-            attachmentInfo.clearValue.color.float32[3] = 1.0;
-
-            colorAttachments.push_back(attachmentInfo);
+void GameRenderer::freeDescriptors()
+{
+    for (auto &[key, cachedPipeline] : m_cachedPipelines) {
+        for (const auto &[descriptorKey, descriptor] : cachedPipeline.cachedDescriptors) {
+            vkFreeDescriptorSets(m_device.device, m_device.descriptorPool, 1, &descriptor.set);
         }
+        cachedPipeline.cachedDescriptors.clear();
+    }
+}
 
-        // unknown
-        {
-            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
-            attachmentInfo.imageView = VK_NULL_HANDLE;
-            attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-            attachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+GameRenderer::CachedPipeline *
+GameRenderer::bindPipeline(VkCommandBuffer commandBuffer, std::string_view passName, const physis_SHPK &shaderPackage, const Pass &pass)
+{
+    const PipelineKey key = pipelineKey(passName, shaderPackage, pass);
+
+    auto it = m_cachedPipelines.find(key);
+    if (it != m_cachedPipelines.end()) {
+        m_device.profiler->count(Profiler::PipelineHits);
+    } else {
+        m_device.profiler->count(Profiler::PipelineMisses);
+
+        if (m_synchronousPipelines) {
+            const ShaderSource vertexShader = copyShader(shaderPackage.vertex_shaders[pass.vertex_shader]);
+            const ShaderSource pixelShader = copyShader(shaderPackage.pixel_shaders[pass.pixel_shader]);
+            it = m_cachedPipelines.emplace(key, createPipeline(key, vertexShader, pixelShader)).first;
+        } else {
+            // translating and compiling takes long enough to cause a visible hitch, so it's done in the background
+            // until then, anything using this pipeline is skipped
+            if (!m_pendingPipelines.contains(key)) {
+                m_pendingPipelines.insert(key);
+
+                // the shader package can be freed before the job runs, so it gets its own copy of the shaders
+                m_pipelinePool.start([this,
+                                      key,
+                                      vertexShader = copyShader(shaderPackage.vertex_shaders[pass.vertex_shader]),
+                                      pixelShader = copyShader(shaderPackage.pixel_shaders[pass.pixel_shader])] {
+                    CachedPipeline pipeline = createPipeline(key, vertexShader, pixelShader);
+
+                    QMutexLocker locker(&m_finishedPipelinesMutex);
+                    m_finishedPipelines.emplace_back(key, pipeline);
+                });
+            }
 
-            colorAttachments.push_back(attachmentInfo);
+            return nullptr;
         }
     }
 
-    renderingInfo.layerCount = 1;
-    renderingInfo.pColorAttachments = colorAttachments.data();
-    renderingInfo.colorAttachmentCount = colorAttachments.size();
+    auto &pipeline = it->second;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+    m_device.profiler->count(Profiler::PipelineBinds);
 
-    if (depthStencilAttachment.imageView != VK_NULL_HANDLE) {
-        renderingInfo.pDepthAttachment = &depthStencilAttachment;
-    }
+    VkViewport viewport = {};
+    viewport.width = m_device.swapChain->extent.width;
+    viewport.height = m_device.swapChain->extent.height;
+    viewport.maxDepth = 1.0f;
 
-    vkCmdBeginRendering(commandBuffer, &renderingInfo);
-}
+    VkRect2D scissor = {};
+    scissor.extent = m_device.swapChain->extent;
 
-void GameRenderer::endPass(VkCommandBuffer commandBuffer, std::string_view passName)
-{
-    vkCmdEndRendering(commandBuffer);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    return &pipeline;
 }
 
-GameRenderer::CachedPipeline &
-GameRenderer::bindPipeline(VkCommandBuffer commandBuffer, std::string_view passName, physis_Shader &vertexShader, physis_Shader &pixelShader)
+GameRenderer::CachedPipeline GameRenderer::createPipeline(const PipelineKey &key, const ShaderSource &vertexShader, const ShaderSource &pixelShader)
 {
-    const uint32_t hash = vertexShader.len + pixelShader.len + physis_shpk_crc(passName.data());
-    if (!m_cachedPipelines.contains(hash)) {
-        auto vertexShaderModule = convertShaderModule(vertexShader, spv::ExecutionModelVertex);
-        auto fragmentShaderModule = convertShaderModule(pixelShader, spv::ExecutionModelFragment);
+    auto vertexShaderModule = convertShaderModule(vertexShader, spv::ExecutionModelVertex);
+    auto fragmentShaderModule = convertShaderModule(pixelShader, spv::ExecutionModelFragment);
 
-        VkPipelineShaderStageCreateInfo vertexShaderStageInfo = {};
-        vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertexShaderStageInfo.module = vertexShaderModule;
-        vertexShaderStageInfo.pName = "main";
+    VkPipelineShaderStageCreateInfo vertexShaderStageInfo = {};
+    vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertexShaderStageInfo.module = vertexShaderModule;
+    vertexShaderStageInfo.pName = "main";
 
-        VkPipelineShaderStageCreateInfo fragmentShaderStageInfo = {};
-        fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragmentShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragmentShaderStageInfo.module = fragmentShaderModule; // m_renderer.loadShaderFromDisk(":/shaders/dummy.frag.spv");
-        fragmentShaderStageInfo.pName = "main";
+    VkPipelineShaderStageCreateInfo fragmentShaderStageInfo = {};
+    fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragmentShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragmentShaderStageInfo.module = fragmentShaderModule; // m_renderer.loadShaderFromDisk(":/shaders/dummy.frag.spv");
+    fragmentShaderStageInfo.pName = "main";
 
-        std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {vertexShaderStageInfo, fragmentShaderStageInfo};
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {vertexShaderStageInfo, fragmentShaderStageInfo};
 
-        VkVertexInputBindingDescription binding = {};
+    VkVertexInputBindingDescription binding = {};
+    binding.stride = key.vertexStride;
 
-        // TODO: temporary
-        if (passName == "PASS_G_OPAQUE" || passName == "PASS_Z_OPAQUE") {
-            binding.stride = sizeof(Vertex);
-        } else if (passName == "PASS_LIGHTING_OPAQUE" || passName == "PASS_LIGHTING_OPAQUE_VIEWPOSITION") {
-            binding.stride = sizeof(glm::vec4);
-        }
-
-        auto vertex_glsl = getShaderModuleResources(vertexShader);
-        auto vertex_resources = vertex_glsl.get_shader_resources();
+    auto vertex_glsl = getShaderModuleResources(vertexShader);
+    auto vertex_resources = vertex_glsl.get_shader_resources();
 
-        auto fragment_glsl = getShaderModuleResources(pixelShader);
-        auto fragment_resources = fragment_glsl.get_shader_resources();
+    auto fragment_glsl = getShaderModuleResources(pixelShader);
+    auto fragment_resources = fragment_glsl.get_shader_resources();
 
-        std::vector<RequestedSet> requestedSets;
+    std::vector<RequestedSet> requestedSets;
 
-        const auto &collectResources = [&requestedSets](const spirv_cross::CompilerGLSL &glsl,
-                                                        const spirv_cross::SmallVector<spirv_cross::Resource> &resources,
-                                                        const VkShaderStageFlagBits stageFlagBit) {
-            for (auto resource : resources) {
-                unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
-                unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
+    const auto &collectResources = [&requestedSets](const spirv_cross::CompilerGLSL &glsl,
+                                                    const spirv_cross::SmallVector<spirv_cross::Resource> &resources,
+                                                    const VkShaderStageFlagBits stageFlagBit) {
+        for (auto resource : resources) {
+            unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
+            unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
 
-                if (requestedSets.size() <= set) {
-                    requestedSets.resize(set + 1);
-                }
+            if (requestedSets.size() <= set) {
+                requestedSets.resize(set + 1);
+            }
 
-                auto &requestSet = requestedSets[set];
-                requestSet.used = true;
+            auto &requestSet = requestedSets[set];
+            requestSet.used = true;
 
-                if (requestSet.bindings.size() <= binding) {
-                    requestSet.bindings.resize(binding + 1);
-                }
+            if (requestSet.bindings.size() <= binding) {
+                requestSet.bindings.resize(binding + 1);
+            }
 
-                auto type = glsl.get_type(resource.type_id);
+            auto type = glsl.get_type(resource.type_id);
 
-                if (type.basetype == spirv_cross::SPIRType::Image) {
-                    requestSet.bindings[binding].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-                } else if (type.basetype == spirv_cross::SPIRType::Struct) {
-                    requestSet.bindings[binding].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                } else if (type.basetype == spirv_cross::SPIRType::Sampler) {
-                    requestSet.bindings[binding].type = VK_DESCRIPTOR_TYPE_SAMPLER;
-                }
+            if (type.basetype == spirv_cross::SPIRType::Image) {
+                requestSet.bindings[binding].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            } else if (type.basetype == spirv_cross::SPIRType::Struct) {
+                requestSet.bindings[binding].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            } else if (type.basetype == spirv_cross::SPIRType::Sampler) {
+                requestSet.bindings[binding].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+            }
 
-                requestSet.bindings[binding].used = true;
-                requestSet.bindings[binding].stageFlags |= stageFlagBit;
+            requestSet.bindings[binding].used = true;
+            requestSet.bindings[binding].stageFlags |= stageFlagBit;
 
-                qInfo() << "Requesting set" << set << "at" << binding;
+            qInfo() << "Requesting set" << set << "at" << binding;
+        }
+    };
+
+    collectResources(vertex_glsl, vertex_resources.uniform_buffers, VK_SHADER_STAGE_VERTEX_BIT);
+    collectResources(vertex_glsl, vertex_resources.separate_images, VK_SHADER_STAGE_VERTEX_BIT);
+    collectResources(vertex_glsl, vertex_resources.separate_samplers, VK_SHADER_STAGE_VERTEX_BIT);
+
+    collectResources(fragment_glsl, fragment_resources.uniform_buffers, VK_SHADER_STAGE_FRAGMENT_BIT);
+    collectResources(fragment_glsl, fragment_resources.separate_images, VK_SHADER_STAGE_FRAGMENT_BIT);
+    collectResources(fragment_glsl, fragment_resources.separate_samplers, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    resolveBindings(requestedSets, vertexShader, pixelShader);
+
+    for (auto &set : requestedSets) {
+        if (set.used) {
+            int j = 0;
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            for (auto &binding : set.bindings) {
+                if (binding.used) {
+                    VkDescriptorSetLayoutBinding boneInfoBufferBinding = {};
+                    boneInfoBufferBinding.descriptorType = binding.type;
+                    boneInfoBufferBinding.descriptorCount = 1;
+                    boneInfoBufferBinding.stageFlags = binding.stageFlags;
+                    boneInfoBufferBinding.binding = j;
+
+                    bindings.push_back(boneInfoBufferBinding);
+                }
+                j++;
             }
-        };
 
-        collectResources(vertex_glsl, vertex_resources.uniform_buffers, VK_SHADER_STAGE_VERTEX_BIT);
-        collectResources(vertex_glsl, vertex_resources.separate_images, VK_SHADER_STAGE_VERTEX_BIT);
-        collectResources(vertex_glsl, vertex_resources.separate_samplers, VK_SHADER_STAGE_VERTEX_BIT);
-
-        collectResources(fragment_glsl, fragment_resources.uniform_buffers, VK_SHADER_STAGE_FRAGMENT_BIT);
-        collectResources(fragment_glsl, fragment_resources.separate_images, VK_SHADER_STAGE_FRAGMENT_BIT);
-        collectResources(fragment_glsl, fragment_resources.separate_samplers, VK_SHADER_STAGE_FRAGMENT_BIT);
-
-        for (auto &set : requestedSets) {
-            if (set.used) {
-                int j = 0;
-                std::vector<VkDescriptorSetLayoutBinding> bindings;
-                for (auto &binding : set.bindings) {
-                    if (binding.used) {
-                        VkDescriptorSetLayoutBinding boneInfoBufferBinding = {};
-                        boneInfoBufferBinding.descriptorType = binding.type;
-                        boneInfoBufferBinding.descriptorCount = 1;
-                        boneInfoBufferBinding.stageFlags = binding.stageFlags;
-                        boneInfoBufferBinding.binding = j;
-
-                        bindings.push_back(boneInfoBufferBinding);
-                    }
-                    j++;
-                }
+            VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = bindings.size();
+            layoutInfo.pBindings = bindings.data();
 
-                VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-                layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-                layoutInfo.bindingCount = bindings.size();
-                layoutInfo.pBindings = bindings.data();
+            vkCreateDescriptorSetLayout(m_device.device, &layoutInfo, nullptr, &set.layout);
+        }
+    }
 
-                vkCreateDescriptorSetLayout(m_device.device, &layoutInfo, nullptr, &set.layout);
+    std::vector<VkVertexInputAttributeDescription> attributeDescs;
+
+    for (auto texture : vertex_resources.stage_inputs) {
+        unsigned binding = vertex_glsl.get_decoration(texture.id, spv::DecorationLocation);
+
+        auto name = vertex_glsl.get_name(texture.id);
+
+        VkVertexInputAttributeDescription uv0Attribute = {};
+
+        auto type = vertex_glsl.get_type(texture.type_id);
+        if (type.basetype == spirv_cross::SPIRType::Int) {
+            switch (type.vecsize) {
+            case 1:
+                uv0Attribute.format = VK_FORMAT_R32_SINT;
+                break;
+            case 2:
+                uv0Attribute.format = VK_FORMAT_R32G32_SINT;
+                break;
+            case 3:
+                uv0Attribute.format = VK_FORMAT_R32G32B32_SINT;
+                break;
+            case 4:
+                uv0Attribute.format = VK_FORMAT_R8G8B8A8_UINT; // supposed to be VK_FORMAT_R32G32B32A32_SINT, but our bone_id is uint8_t currently
+                break;
+            }
+        } else {
+            switch (type.vecsize) {
+            case 1:
+                uv0Attribute.format = VK_FORMAT_R32_SFLOAT;
+                break;
+            case 2:
+                uv0Attribute.format = VK_FORMAT_R32G32_SFLOAT;
+                break;
+            case 3:
+                uv0Attribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+                break;
+            case 4:
+                uv0Attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+                break;
             }
         }
 
-        std::vector<VkVertexInputAttributeDescription> attributeDescs;
+        uv0Attribute.location = binding;
 
-        for (auto texture : vertex_resources.stage_inputs) {
-            unsigned binding = vertex_glsl.get_decoration(texture.id, spv::DecorationLocation);
+        // TODO: temporary
+        if (name == "v0") {
+            uv0Attribute.offset = offsetof(Vertex, position);
+        } else if (name == "v1") {
+            uv0Attribute.offset = offsetof(Vertex, color);
+        } else if (name == "v2") {
+            uv0Attribute.offset = offsetof(Vertex, normal);
+        } else if (name == "v3") {
+            uv0Attribute.offset = offsetof(Vertex, uv0);
+        } else if (name == "v4") {
+            uv0Attribute.offset = offsetof(Vertex, bitangent); // FIXME: should be tangent
+        } else if (name == "v5") {
+            uv0Attribute.offset = offsetof(Vertex, bitangent);
+        } else if (name == "v6") {
+            uv0Attribute.offset = offsetof(Vertex, bone_weight);
+        } else if (name == "v7") {
+            uv0Attribute.offset = offsetof(Vertex, bone_id);
+        }
 
-            auto name = vertex_glsl.get_name(texture.id);
+        attributeDescs.push_back(uv0Attribute);
+    }
 
-            VkVertexInputAttributeDescription uv0Attribute = {};
+    VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputState.vertexBindingDescriptionCount = 1;
+    vertexInputState.pVertexBindingDescriptions = &binding;
+    vertexInputState.vertexAttributeDescriptionCount = attributeDescs.size();
+    vertexInputState.pVertexAttributeDescriptions = attributeDescs.data();
 
-            auto type = vertex_glsl.get_type(texture.type_id);
-            if (type.basetype == spirv_cross::SPIRType::Int) {
-                switch (type.vecsize) {
-                case 1:
-                    uv0Attribute.format = VK_FORMAT_R32_SINT;
-                    break;
-                case 2:
-                    uv0Attribute.format = VK_FORMAT_R32G32_SINT;
-                    break;
-                case 3:
-                    uv0Attribute.format = VK_FORMAT_R32G32B32_SINT;
-                    break;
-                case 4:
-                    uv0Attribute.format = VK_FORMAT_R8G8B8A8_UINT; // supposed to be VK_FORMAT_R32G32B32A32_SINT, but our bone_id is uint8_t currently
-                    break;
-                }
-            } else {
-                switch (type.vecsize) {
-                case 1:
-                    uv0Attribute.format = VK_FORMAT_R32_SFLOAT;
-                    break;
-                case 2:
-                    uv0Attribute.format = VK_FORMAT_R32G32_SFLOAT;
-                    break;
-                case 3:
-                    uv0Attribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-                    break;
-                case 4:
-                    uv0Attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-                    break;
-                }
-            }
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-            uv0Attribute.location = binding;
-
-            // TODO: temporary
-            if (name == "v0") {
-                uv0Attribute.offset = offsetof(Vertex, position);
-            } else if (name == "v1") {
-                uv0Attribute.offset = offsetof(Vertex, color);
-            } else if (name == "v2") {
-                uv0Attribute.offset = offsetof(Vertex, normal);
-            } else if (name == "v3") {
-                uv0Attribute.offset = offsetof(Vertex, uv0);
-            } else if (name == "v4") {
-                uv0Attribute.offset = offsetof(Vertex, bitangent); // FIXME: should be tangent
-            } else if (name == "v5") {
-                uv0Attribute.offset = offsetof(Vertex, bitangent);
-            } else if (name == "v6") {
-                uv0Attribute.offset = offsetof(Vertex, bone_weight);
-            } else if (name == "v7") {
-                uv0Attribute.offset = offsetof(Vertex, bone_id);
-            }
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
 
-            attributeDescs.push_back(uv0Attribute);
-        }
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = key.cullMode;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
 
-        VkPipelineVertexInputStateCreateInfo vertexInputState = {};
-        vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputState.vertexBindingDescriptionCount = 1;
-        vertexInputState.pVertexBindingDescriptions = &binding;
-        vertexInputState.vertexAttributeDescriptionCount = attributeDescs.size();
-        vertexInputState.pVertexAttributeDescriptions = attributeDescs.data();
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-        VkPipelineViewportStateCreateInfo viewportState = {};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.scissorCount = 1;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer = {};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_NONE; // TODO: implement cull mode
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-
-        VkPipelineMultisampleStateCreateInfo multisampling = {};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
-
-        int colorAttachmentCount = 1;
-        // TODO: hardcoded, should be a reusable function to get the color attachments
-        if (passName == "PASS_G_OPAQUE") {
-            colorAttachmentCount = 3;
-        } else if (passName == "PASS_LIGHTING_OPAQUE") {
-            colorAttachmentCount = 2;
-        }
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-        for (int i = 0; i < colorAttachmentCount; i++) {
-            colorBlendAttachments.push_back(colorBlendAttachment);
-        }
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
-        VkPipelineColorBlendStateCreateInfo colorBlending = {};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.attachmentCount = colorBlendAttachments.size();
-        colorBlending.pAttachments = colorBlendAttachments.data();
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
 
-        std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    for (uint32_t i = 0; i < key.colorAttachmentCount; i++) {
+        colorBlendAttachments.push_back(colorBlendAttachment);
+    }
 
-        VkPipelineDynamicStateCreateInfo dynamicState = {};
-        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicState.dynamicStateCount = dynamicStates.size();
-        dynamicState.pDynamicStates = dynamicStates.data();
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = colorBlendAttachments.size();
+    colorBlending.pAttachments = colorBlendAttachments.data();
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        // pipelineLayoutInfo.pushConstantRangeCount = 1;
-        // pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
 
-        std::vector<VkDescriptorSetLayout> setLayouts;
-        for (auto &set : requestedSets) {
-            if (set.used) {
-                setLayouts.push_back(set.layout);
-            }
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = dynamicStates.size();
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    // pipelineLayoutInfo.pushConstantRangeCount = 1;
+    // pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    for (auto &set : requestedSets) {
+        if (set.used) {
+            setLayouts.push_back(set.layout);
         }
+    }
+
+    pipelineLayoutInfo.setLayoutCount = setLayouts.size();
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    vkCreatePipelineLayout(m_device.device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo = {};
+    pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    pipelineRenderingCreateInfo.colorAttachmentCount = key.colorAttachmentCount;
+    pipelineRenderingCreateInfo.pColorAttachmentFormats = key.colorAttachmentFormats.data();
+    pipelineRenderingCreateInfo.depthAttachmentFormat = key.depthAttachmentFormat;
+
+    VkGraphicsPipelineCreateInfo createInfo = {};
+    createInfo.pNext = &pipelineRenderingCreateInfo;
+    createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    createInfo.stageCount = shaderStages.size();
+    createInfo.pStages = shaderStages.data();
+    createInfo.pVertexInputState = &vertexInputState;
+    createInfo.pInputAssemblyState = &inputAssembly;
+    createInfo.pViewportState = &viewportState;
+    createInfo.pRasterizationState = &rasterizer;
+    createInfo.pMultisampleState = &multisampling;
+    createInfo.pColorBlendState = &colorBlending;
+    createInfo.pDynamicState = &dynamicState;
+    createInfo.pDepthStencilState = &depthStencil;
+    createInfo.layout = pipelineLayout;
+    // createInfo.renderPass = m_renderer.renderPass;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache->handle(), 1, &createInfo, nullptr, &pipeline);
+
+    // the pipeline keeps its own copy of the code
+    vkDestroyShaderModule(m_device.device, vertexShaderModule, nullptr);
+    vkDestroyShaderModule(m_device.device, fragmentShaderModule, nullptr);
+
+    qInfo() << "Created" << pipeline << "for hash" << PipelineKeyHash{}(key);
+
+    return CachedPipeline{.pipeline = pipeline,
+                          .pipelineLayout = pipelineLayout,
+                          .setLayouts = setLayouts,
+                          .requestedSets = requestedSets};
+}
+
+void GameRenderer::collectFinishedPipelines()
+{
+    QMutexLocker locker(&m_finishedPipelinesMutex);
 
-        pipelineLayoutInfo.setLayoutCount = setLayouts.size();
-        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
-
-        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
-        vkCreatePipelineLayout(m_device.device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
-
-        VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        depthStencil.depthTestEnable = VK_TRUE;
-        depthStencil.depthWriteEnable = VK_TRUE;
-        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-        depthStencil.maxDepthBounds = 1.0f;
-
-        std::array<VkFormat, 3> colorAttachmentFormats = {VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_UNDEFINED, VK_FORMAT_UNDEFINED};
-
-        VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo = {};
-        pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
-        pipelineRenderingCreateInfo.colorAttachmentCount = 3; // TODO: hardcoded
-        pipelineRenderingCreateInfo.pColorAttachmentFormats = colorAttachmentFormats.data();
-        pipelineRenderingCreateInfo.depthAttachmentFormat = VK_FORMAT_D32_SFLOAT; // TODO: hardcoded
-
-        VkGraphicsPipelineCreateInfo createInfo = {};
-        createInfo.pNext = &pipelineRenderingCreateInfo;
-        createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        createInfo.stageCount = shaderStages.size();
-        createInfo.pStages = shaderStages.data();
-        createInfo.pVertexInputState = &vertexInputState;
-        createInfo.pInputAssemblyState = &inputAssembly;
-        createInfo.pViewportState = &viewportState;
-        createInfo.pRasterizationState = &rasterizer;
-        createInfo.pMultisampleState = &multisampling;
-        createInfo.pColorBlendState = &colorBlending;
-        createInfo.pDynamicState = &dynamicState;
-        createInfo.pDepthStencilState = &depthStencil;
-        createInfo.layout = pipelineLayout;
-        // createInfo.renderPass = m_renderer.renderPass;
-
-        VkPipeline pipeline = VK_NULL_HANDLE;
-        vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline);
-
-        qInfo() << "Created" << pipeline << "for hash" << hash;
-        m_cachedPipelines[hash] = CachedPipeline{.pipeline = pipeline,
-                                                 .pipelineLayout = pipelineLayout,
-                                                 .setLayouts = setLayouts,
-                                                 .requestedSets = requestedSets,
-                                                 .vertexShader = vertexShader,
-                                                 .pixelShader = pixelShader};
+    for (auto &[key, pipeline] : m_finishedPipelines) {
+        m_pendingPipelines.erase(key);
+        m_cachedPipelines.emplace(key, std::move(pipeline));
     }
+    m_finishedPipelines.clear();
+}
 
-    auto &pipeline = m_cachedPipelines[hash];
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+GameRenderer::PipelineKey GameRenderer::pipelineKey(std::string_view passName, const physis_SHPK &shaderPackage, const Pass &pass)
+{
+    PipelineKey key;
+    key.vertexShaderHash = shaderHash(shaderPackage, false, pass.vertex_shader);
+    key.pixelShaderHash = shaderHash(shaderPackage, true, pass.pixel_shader);
+    key.pass = physis_shpk_crc(passName.data());
+
+    // TODO: temporary
+    if (passName == "PASS_G_OPAQUE" || passName == "PASS_Z_OPAQUE") {
+        key.vertexStride = sizeof(Vertex);
+    } else if (passName == "PASS_LIGHTING_OPAQUE" || passName == "PASS_LIGHTING_OPAQUE_VIEWPOSITION") {
+        key.vertexStride = sizeof(glm::vec4);
+    }
 
-    VkViewport viewport = {};
-    viewport.width = m_device.swapChain->extent.width;
-    viewport.height = m_device.swapChain->extent.height;
-    viewport.maxDepth = 1.0f;
+    // the graph pass of the same name is the one being rendered in
+    const RenderGraph::AttachmentFormats formats = m_renderGraph.attachmentFormats(passName);
+    key.colorAttachmentCount = formats.colorCount;
+    key.colorAttachmentFormats = formats.color;
+    key.depthAttachmentFormat = formats.depth;
+    key.cullMode = VK_CULL_MODE_NONE; // TODO: implement cull mode
 
-    VkRect2D scissor = {};
-    scissor.extent = m_device.swapChain->extent;
+    return key;
+}
 
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+uint64_t GameRenderer::shaderHash(const physis_SHPK &shaderPackage, const bool pixelShader, const uint32_t index)
+{
+    const physis_Shader &shader = pixelShader ? shaderPackage.pixel_shaders[index] : shaderPackage.vertex_shaders[index];
+
+    const std::tuple<const void *, bool, uint32_t> memoKey{shaderPackage.p_ptr, pixelShader, index};
+    if (const auto it = m_shaderHashes.find(memoKey); it != m_shaderHashes.cend() && it->second.bytecode == shader.bytecode && it->second.length == shader.len) {
+        return it->second.hash;
+    }
+
+    // FNV-1a, this only runs once per shader so it doesn't need to be fancy
+    uint64_t hash = 0xcbf29ce484222325;
+    const auto bytes = reinterpret_cast<const uint8_t *>(shader.bytecode);
+    for (uint32_t i = 0; i < shader.len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+
+    m_shaderHashes[memoKey] = ShaderHash{shader.bytecode, shader.len, hash};
 
-    return pipeline;
+    return hash;
 }
 
-VkShaderModule GameRenderer::convertShaderModule(const physis_Shader &shader, spv::ExecutionModel executionModel)
+size_t GameRenderer::PipelineKeyHash::operator()(const PipelineKey &key) const
 {
-    dxvk::DxbcReader reader(reinterpret_cast<const char *>(shader.bytecode), shader.len);
+    const auto combine = [](uint64_t seed, const uint64_t value) {
+        return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+    };
+
+    uint64_t hash = key.vertexShaderHash;
+    hash = combine(hash, key.pixelShaderHash);
+    hash = combine(hash, key.pass);
+    hash = combine(hash, key.colorAttachmentCount);
+    for (const auto format : key.colorAttachmentFormats) {
+        hash = combine(hash, format);
+    }
+    hash = combine(hash, key.depthAttachmentFormat);
+    hash = combine(hash, key.vertexStride);
+    hash = combine(hash, key.cullMode);
 
-    dxvk::DxbcModule module(reader);
+    return hash;
+}
 
-    dxvk::DxbcModuleInfo info;
-    auto result = module.compile(info, "test");
+VkShaderModule GameRenderer::convertShaderModule(const ShaderSource &shader, spv::ExecutionModel executionModel)
+{
+    const std::vector<uint32_t> code = m_shaderCache.spirv(shader.bytecode);
 
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = result.code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(result.code.data());
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
 
     VkShaderModule shaderModule;
     vkCreateShaderModule(m_device.device, &createInfo, nullptr, &shaderModule);
 
-    // TODO: for debug only
-    spirv_cross::CompilerGLSL glsl(result.code.data(), result.code.dwords());
+    // decompiling is slow, so it's only done when debugging shaders
+    if (qgetenv("NOVUS_DUMP_GLSL") == QByteArrayLiteral("1")) {
+        spirv_cross::CompilerGLSL glsl(code.data(), code.size());
 
-    auto resources = glsl.get_shader_resources();
+        auto resources = glsl.get_shader_resources();
 
-    int i = 0;
-    for (auto texture : resources.stage_inputs) {
-        // glsl.set_name(texture.id, shader.)
-        // qInfo() << shader.resource_parameters[i].name << texture.id;
-        // qInfo() << "stage input" << i << texture.name << glsl.get_type(texture.type_id).width;
-        i++;
-        // glsl.set_name(remap.combined_id, "SPIRV_Cross_Combined");
-    }
+        // Here you can also set up decorations if you want (binding = #N).
+        size_t i = 0;
+        for (auto texture : resources.separate_images) {
+            if (i < shader.resourceParameters.size()) {
+                glsl.set_name(texture.id, shader.resourceParameters[i]);
+            }
+            i++;
+        }
 
-    // Here you can also set up decorations if you want (binding = #N).
-    i = 0;
-    for (auto texture : resources.separate_images) {
-        glsl.set_name(texture.id, shader.resource_parameters[i].name);
-        i++;
-    }
+        i = 0;
+        for (auto buffer : resources.uniform_buffers) {
+            if (i < shader.scalarParameters.size()) {
+                glsl.set_name(buffer.id, shader.scalarParameters[i]);
+            }
+            i++;
+        }
+
+        spirv_cross::CompilerGLSL::Options options;
+        options.vulkan_semantics = true;
+        options.enable_420pack_extension = false;
+        glsl.set_common_options(options);
+        glsl.set_entry_point("main", executionModel);
 
-    i = 0;
-    for (auto buffer : resources.uniform_buffers) {
-        glsl.set_name(buffer.id, shader.scalar_parameters[i].name);
-        i++;
+        qInfo() << "Compiled GLSL:" << glsl.compile().c_str();
     }
 
-    spirv_cross::CompilerGLSL::Options options;
-    options.vulkan_semantics = true;
-    options.enable_420pack_extension = false;
-    glsl.set_common_options(options);
-    glsl.set_entry_point("main", executionModel);
+    return shaderModule;
+}
 
-    qInfo() << "Compiled GLSL:" << glsl.compile().c_str();
+spirv_cross::CompilerGLSL GameRenderer::getShaderModuleResources(const ShaderSource &shader)
+{
+    const std::vector<uint32_t> code = m_shaderCache.spirv(shader.bytecode);
 
-    return shaderModule;
+    // glsl.build_combined_image_samplers();
+
+    return spirv_cross::CompilerGLSL(code.data(), code.size());
+}
+
+void GameRenderer::resolveBindings(std::vector<RequestedSet> &requestedSets, const ShaderSource &vertexShader, const ShaderSource &pixelShader)
+{
+    for (auto &set : requestedSets) {
+        int z = 0;
+        int p = 0;
+        VkShaderStageFlags currentStageFlags = 0;
+        for (auto &binding : set.bindings) {
+            if (!binding.used) {
+                continue;
+            }
+
+            // a giant hack
+            if (currentStageFlags != binding.stageFlags) {
+                z = 0;
+                p = 0;
+                currentStageFlags = binding.stageFlags;
+            }
+
+            if (binding.type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE) {
+                if (binding.stageFlags == VK_SHADER_STAGE_FRAGMENT_BIT && p < 4 && static_cast<size_t>(p) < pixelShader.resourceParameters.size()) {
+                    binding.name = pixelShader.resourceParameters[p];
+                    p++;
+                }
+            } else if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+                if (binding.stageFlags == VK_SHADER_STAGE_VERTEX_BIT && static_cast<size_t>(z) < vertexShader.scalarParameters.size()) {
+                    binding.name = vertexShader.scalarParameters[z];
+                    z++;
+                } else if (binding.stageFlags == VK_SHADER_STAGE_FRAGMENT_BIT && static_cast<size_t>(z) < pixelShader.scalarParameters.size()) {
+                    binding.name = pixelShader.scalarParameters[z];
+                    z++;
+                }
+
+                // data that changes between frames or draws comes from the uniform ring
+                if (!binding.name.empty() && dynamicUniformFor(binding.name.c_str())) {
+                    binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                }
+            }
+        }
+    }
 }
 
-spirv_cross::CompilerGLSL GameRenderer::getShaderModuleResources(const physis_Shader &shader)
+GameRenderer::ShaderSource GameRenderer::copyShader(const physis_Shader &shader)
 {
-    dxvk::DxbcReader reader(reinterpret_cast<const char *>(shader.bytecode), shader.len);
+    ShaderSource source;
+    source.bytecode = QByteArray(reinterpret_cast<const char *>(shader.bytecode), shader.len);
 
-    dxvk::DxbcModule module(reader);
+    for (uint32_t i = 0; i < shader.num_scalar_parameters; i++) {
+        source.scalarParameters.emplace_back(shader.scalar_parameters[i].name);
+    }
+    for (uint32_t i = 0; i < shader.num_resource_parameters; i++) {
+        source.resourceParameters.emplace_back(shader.resource_parameters[i].name);
+    }
 
-    dxvk::DxbcModuleInfo info;
-    auto result = module.compile(info, "test");
+    return source;
+}
 
-    // glsl.build_combined_image_samplers();
+std::optional<GameRenderer::DynamicUniform> GameRenderer::dynamicUniformFor(const char *name)
+{
+    if (strcmp(name, "g_CameraParameter") == 0) {
+        return CameraUniform;
+    } else if (strcmp(name, "g_ModelParameter") == 0) {
+        return ModelUniform;
+    } else if (strcmp(name, "g_MaterialParameter") == 0) {
+        return MaterialUniform;
+    } else if (strcmp(name, "g_JointMatrixArray") == 0) {
+        return JointMatrixUniform;
+    }
 
-    return spirv_cross::CompilerGLSL(result.code.data(), result.code.dwords());
+    return std::nullopt;
 }
 
-VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, const CachedPipeline &pipeline, int i, const RenderMaterial *material)
+GameRenderer::CachedDescriptor GameRenderer::createDescriptorFor(const CachedPipeline &pipeline, int i, const RenderTexture *normalTexture)
 {
-    VkDescriptorSet set;
+    CachedDescriptor descriptor;
 
     VkDescriptorSetAllocateInfo allocateInfo = {};
     allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -915,10 +1114,10 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, cons
     allocateInfo.descriptorSetCount = 1;
     allocateInfo.pSetLayouts = &pipeline.setLayouts[i];
 
-    vkAllocateDescriptorSets(m_device.device, &allocateInfo, &set);
-    if (set == VK_NULL_HANDLE) {
+    vkAllocateDescriptorSets(m_device.device, &allocateInfo, &descriptor.set);
+    if (descriptor.set == VK_NULL_HANDLE) {
         // qFatal("Failed to create descriptor set!");
-        return VK_NULL_HANDLE;
+        return descriptor;
     }
 
     // TODO: way too eager
@@ -931,22 +1130,12 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, cons
     imageInfo.reserve(pipeline.requestedSets[i].bindings.size());
 
     int j = 0;
-    int z = 0;
-    int p = 0;
-    VkShaderStageFlags currentStageFlags;
-    for (auto binding : pipeline.requestedSets[i].bindings) {
+    for (const auto &binding : pipeline.requestedSets[i].bindings) {
         if (binding.used) {
-            // a giant hack
-            if (currentStageFlags != binding.stageFlags) {
-                z = 0;
-                p = 0;
-                currentStageFlags = binding.stageFlags;
-            }
-
             VkWriteDescriptorSet &descriptorWrite = writes.emplace_back();
             descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             descriptorWrite.descriptorType = binding.type;
-            descriptorWrite.dstSet = set;
+            descriptorWrite.dstSet = descriptor.set;
             descriptorWrite.descriptorCount = 1;
             descriptorWrite.dstBinding = j;
 
@@ -955,24 +1144,25 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, cons
                 auto info = &imageInfo.emplace_back();
                 descriptorWrite.pImageInfo = info;
 
-                if (binding.stageFlags == VK_SHADER_STAGE_FRAGMENT_BIT && p < 4) {
-                    auto name = pipeline.pixelShader.resource_parameters[p].name;
+                if (!binding.name.empty()) {
+                    const char *name = binding.name.c_str();
                     qInfo() << "Requesting image" << name << "at" << j;
                     if (strcmp(name, "g_SamplerGBuffer") == 0) {
-                        info->imageView = m_normalGBuffer.imageView;
+                        info->imageView = m_renderGraph.texture(m_normalGBuffer).imageView;
                     } else if (strcmp(name, "g_SamplerViewPosition") == 0) {
-                        info->imageView = m_viewPositionBuffer.imageView;
+                        info->imageView = m_renderGraph.texture(m_viewPositionBuffer).imageView;
                     } else if (strcmp(name, "g_SamplerDepth") == 0) {
-                        info->imageView = m_depthBuffer.imageView;
+                        info->imageView = m_renderGraph.texture(m_depthBuffer).imageView;
                     } else if (strcmp(name, "g_SamplerNormal") == 0) {
-                        Q_ASSERT(material);
-                        info->imageView = material->normalTexture->view;
+                        if (normalTexture != nullptr) {
+                            info->imageView = normalTexture->view;
+                        } else {
+                            info->imageView = m_dummyTex.imageView;
+                        }
                     } else {
                         info->imageView = m_dummyTex.imageView;
                         qInfo() << "Unknown image" << name;
                     }
-
-                    p++;
                 } else {
                     info->imageView = m_dummyTex.imageView;
                 }
@@ -985,6 +1175,33 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, cons
 
                 info->sampler = m_sampler;
             } break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC: {
+                auto info = &bufferInfo.emplace_back();
+                descriptorWrite.pBufferInfo = info;
+
+                qInfo() << "Requesting" << binding.name.c_str() << "at" << j;
+
+                const DynamicUniform uniform = *dynamicUniformFor(binding.name.c_str());
+                descriptor.dynamicUniforms.push_back(uniform);
+
+                info->buffer = m_uniformRing.buffer();
+                switch (uniform) {
+                case CameraUniform:
+                    info->range = sizeof(CameraParameter);
+                    break;
+                case ModelUniform:
+                    info->range = sizeof(ModelParameter);
+                    break;
+                case MaterialUniform:
+                    info->range = sizeof(MaterialParameters);
+                    break;
+                case JointMatrixUniform:
+                    info->range = sizeof(JointMatrixArray);
+                    break;
+                default:
+                    break;
+                }
+            } break;
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: {
                 auto info = &bufferInfo.emplace_back();
                 descriptorWrite.pBufferInfo = info;
@@ -994,20 +1211,12 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, cons
                     info->range = buffer.size;
                 };
 
-                auto bindBuffer = [this, &useUniformBuffer, &info, j, &object](const char *name) {
+                if (!binding.name.empty()) {
+                    const char *name = binding.name.c_str();
                     qInfo() << "Requesting" << name << "at" << j;
 
-                    if (strcmp(name, "g_CameraParameter") == 0) {
-                        useUniformBuffer(g_CameraParameter);
-                    } else if (strcmp(name, "g_JointMatrixArray") == 0) {
-                        Q_ASSERT(object != nullptr);
-                        useUniformBuffer(object->boneInfoBuffer);
-                    } else if (strcmp(name, "g_InstanceParameter") == 0) {
+                    if (strcmp(name, "g_InstanceParameter") == 0) {
                         useUniformBuffer(g_InstanceParameter);
-                    } else if (strcmp(name, "g_ModelParameter") == 0) {
-                        useUniformBuffer(g_ModelParameter);
-                    } else if (strcmp(name, "g_MaterialParameter") == 0) {
-                        useUniformBuffer(g_MaterialParameter);
                     } else if (strcmp(name, "g_LightParam") == 0) {
                         useUniformBuffer(g_LightParam);
                     } else if (strcmp(name, "g_CommonParameter") == 0) {
@@ -1021,18 +1230,6 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, cons
                         info->buffer = m_dummyBuffer.buffer;
                         info->range = 655360;
                     }
-                };
-
-                if (binding.stageFlags == VK_SHADER_STAGE_VERTEX_BIT) {
-                    auto name = pipeline.vertexShader.scalar_parameters[z].name;
-
-                    bindBuffer(name);
-                    z++;
-                } else if (binding.stageFlags == VK_SHADER_STAGE_FRAGMENT_BIT) {
-                    auto name = pipeline.pixelShader.scalar_parameters[z].name;
-
-                    bindBuffer(name);
-                    z++;
                 } else {
                     // placeholder buffer so it at least doesn't crash
                     info->buffer = m_dummyBuffer.buffer;
@@ -1046,27 +1243,20 @@ VkDescriptorSet GameRenderer::createDescriptorFor(const DrawObject *object, cons
 
     vkUpdateDescriptorSets(m_device.device, writes.size(), writes.data(), 0, nullptr);
 
-    return set;
+    return descriptor;
 }
 
 void GameRenderer::createImageResources()
 {
-    m_normalGBuffer = m_device.createTexture(m_device.swapChain->extent.width,
-                                             m_device.swapChain->extent.height,
-                                             VK_FORMAT_R8G8B8A8_UNORM,
-                                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
-    m_viewPositionBuffer = m_device.createTexture(m_device.swapChain->extent.width,
-                                                  m_device.swapChain->extent.height,
-                                                  VK_FORMAT_R8G8B8A8_UNORM,
-                                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
-    m_compositeBuffer = m_device.createTexture(m_device.swapChain->extent.width,
-                                               m_device.swapChain->extent.height,
-                                               VK_FORMAT_R8G8B8A8_UNORM,
-                                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
-    m_depthBuffer = m_device.createTexture(m_device.swapChain->extent.width,
-                                           m_device.swapChain->extent.height,
-                                           VK_FORMAT_D32_SFLOAT,
-                                           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    m_renderGraph.compile(m_device.swapChain->extent);
+
+    if (qgetenv("NOVUS_DUMP_RENDERGRAPH") == QByteArrayLiteral("1")) {
+        QFile file(QStringLiteral("rendergraph.dot"));
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(m_renderGraph.toDot().toUtf8());
+            qInfo() << "Wrote the render graph to" << QFileInfo(file).absoluteFilePath();
+        }
+    }
 
     CommonParameter commonParam{};
     commonParam.m_RenderTarget = {1.0f / m_device.swapChain->extent.width,
@@ -1077,29 +1267,77 @@ void GameRenderer::createImageResources()
     m_device.copyToBuffer(g_CommonParameter, &commonParam, sizeof(CommonParameter));
 }
 
+const CullingStatistics &GameRenderer::cullingStatistics() const
+{
+    return m_culler.statistics();
+}
+
+bool GameRenderer::hasPendingWork() const
+{
+    // anything using these pipelines was skipped, and is drawn once collectFinishedPipelines() picks them up
+    return !m_pendingPipelines.empty();
+}
+
+void GameRenderer::textureDestroyed(const uint64_t textureId)
+{
+    for (auto &[key, pipeline] : m_cachedPipelines) {
+        for (auto it = pipeline.cachedDescriptors.begin(); it != pipeline.cachedDescriptors.end();) {
+            if (it->first.second == textureId) {
+                vkFreeDescriptorSets(m_device.device, m_device.descriptorPool, 1, &it->second.set);
+                it = pipeline.cachedDescriptors.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
 Texture &GameRenderer::getCompositeTexture()
 {
-    return m_compositeBuffer;
+    return m_renderGraph.texture(m_compositeBuffer);
 }
 
-void GameRenderer::bindDescriptorSets(VkCommandBuffer commandBuffer,
+bool GameRenderer::bindDescriptorSets(VkCommandBuffer commandBuffer,
                                       GameRenderer::CachedPipeline &pipeline,
-                                      const DrawObject *object,
+                                      const DynamicOffsets &offsets,
                                       const RenderMaterial *material)
 {
-    int i = 0;
-    for (auto setLayout : pipeline.setLayouts) {
-        if (!pipeline.cachedDescriptors.count(i)) {
-            if (auto descriptor = createDescriptorFor(object, pipeline, i, material); descriptor != VK_NULL_HANDLE) {
-                pipeline.cachedDescriptors[i] = descriptor;
+    // until the normal texture is uploaded, the placeholder is bound instead
+    const RenderTexture *normalTexture = nullptr;
+    if (material != nullptr && material->normalTexture != nullptr && m_device.textureUploader->isComplete(material->normalTexture->uploadValue)) {
+        normalTexture = material->normalTexture;
+    }
+
+    std::vector<VkDescriptorSet> sets;
+    std::vector<uint32_t> dynamicOffsets;
+    sets.reserve(pipeline.setLayouts.size());
+
+    for (size_t i = 0; i < pipeline.setLayouts.size(); i++) {
+        const auto key = std::make_pair(static_cast<int>(i), normalTexture != nullptr ? normalTexture->id : 0);
+        if (!pipeline.cachedDescriptors.count(key)) {
+            if (auto descriptor = createDescriptorFor(pipeline, i, normalTexture); descriptor.set != VK_NULL_HANDLE) {
+                pipeline.cachedDescriptors[key] = descriptor;
             } else {
-                continue;
+                return false;
             }
         }
 
-        // TODO: we can pass all descriptors in one function call
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, i, 1, &pipeline.cachedDescriptors[i], 0, nullptr);
-
-        i++;
+        const auto &descriptor = pipeline.cachedDescriptors[key];
+        sets.push_back(descriptor.set);
+        for (const auto uniform : descriptor.dynamicUniforms) {
+            dynamicOffsets.push_back(offsets[uniform]);
+        }
     }
+
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipeline.pipelineLayout,
+                            0,
+                            sets.size(),
+                            sets.data(),
+                            dynamicOffsets.size(),
+                            dynamicOffsets.data());
+    m_device.profiler->count(Profiler::DescriptorBinds);
+
+    return true;
 }
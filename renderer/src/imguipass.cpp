@@ -8,7 +8,12 @@
 #include <glm/glm.hpp>
 #include <imgui.h>
 
+#include "framescheduler.h"
+#include "memoryallocator.h"
+#include "pipelinecache.h"
+#include "profiler.h"
 #include "rendermanager.h"
+#include "textureuploader.h"
 
 ImGuiPass::ImGuiPass(RenderManager &renderer)
     : renderer_(renderer)
@@ -20,15 +25,17 @@ ImGuiPass::ImGuiPass(RenderManager &renderer)
 
 ImGuiPass::~ImGuiPass()
 {
-    vkDestroySampler(renderer_.device().device, fontSampler_, nullptr);
     vkDestroyImageView(renderer_.device().device, fontImageView_, nullptr);
-    vkFreeMemory(renderer_.device().device, fontMemory_, nullptr);
     vkDestroyImage(renderer_.device().device, fontImage_, nullptr);
+    renderer_.device().allocator->free(fontAllocation_);
 
     vkDestroyPipeline(renderer_.device().device, pipeline_, nullptr);
     vkDestroyPipelineLayout(renderer_.device().device, pipelineLayout_, nullptr);
 
     vkDestroyDescriptorSetLayout(renderer_.device().device, setLayout_, nullptr);
+
+    renderer_.device().destroyBuffer(vertexBuffer);
+    renderer_.device().destroyBuffer(indexBuffer);
 }
 
 void ImGuiPass::render(VkCommandBuffer commandBuffer)
@@ -40,23 +47,21 @@ void ImGuiPass::render(VkCommandBuffer commandBuffer)
 
     const size_t newVertexSize = drawData->TotalVtxCount * sizeof(ImDrawVert);
     if (newVertexSize > vertexSize) {
-        createBuffer(vertexBuffer, vertexMemory, newVertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        createBuffer(vertexBuffer, newVertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
         vertexSize = newVertexSize;
     }
 
     const size_t newIndexSize = drawData->TotalIdxCount * sizeof(ImDrawIdx);
     if (newIndexSize > indexSize) {
-        createBuffer(indexBuffer, indexMemory, newIndexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        createBuffer(indexBuffer, newIndexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
         indexSize = newIndexSize;
     }
 
     if (vertexSize == 0 || indexSize == 0)
         return;
 
-    ImDrawVert *vertexData = nullptr;
-    ImDrawIdx *indexData = nullptr;
-    vkMapMemory(renderer_.device().device, vertexMemory, 0, vertexSize, 0, reinterpret_cast<void **>(&vertexData));
-    vkMapMemory(renderer_.device().device, indexMemory, 0, indexSize, 0, reinterpret_cast<void **>(&indexData));
+    auto vertexData = static_cast<ImDrawVert *>(vertexBuffer.allocation.mapped);
+    auto indexData = static_cast<ImDrawIdx *>(indexBuffer.allocation.mapped);
 
     for (int i = 0; i < drawData->CmdListsCount; i++) {
         const ImDrawList *cmd_list = drawData->CmdLists[i];
@@ -68,14 +73,14 @@ void ImGuiPass::render(VkCommandBuffer commandBuffer)
         indexData += cmd_list->IdxBuffer.Size;
     }
 
-    vkUnmapMemory(renderer_.device().device, vertexMemory);
-    vkUnmapMemory(renderer_.device().device, indexMemory);
-
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
 
+    Profiler &profiler = *renderer_.device().profiler;
+    profiler.count(Profiler::PipelineBinds);
+
     VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
     float scale[2];
     scale[0] = 2.0f / drawData->DisplaySize.x;
@@ -132,6 +137,7 @@ void ImGuiPass::render(VkCommandBuffer commandBuffer)
 
                 descriptorSets_[(VkImageView)pcmd->TextureId] = set;
             }
+            profiler.count(Profiler::DescriptorBinds);
 
             if (pcmd->UserCallback) {
                 pcmd->UserCallback(cmd_list, pcmd);
@@ -145,6 +151,8 @@ void ImGuiPass::render(VkCommandBuffer commandBuffer)
                 vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
                 vkCmdDrawIndexed(commandBuffer, pcmd->ElemCount, 1, indexOffset, vertexOffset, 0);
+                profiler.count(Profiler::DrawCalls);
+                profiler.count(Profiler::Triangles, pcmd->ElemCount / 3);
             }
 
             indexOffset += pcmd->ElemCount;
@@ -288,7 +296,7 @@ void ImGuiPass::createPipeline()
     pipelineInfo.pDepthStencilState = &depthStencilStateCreateInfo;
     pipelineInfo.renderPass = renderer_.presentationRenderPass();
 
-    vkCreateGraphicsPipelines(renderer_.device().device, nullptr, 1, &pipelineInfo, nullptr, &pipeline_);
+    vkCreateGraphicsPipelines(renderer_.device().device, renderer_.device().pipelineCache->handle(), 1, &pipelineInfo, nullptr, &pipeline_);
 
     vkDestroyShaderModule(renderer_.device().device, fragShaderModule, nullptr);
     vkDestroyShaderModule(renderer_.device().device, vertShaderModule, nullptr);
@@ -303,37 +311,26 @@ void ImGuiPass::createFontImage()
     io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
 
     auto texture = renderer_.addTexture(width, height, pixels, width * height * 4);
+
+    // there is no placeholder for the font atlas
+    renderer_.device().textureUploader->wait(texture.uploadValue);
+    fontImage_ = texture.handle;
+    fontAllocation_ = texture.allocation;
     fontImageView_ = texture.view;
     fontSampler_ = texture.sampler;
 
     io.Fonts->SetTexID(static_cast<ImTextureID>(fontImageView_));
 }
 
-void ImGuiPass::createBuffer(VkBuffer &buffer, VkDeviceMemory &memory, VkDeviceSize size, VkBufferUsageFlagBits bufferUsage)
+void ImGuiPass::createBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlagBits bufferUsage)
 {
-    if (buffer != nullptr)
-        vkDestroyBuffer(renderer_.device().device, buffer, nullptr);
-
-    if (memory != nullptr)
-        vkFreeMemory(renderer_.device().device, memory, nullptr);
-
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = bufferUsage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    vkCreateBuffer(renderer_.device().device, &bufferInfo, nullptr, &buffer);
-
-    VkMemoryRequirements memRequirements = {};
-    vkGetBufferMemoryRequirements(renderer_.device().device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        renderer_.device().findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        // the old buffer might still be in use by a previous frame
+        Device *device = &renderer_.device();
+        device->frameScheduler->retire([device, oldBuffer = buffer]() mutable {
+            device->destroyBuffer(oldBuffer);
+        });
+    }
 
-    vkAllocateMemory(renderer_.device().device, &allocInfo, nullptr, &memory);
-    vkBindBufferMemory(renderer_.device().device, buffer, memory, 0);
+    buffer = renderer_.device().createBuffer(size, bufferUsage);
 }
@@ -6,6 +6,8 @@
 #include <map>
 #include <vulkan/vulkan.h>
 
+#include "buffer.h"
+
 class RenderManager;
 
 class ImGuiPass
@@ -20,7 +22,7 @@ private:
     void createDescriptorSetLayout();
     void createPipeline();
     void createFontImage();
-    void createBuffer(VkBuffer &buffer, VkDeviceMemory &memory, VkDeviceSize size, VkBufferUsageFlagBits bufferUsage);
+    void createBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlagBits bufferUsage);
 
     VkDescriptorSetLayout setLayout_ = nullptr;
 
@@ -28,12 +30,12 @@ private:
     VkPipeline pipeline_ = nullptr;
 
     VkImage fontImage_ = nullptr;
-    VkDeviceMemory fontMemory_ = nullptr;
+    Allocation fontAllocation_;
     VkImageView fontImageView_ = nullptr;
+    // owned by the SamplerCache, shared with every other texture using it
     VkSampler fontSampler_ = nullptr;
 
-    VkBuffer vertexBuffer = VK_NULL_HANDLE, indexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory vertexMemory = VK_NULL_HANDLE, indexMemory = VK_NULL_HANDLE;
+    Buffer vertexBuffer, indexBuffer;
     size_t vertexSize = 0, indexSize = 0;
 
     std::map<VkImageView, VkDescriptorSet> descriptorSets_ = {};
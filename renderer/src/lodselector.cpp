@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "lodselector.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+#include "camera.h"
+#include "drawobject.h"
+
+// the most detailed LOD is used while the model covers at least this much of the screen's height, each LOD after that halves it
+const float fullDetailCoverage = 0.25f;
+
+// how far past a switching point a model has to get before switching back, as a fraction of a LOD
+const float hysteresis = 0.25f;
+
+LodSelector::LodSelector()
+{
+    if (const QByteArray bias = qgetenv("NOVUS_LOD_BIAS"); !bias.isEmpty()) {
+        bool ok = false;
+        m_bias = bias.toFloat(&ok);
+        if (!ok) {
+            qWarning() << "Invalid NOVUS_LOD_BIAS" << bias << ", it should be a number";
+            m_bias = 0.0f;
+        }
+    }
+}
+
+void LodSelector::beginFrame(const Camera &camera)
+{
+    m_cameraPosition = glm::vec3(glm::inverse(camera.view)[3]);
+    m_projectionScale = std::abs(camera.perspective[1][1]) * 0.5f;
+
+    std::swap(m_previousLods, m_currentLods);
+    m_currentLods.clear();
+}
+
+const RenderLod &LodSelector::select(const DrawObject &model, const glm::vec3 &translation)
+{
+    const uint32_t lastLod = model.lods.size() - 1;
+
+    if (model.lod != DrawObject::automaticLod) {
+        return model.lods[std::min<uint32_t>(model.lod, lastLod)];
+    }
+
+    const float level = this->level(model, translation);
+
+    // a model at level 0 and closer uses LOD 0, up to level 1 it's LOD 1, and so on
+    auto lod = static_cast<uint32_t>(std::clamp(std::floor(level) + 1.0f, 0.0f, static_cast<float>(lastLod)));
+
+    if (const auto previous = m_previousLods.find(model.id); previous != m_previousLods.end() && previous->second <= lastLod) {
+        const float previousLod = previous->second;
+        if (level >= previousLod - 1.0f - hysteresis && level < previousLod + hysteresis) {
+            lod = previous->second;
+        }
+    }
+
+    m_currentLods[model.id] = lod;
+
+    return model.lods[lod];
+}
+
+float LodSelector::bias() const
+{
+    return m_bias;
+}
+
+void LodSelector::setBias(const float bias)
+{
+    m_bias = bias;
+}
+
+float LodSelector::level(const DrawObject &model, const glm::vec3 &translation) const
+{
+    const glm::vec3 center = model.boundingSphere.center + translation;
+    const float distance = glm::distance(center, m_cameraPosition);
+
+    // the camera is inside of the model
+    if (distance <= model.boundingSphere.radius) {
+        return -1.0f + m_bias;
+    }
+
+    const float coverage = model.boundingSphere.radius * 2.0f * m_projectionScale / distance;
+    if (coverage <= 0.0f) {
+        return static_cast<float>(model.lods.size()) + m_bias;
+    }
+
+    return std::log2(fullDetailCoverage / coverage) + m_bias;
+}
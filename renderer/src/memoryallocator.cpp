@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "memoryallocator.h"
+
+#include <algorithm>
+
+#include <QDebug>
+
+#include "device.h"
+
+// the size of a regular block, smaller heaps (like the 256 MiB BAR on some dGPUs) get smaller blocks
+const VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+
+static VkDeviceSize alignUp(const VkDeviceSize value, const VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+MemoryAllocator::MemoryAllocator(Device &device)
+    : m_device(device)
+{
+    vkGetPhysicalDeviceMemoryProperties(m_device.physicalDevice, &m_memoryProperties);
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    for (auto &block : m_blocks) {
+        if (block->mapped != nullptr) {
+            vkUnmapMemory(m_device.device, block->memory);
+        }
+        vkFreeMemory(m_device.device, block->memory, nullptr);
+    }
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, const VkMemoryPropertyFlags properties, const bool linear)
+{
+    const uint32_t memoryType = m_device.findMemoryType(requirements.memoryTypeBits, properties);
+    if (memoryType == static_cast<uint32_t>(-1)) {
+        qWarning() << "Failed to find a suitable memory type for" << requirements.size << "bytes";
+        return {};
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    const VkDeviceSize blockSize = preferredBlockSize(memoryType);
+
+    Block *chosenBlock = nullptr;
+    VkDeviceSize offset = 0;
+
+    // large resources would waste most of a shared block, so they get their own
+    if (requirements.size > blockSize / 2) {
+        chosenBlock = createBlock(memoryType, requirements.size, linear, true);
+    } else {
+        for (auto &block : m_blocks) {
+            if (block->memoryType != memoryType || block->linear != linear || block->dedicated) {
+                continue;
+            }
+
+            if (allocateFromBlock(*block, requirements.size, requirements.alignment, offset)) {
+                chosenBlock = block.get();
+                break;
+            }
+        }
+
+        if (chosenBlock == nullptr) {
+            chosenBlock = createBlock(memoryType, blockSize, linear, false);
+            if (chosenBlock != nullptr) {
+                allocateFromBlock(*chosenBlock, requirements.size, requirements.alignment, offset);
+            }
+        }
+    }
+
+    if (chosenBlock == nullptr) {
+        return {};
+    }
+
+    if (chosenBlock->dedicated) {
+        chosenBlock->freeRanges.clear();
+        offset = 0;
+    }
+
+    chosenBlock->usedBytes += requirements.size;
+
+    Allocation allocation;
+    allocation.memory = chosenBlock->memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.memoryType = memoryType;
+    if (chosenBlock->mapped != nullptr) {
+        allocation.mapped = static_cast<uint8_t *>(chosenBlock->mapped) + offset;
+    }
+
+    return allocation;
+}
+
+void MemoryAllocator::free(const Allocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    auto it = std::find_if(m_blocks.begin(), m_blocks.end(), [&allocation](const std::unique_ptr<Block> &block) {
+        return block->memory == allocation.memory;
+    });
+    if (it == m_blocks.end()) {
+        qWarning() << "Tried to free an allocation that doesn't belong to any block!";
+        return;
+    }
+
+    Block *block = it->get();
+    block->usedBytes -= allocation.size;
+
+    if (block->dedicated) {
+        destroyBlock(block);
+        return;
+    }
+
+    // insert the range back in, merging it with its neighbours
+    auto &ranges = block->freeRanges;
+    auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset, [](const Range &range, const VkDeviceSize offset) {
+        return range.offset < offset;
+    });
+    next = ranges.insert(next, Range{allocation.offset, allocation.size});
+
+    if (next + 1 != ranges.end() && next->offset + next->size == (next + 1)->offset) {
+        next->size += (next + 1)->size;
+        ranges.erase(next + 1);
+    }
+
+    if (next != ranges.begin() && (next - 1)->offset + (next - 1)->size == next->offset) {
+        (next - 1)->size += next->size;
+        ranges.erase(next);
+    }
+
+    // keep one empty block of each kind around, so we don't keep allocating and freeing when a single resource is recreated
+    if (block->usedBytes == 0) {
+        const bool hasOtherBlock = std::any_of(m_blocks.begin(), m_blocks.end(), [block](const std::unique_ptr<Block> &other) {
+            return other.get() != block && other->memoryType == block->memoryType && other->linear == block->linear && !other->dedicated;
+        });
+
+        if (hasOtherBlock) {
+            destroyBlock(block);
+        }
+    }
+}
+
+MemoryAllocator::Statistics MemoryAllocator::statistics()
+{
+    QMutexLocker locker(&m_mutex);
+
+    Statistics statistics;
+    for (const auto &block : m_blocks) {
+        statistics.blockCount++;
+        statistics.blockBytes += block->size;
+        statistics.usedBytes += block->usedBytes;
+    }
+
+    return statistics;
+}
+
+MemoryAllocator::Block *MemoryAllocator::createBlock(const uint32_t memoryType, const VkDeviceSize size, const bool linear, const bool dedicated)
+{
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(m_device.device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        qWarning() << "Failed to allocate a memory block of" << size << "bytes";
+        return nullptr;
+    }
+
+    auto block = std::make_unique<Block>();
+    block->memory = memory;
+    block->size = size;
+    block->memoryType = memoryType;
+    block->linear = linear;
+    block->dedicated = dedicated;
+    block->freeRanges.push_back(Range{0, size});
+
+    // host visible blocks stay mapped for their whole lifetime, you can't map the same memory twice anyway
+    if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkMapMemory(m_device.device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+    }
+
+    return m_blocks.emplace_back(std::move(block)).get();
+}
+
+void MemoryAllocator::destroyBlock(Block *block)
+{
+    if (block->mapped != nullptr) {
+        vkUnmapMemory(m_device.device, block->memory);
+    }
+    vkFreeMemory(m_device.device, block->memory, nullptr);
+
+    m_blocks.erase(std::remove_if(m_blocks.begin(),
+                                  m_blocks.end(),
+                                  [block](const std::unique_ptr<Block> &other) {
+                                      return other.get() == block;
+                                  }),
+                   m_blocks.end());
+}
+
+bool MemoryAllocator::allocateFromBlock(Block &block, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize &offset)
+{
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        const VkDeviceSize alignedOffset = alignUp(it->offset, alignment);
+        const VkDeviceSize padding = alignedOffset - it->offset;
+        if (padding + size > it->size) {
+            continue;
+        }
+
+        const Range tail{alignedOffset + size, it->size - padding - size};
+
+        if (padding > 0) {
+            // the padding before the aligned offset stays free
+            it->size = padding;
+            if (tail.size > 0) {
+                block.freeRanges.insert(it + 1, tail);
+            }
+        } else if (tail.size > 0) {
+            *it = tail;
+        } else {
+            block.freeRanges.erase(it);
+        }
+
+        offset = alignedOffset;
+        return true;
+    }
+
+    return false;
+}
+
+VkDeviceSize MemoryAllocator::preferredBlockSize(const uint32_t memoryType) const
+{
+    const uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryType].heapIndex;
+    const VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+
+    return std::min(defaultBlockSize, heapSize / 8);
+}
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "pipelinecache.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+#include "device.h"
+
+PipelineCache::PipelineCache(Device &device)
+    : m_device(device)
+{
+    vkGetPhysicalDeviceProperties(m_device.physicalDevice, &m_properties);
+
+    // one file per GPU, so switching between them doesn't throw away the other's cache
+    const QDir cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    m_path = cacheDir.absoluteFilePath(QStringLiteral("pipelines-%1-%2.bin").arg(m_properties.vendorID, 0, 16).arg(m_properties.deviceID, 0, 16));
+
+    QByteArray initialData;
+
+    QFile file(m_path);
+    if (file.open(QIODevice::ReadOnly)) {
+        initialData = file.readAll();
+
+        if (isCompatible(initialData)) {
+            qInfo() << "Loaded" << initialData.size() << "bytes of pipeline cache from" << m_path;
+        } else {
+            qInfo() << "Ignoring pipeline cache from a different driver or device at" << m_path;
+            initialData.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = initialData.size();
+    createInfo.pInitialData = initialData.isEmpty() ? nullptr : initialData.constData();
+
+    if (vkCreatePipelineCache(m_device.device, &createInfo, nullptr, &m_cache) != VK_SUCCESS) {
+        // the data passed the header check but the driver still didn't like it, so start over
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+
+        vkCreatePipelineCache(m_device.device, &createInfo, nullptr, &m_cache);
+    }
+
+    // RenderManager lives until the end of the application, so this is the last chance to write the cache
+    if (auto app = QCoreApplication::instance()) {
+        m_quitConnection = QObject::connect(app, &QCoreApplication::aboutToQuit, [this] {
+            save();
+        });
+    }
+}
+
+PipelineCache::~PipelineCache()
+{
+    QObject::disconnect(m_quitConnection);
+
+    save();
+    vkDestroyPipelineCache(m_device.device, m_cache, nullptr);
+}
+
+VkPipelineCache PipelineCache::handle() const
+{
+    return m_cache;
+}
+
+void PipelineCache::save()
+{
+    if (m_cache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(m_device.device, m_cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+
+    QByteArray data(static_cast<qsizetype>(size), Qt::Uninitialized);
+    if (vkGetPipelineCacheData(m_device.device, m_cache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+    data.truncate(static_cast<qsizetype>(size));
+
+    if (!QDir().mkpath(QFileInfo(m_path).absolutePath())) {
+        qWarning() << "Failed to create the pipeline cache directory for" << m_path;
+        return;
+    }
+
+    // written to a temporary file first, so a crash halfway through doesn't leave a broken cache behind
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << m_path << "for writing the pipeline cache";
+        return;
+    }
+
+    file.write(data);
+
+    if (file.commit()) {
+        qInfo() << "Saved" << data.size() << "bytes of pipeline cache to" << m_path;
+    } else {
+        qWarning() << "Failed to write the pipeline cache to" << m_path;
+    }
+}
+
+bool PipelineCache::isCompatible(const QByteArray &data) const
+{
+    VkPipelineCacheHeaderVersionOne header = {};
+    if (static_cast<size_t>(data.size()) < sizeof(header)) {
+        return false;
+    }
+
+    memcpy(&header, data.constData(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == m_properties.vendorID && header.deviceID == m_properties.deviceID
+        && memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,298 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "profiler.h"
+
+#include <QDebug>
+#include <algorithm>
+
+#include "device.h"
+#include "imgui.h"
+
+Profiler::Profiler(Device &device)
+    : m_device(device)
+{
+    m_enabled = qgetenv("NOVUS_PROFILER") == QByteArrayLiteral("1");
+    if (!m_enabled) {
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_device.physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device.physicalDevice, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device.physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    const uint32_t validBits = queueFamilies[m_device.graphicsFamilyIndex].timestampValidBits;
+
+    // CPU sections and counters still work without timestamps
+    m_timestamps = properties.limits.timestampComputeAndGraphics && validBits > 0;
+    if (!m_timestamps) {
+        qWarning() << "The graphics queue doesn't support timestamps, only CPU sections will be profiled";
+        return;
+    }
+
+    m_timestampPeriod = properties.limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+
+    VkQueryPoolCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = maxQueriesPerFrame * m_frames.size();
+
+    vkCreateQueryPool(m_device.device, &createInfo, nullptr, &m_queryPool);
+}
+
+Profiler::~Profiler()
+{
+    if (m_queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(m_device.device, m_queryPool, nullptr);
+    }
+}
+
+bool Profiler::isEnabled() const
+{
+    return m_enabled;
+}
+
+void Profiler::beginFrame(VkCommandBuffer commandBuffer, const uint32_t frameIndex)
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    m_currentFrame = frameIndex;
+
+    if (m_timestamps) {
+        resolveQueries(frameIndex);
+
+        auto &frame = m_frames[frameIndex];
+        frame.sections.clear();
+        frame.queryCount = 0;
+        frame.submitted = false;
+
+        vkCmdResetQueryPool(commandBuffer, m_queryPool, frameIndex * maxQueriesPerFrame, maxQueriesPerFrame);
+    }
+}
+
+void Profiler::endFrame()
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    m_frames[m_currentFrame].submitted = true;
+
+    for (const auto &[name, milliseconds] : m_cpuSamples) {
+        history(name, false).add(milliseconds);
+    }
+    m_cpuSamples.clear();
+
+    for (size_t i = 0; i < m_counters.size(); i++) {
+        m_lastCounters[i] = m_counters[i].exchange(0, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::count(const Counter counter, const uint64_t amount)
+{
+    if (m_enabled) {
+        m_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+Profiler::CpuScope::CpuScope(Profiler &profiler, const std::string_view name)
+    : m_profiler(profiler)
+    , m_name(name)
+{
+    if (m_profiler.m_enabled) {
+        m_timer.start();
+    }
+}
+
+Profiler::CpuScope::~CpuScope()
+{
+    if (m_profiler.m_enabled) {
+        m_profiler.addCpuSample(m_name, m_timer.nsecsElapsed() / 1000000.0);
+    }
+}
+
+Profiler::GpuScope::GpuScope(Profiler &profiler, VkCommandBuffer commandBuffer, const std::string_view name)
+    : m_profiler(profiler)
+    , m_commandBuffer(commandBuffer)
+    , m_section(profiler.beginGpuSection(commandBuffer, name))
+{
+}
+
+Profiler::GpuScope::~GpuScope()
+{
+    m_profiler.endGpuSection(m_commandBuffer, m_section);
+}
+
+void Profiler::drawOverlay() const
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    for (const bool gpu : {false, true}) {
+        ImGui::TextUnformatted(gpu ? "GPU" : "CPU");
+
+        if (gpu && !m_timestamps) {
+            ImGui::TextUnformatted("Timestamps aren't supported");
+            continue;
+        }
+
+        if (!ImGui::BeginTable(gpu ? "gpuSections" : "cpuSections", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+            continue;
+        }
+
+        ImGui::TableSetupColumn("Section");
+        ImGui::TableSetupColumn("Average");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableHeadersRow();
+
+        for (const auto &history : m_histories) {
+            if (history.gpu != gpu || history.sampleCount == 0) {
+                continue;
+            }
+
+            std::vector<double> sorted(history.samples.begin(), history.samples.begin() + history.sampleCount);
+            std::sort(sorted.begin(), sorted.end());
+
+            double total = 0.0;
+            for (const double sample : sorted) {
+                total += sample;
+            }
+
+            const auto percentile = [&sorted](const double fraction) {
+                return sorted[std::min(static_cast<size_t>(fraction * sorted.size()), sorted.size() - 1)];
+            };
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(history.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f ms", total / sorted.size());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f ms", percentile(0.5));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f ms", percentile(0.95));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f ms", percentile(0.99));
+        }
+
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("Draw calls: %llu", static_cast<unsigned long long>(m_lastCounters[DrawCalls]));
+    ImGui::Text("Dispatches: %llu", static_cast<unsigned long long>(m_lastCounters[Dispatches]));
+    ImGui::Text("Pipeline binds: %llu", static_cast<unsigned long long>(m_lastCounters[PipelineBinds]));
+    ImGui::Text("Descriptor binds: %llu", static_cast<unsigned long long>(m_lastCounters[DescriptorBinds]));
+    ImGui::Text("Pipeline cache hits: %llu, misses: %llu",
+                static_cast<unsigned long long>(m_lastCounters[PipelineHits]),
+                static_cast<unsigned long long>(m_lastCounters[PipelineMisses]));
+    ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(m_lastCounters[Triangles]));
+    ImGui::Text("Uniform bytes: %llu", static_cast<unsigned long long>(m_lastCounters[UniformBytes]));
+    ImGui::Text("Dropped uniform pushes: %llu", static_cast<unsigned long long>(m_lastCounters[UniformDrops]));
+}
+
+void Profiler::History::add(const double milliseconds)
+{
+    samples[nextSample] = milliseconds;
+    nextSample = (nextSample + 1) % samples.size();
+    sampleCount = std::min(sampleCount + 1, samples.size());
+}
+
+Profiler::History &Profiler::history(const std::string_view name, const bool gpu)
+{
+    // there are only a handful of sections, so a linear search is fine and keeps them in the order they first appeared
+    for (auto &history : m_histories) {
+        if (history.gpu == gpu && history.name == name) {
+            return history;
+        }
+    }
+
+    History &history = m_histories.emplace_back();
+    history.name = name;
+    history.gpu = gpu;
+
+    return history;
+}
+
+void Profiler::addCpuSample(const std::string_view name, const double milliseconds)
+{
+    for (auto &[sampleName, total] : m_cpuSamples) {
+        if (sampleName == name) {
+            total += milliseconds;
+            return;
+        }
+    }
+
+    m_cpuSamples.emplace_back(name, milliseconds);
+}
+
+uint32_t Profiler::beginGpuSection(VkCommandBuffer commandBuffer, const std::string_view name)
+{
+    if (!m_enabled || !m_timestamps) {
+        return noSection;
+    }
+
+    auto &frame = m_frames[m_currentFrame];
+    if (frame.queryCount + 2 > maxQueriesPerFrame) {
+        return noSection;
+    }
+
+    GpuSection &section = frame.sections.emplace_back();
+    section.name = name;
+    section.beginQuery = m_currentFrame * maxQueriesPerFrame + frame.queryCount++;
+    section.endQuery = m_currentFrame * maxQueriesPerFrame + frame.queryCount++;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, section.beginQuery);
+
+    return frame.sections.size() - 1;
+}
+
+void Profiler::endGpuSection(VkCommandBuffer commandBuffer, const uint32_t section)
+{
+    if (section == noSection) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, m_frames[m_currentFrame].sections[section].endQuery);
+}
+
+void Profiler::resolveQueries(const uint32_t frameIndex)
+{
+    const auto &frame = m_frames[frameIndex];
+    if (!frame.submitted || frame.queryCount == 0) {
+        return;
+    }
+
+    std::array<uint64_t, maxQueriesPerFrame> timestamps{};
+
+    // the FrameScheduler already waited for this frame, so the results are available without waiting
+    const VkResult result = vkGetQueryPoolResults(m_device.device,
+                                                  m_queryPool,
+                                                  frameIndex * maxQueriesPerFrame,
+                                                  frame.queryCount,
+                                                  sizeof(timestamps),
+                                                  timestamps.data(),
+                                                  sizeof(uint64_t),
+                                                  VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    const uint32_t firstQuery = frameIndex * maxQueriesPerFrame;
+    for (const auto &section : frame.sections) {
+        const uint64_t begin = timestamps[section.beginQuery - firstQuery] & m_timestampMask;
+        const uint64_t end = timestamps[section.endQuery - firstQuery] & m_timestampMask;
+
+        history(section.name, true).add((end - begin) * m_timestampPeriod / 1000000.0);
+    }
+}
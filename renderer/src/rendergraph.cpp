@@ -0,0 +1,624 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "rendergraph.h"
+
+#include <QDebug>
+#include <algorithm>
+
+#include "device.h"
+#include "profiler.h"
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph &graph, const size_t pass)
+    : m_graph(graph)
+    , m_pass(pass)
+{
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::writeColor(const ResourceId image, const std::optional<VkClearColorValue> clearColor)
+{
+    auto &pass = m_graph.m_passes[m_pass];
+
+    Use &use = pass.uses.emplace_back();
+    use.image = image;
+    use.access = Access::ColorWrite;
+    use.clear = clearColor.has_value();
+    if (clearColor) {
+        use.clearValue.color = *clearColor;
+    }
+
+    pass.colorAttachments.push_back(pass.uses.size() - 1);
+
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::skipColor()
+{
+    m_graph.m_passes[m_pass].colorAttachments.push_back(std::nullopt);
+
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::writeDepth(const ResourceId image, const std::optional<float> clearDepth)
+{
+    auto &pass = m_graph.m_passes[m_pass];
+
+    Use &use = pass.uses.emplace_back();
+    use.image = image;
+    use.access = Access::DepthWrite;
+    use.clear = clearDepth.has_value();
+    if (clearDepth) {
+        use.clearValue.depthStencil.depth = *clearDepth;
+    }
+
+    pass.depthAttachment = pass.uses.size() - 1;
+
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::read(const ResourceId image)
+{
+    Use &use = m_graph.m_passes[m_pass].uses.emplace_back();
+    use.image = image;
+    use.access = Access::Read;
+
+    return *this;
+}
+
+RenderGraph::RenderGraph(Device &device)
+    : m_device(device)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    destroyImages();
+}
+
+RenderGraph::ResourceId RenderGraph::createImage(const std::string_view name, const VkFormat format)
+{
+    Image &image = m_images.emplace_back();
+    image.name = name;
+    image.format = format;
+
+    return m_images.size() - 1;
+}
+
+void RenderGraph::markOutput(const ResourceId image)
+{
+    m_images[image].output = true;
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const std::string_view name, ExecuteFunction execute)
+{
+    Pass &pass = m_passes.emplace_back();
+    pass.name = name;
+    pass.execute = std::move(execute);
+
+    return PassBuilder(*this, m_passes.size() - 1);
+}
+
+void RenderGraph::compile(const VkExtent2D extent)
+{
+    destroyImages();
+
+    m_extent = extent;
+
+    cullPasses();
+    createImages();
+    createBarriers();
+
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        auto &pass = m_passes[i];
+        pass.colorAttachmentInfos.clear();
+        pass.depthAttachmentInfo = {};
+
+        if (pass.culled) {
+            continue;
+        }
+
+        const auto attachmentInfo = [this, i](const Use &use, const VkImageLayout layout) {
+            const Image &image = m_images[use.image];
+
+            VkRenderingAttachmentInfo attachmentInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+            attachmentInfo.imageView = image.texture.imageView;
+            attachmentInfo.imageLayout = layout;
+            attachmentInfo.loadOp = use.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+            // nothing after this pass looks at it, so it doesn't have to be written back to memory
+            const bool lastUse = image.lastPass == static_cast<int>(i) && !image.output;
+            attachmentInfo.storeOp = lastUse ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+            attachmentInfo.clearValue = use.clearValue;
+
+            return attachmentInfo;
+        };
+
+        for (const auto &attachment : pass.colorAttachments) {
+            if (attachment) {
+                pass.colorAttachmentInfos.push_back(attachmentInfo(pass.uses[*attachment], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+            } else {
+                VkRenderingAttachmentInfo unusedInfo{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+                unusedInfo.imageView = VK_NULL_HANDLE;
+                unusedInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                unusedInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+                unusedInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+                pass.colorAttachmentInfos.push_back(unusedInfo);
+            }
+        }
+
+        if (pass.depthAttachment) {
+            pass.depthAttachmentInfo = attachmentInfo(pass.uses[*pass.depthAttachment], VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+        }
+    }
+
+    const auto culledCount = std::count_if(m_passes.cbegin(), m_passes.cend(), [](const Pass &pass) {
+        return pass.culled;
+    });
+    qInfo() << "Compiled render graph with" << m_passes.size() - culledCount << "passes (" << culledCount << "culled) and" << m_images.size()
+            << "images in" << m_memorySlots.size() << "memory slots";
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    for (auto &pass : m_passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        Profiler::GpuScope scope(*m_device.profiler, commandBuffer, pass.name);
+
+        if (!pass.barriers.empty()) {
+            vkCmdPipelineBarrier(commandBuffer, pass.srcStages, pass.dstStages, 0, 0, nullptr, 0, nullptr, pass.barriers.size(), pass.barriers.data());
+        }
+
+        VkRenderingInfo renderingInfo{VK_STRUCTURE_TYPE_RENDERING_INFO};
+        renderingInfo.renderArea.extent = m_extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.pColorAttachments = pass.colorAttachmentInfos.data();
+        renderingInfo.colorAttachmentCount = pass.colorAttachmentInfos.size();
+
+        if (pass.depthAttachmentInfo.imageView != VK_NULL_HANDLE) {
+            renderingInfo.pDepthAttachment = &pass.depthAttachmentInfo;
+        }
+
+        vkCmdBeginRendering(commandBuffer, &renderingInfo);
+        pass.execute(commandBuffer);
+        vkCmdEndRendering(commandBuffer);
+    }
+
+    if (!m_finalBarriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer,
+                             m_finalSrcStages,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             m_finalBarriers.size(),
+                             m_finalBarriers.data());
+    }
+}
+
+RenderGraph::AttachmentFormats RenderGraph::attachmentFormats(const std::string_view passName) const
+{
+    AttachmentFormats formats;
+
+    const auto pass = std::find_if(m_passes.cbegin(), m_passes.cend(), [passName](const Pass &pass) {
+        return pass.name == passName;
+    });
+    if (pass == m_passes.cend()) {
+        qWarning() << "There is no pass named" << passName.data() << "in the render graph";
+        return formats;
+    }
+
+    if (pass->colorAttachments.size() > maxColorAttachments) {
+        qWarning() << "Pass" << passName.data() << "has more color attachments than every device supports, ignoring the rest";
+    }
+
+    formats.colorCount = std::min<uint32_t>(pass->colorAttachments.size(), maxColorAttachments);
+    for (uint32_t i = 0; i < formats.colorCount; i++) {
+        const auto &use = pass->colorAttachments[i];
+        formats.color[i] = use ? m_images[pass->uses[*use].image].format : VK_FORMAT_UNDEFINED;
+    }
+
+    if (pass->depthAttachment) {
+        formats.depth = m_images[pass->uses[*pass->depthAttachment].image].format;
+    }
+
+    return formats;
+}
+
+Texture &RenderGraph::texture(const ResourceId image)
+{
+    return m_images[image].texture;
+}
+
+QString RenderGraph::toDot() const
+{
+    QString dot = QStringLiteral("digraph RenderGraph {\n");
+
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        const auto &pass = m_passes[i];
+        dot += QStringLiteral("    pass%1 [shape=box, label=\"%2\"%3];\n")
+                   .arg(i)
+                   .arg(QString::fromStdString(pass.name))
+                   .arg(pass.culled ? QStringLiteral(", style=dashed") : QString());
+    }
+
+    for (size_t i = 0; i < m_images.size(); i++) {
+        const auto &image = m_images[i];
+        const QString memory = image.memorySlot >= 0 ? QStringLiteral("memory %1").arg(image.memorySlot) : QStringLiteral("not allocated");
+        dot += QStringLiteral("    image%1 [shape=ellipse, label=\"%2\\n%3\"%4];\n")
+                   .arg(i)
+                   .arg(QString::fromStdString(image.name))
+                   .arg(memory)
+                   .arg(image.output ? QStringLiteral(", peripheries=2") : QString());
+    }
+
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        for (const auto &use : m_passes[i].uses) {
+            if (use.access == Access::Read) {
+                dot += QStringLiteral("    image%1 -> pass%2;\n").arg(use.image).arg(i);
+            } else {
+                dot += QStringLiteral("    pass%1 -> image%2%3;\n").arg(i).arg(use.image).arg(use.clear ? QStringLiteral(" [label=\"clear\"]") : QString());
+            }
+        }
+    }
+
+    dot += QStringLiteral("}\n");
+
+    return dot;
+}
+
+void RenderGraph::cullPasses()
+{
+    // walk backwards from the outputs, a pass is only kept if something later needs what it writes
+    std::vector<bool> needed(m_images.size());
+    for (size_t i = 0; i < m_images.size(); i++) {
+        needed[i] = m_images[i].output;
+    }
+
+    for (auto it = m_passes.rbegin(); it != m_passes.rend(); ++it) {
+        auto &pass = *it;
+
+        pass.culled = std::none_of(pass.uses.cbegin(), pass.uses.cend(), [&needed](const Use &use) {
+            return use.access != Access::Read && needed[use.image];
+        });
+        if (pass.culled) {
+            continue;
+        }
+
+        // after a clear, nothing written before this pass can be seen anymore
+        for (const auto &use : pass.uses) {
+            if (use.access != Access::Read && use.clear) {
+                needed[use.image] = false;
+            }
+        }
+
+        for (const auto &use : pass.uses) {
+            if (use.access == Access::Read || !use.clear) {
+                needed[use.image] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::createImages()
+{
+    for (auto &image : m_images) {
+        image.usage = 0;
+        image.firstPass = -1;
+        image.lastPass = -1;
+        image.memorySlot = -1;
+    }
+
+    // lifetimes only count the passes that are actually run
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        if (m_passes[i].culled) {
+            continue;
+        }
+
+        for (const auto &use : m_passes[i].uses) {
+            auto &image = m_images[use.image];
+            if (image.firstPass < 0) {
+                image.firstPass = i;
+            }
+            image.lastPass = i;
+
+            switch (use.access) {
+            case Access::ColorWrite:
+                image.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                break;
+            case Access::DepthWrite:
+                image.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                break;
+            case Access::Read:
+                image.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+                break;
+            }
+        }
+    }
+
+    std::vector<ResourceId> liveImages;
+    std::vector<VkMemoryRequirements> requirements(m_images.size());
+
+    for (size_t i = 0; i < m_images.size(); i++) {
+        auto &image = m_images[i];
+        if (image.firstPass < 0) {
+            continue;
+        }
+
+        // outputs stay alive until whoever uses the graph samples them
+        if (image.output) {
+            image.lastPass = m_passes.size();
+            image.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+
+        VkImageCreateInfo imageCreateInfo = {};
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.extent.width = m_extent.width;
+        imageCreateInfo.extent.height = m_extent.height;
+        imageCreateInfo.extent.depth = 1;
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.format = image.format;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageCreateInfo.usage = image.usage;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        vkCreateImage(m_device.device, &imageCreateInfo, nullptr, &image.texture.image);
+        vkGetImageMemoryRequirements(m_device.device, image.texture.image, &requirements[i]);
+
+        liveImages.push_back(i);
+    }
+
+    // biggest images first, each one goes into the first slot where none of the other images are alive at the same time
+    std::sort(liveImages.begin(), liveImages.end(), [&requirements](const ResourceId a, const ResourceId b) {
+        return requirements[a].size > requirements[b].size;
+    });
+
+    for (const ResourceId id : liveImages) {
+        auto &image = m_images[id];
+        const auto &imageRequirements = requirements[id];
+
+        const auto overlaps = [this, &image](const ResourceId other) {
+            return image.firstPass <= m_images[other].lastPass && m_images[other].firstPass <= image.lastPass;
+        };
+
+        auto slot = std::find_if(m_memorySlots.begin(), m_memorySlots.end(), [&imageRequirements, &overlaps](const MemorySlot &slot) {
+            return (slot.requirements.memoryTypeBits & imageRequirements.memoryTypeBits) != 0
+                && std::none_of(slot.images.cbegin(), slot.images.cend(), overlaps);
+        });
+
+        if (slot == m_memorySlots.end()) {
+            MemorySlot &newSlot = m_memorySlots.emplace_back();
+            newSlot.requirements = imageRequirements;
+            slot = m_memorySlots.end() - 1;
+        } else {
+            slot->requirements.size = std::max(slot->requirements.size, imageRequirements.size);
+            slot->requirements.alignment = std::max(slot->requirements.alignment, imageRequirements.alignment);
+            slot->requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+        }
+
+        slot->images.push_back(id);
+        image.memorySlot = std::distance(m_memorySlots.begin(), slot);
+    }
+
+    for (auto &slot : m_memorySlots) {
+        // in the order they're used, so the barriers know which image had the memory before
+        std::sort(slot.images.begin(), slot.images.end(), [this](const ResourceId a, const ResourceId b) {
+            return m_images[a].firstPass < m_images[b].firstPass;
+        });
+
+        slot.allocation = m_device.allocator->allocate(slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+        if (slot.allocation.memory == VK_NULL_HANDLE) {
+            qFatal("Failed to allocate memory for render graph image %s!", m_images[slot.images.front()].name.c_str());
+        }
+
+        for (const ResourceId id : slot.images) {
+            auto &image = m_images[id];
+
+            vkBindImageMemory(m_device.device, image.texture.image, slot.allocation.memory, slot.allocation.offset);
+            image.texture.allocation = slot.allocation;
+
+            VkImageViewCreateInfo viewCreateInfo = {};
+            viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewCreateInfo.image = image.texture.image;
+            viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewCreateInfo.format = image.format;
+            viewCreateInfo.subresourceRange.aspectMask = isDepthFormat(image.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            viewCreateInfo.subresourceRange.levelCount = 1;
+            viewCreateInfo.subresourceRange.layerCount = 1;
+
+            vkCreateImageView(m_device.device, &viewCreateInfo, nullptr, &image.texture.imageView);
+        }
+    }
+}
+
+void RenderGraph::createBarriers()
+{
+    // what each image was used for last, in the frame that's being recorded
+    std::vector<std::optional<Access>> lastAccess(m_images.size());
+
+    // the last access of the whole frame, which the next frame (or the next image in the same memory) has to wait for
+    const auto finalAccess = [this](const ResourceId id) {
+        if (m_images[id].output) {
+            return Access::Read;
+        }
+
+        const auto &uses = m_passes[m_images[id].lastPass].uses;
+        return std::find_if(uses.crbegin(), uses.crend(), [id](const Use &use) {
+                   return use.image == id;
+               })->access;
+    };
+
+    for (auto &pass : m_passes) {
+        pass.barriers.clear();
+        pass.srcStages = 0;
+        pass.dstStages = 0;
+
+        if (pass.culled) {
+            continue;
+        }
+
+        for (const auto &use : pass.uses) {
+            const auto &image = m_images[use.image];
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.texture.image;
+            barrier.subresourceRange.aspectMask = isDepthFormat(image.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.newLayout = layoutFor(use.access);
+            barrier.dstAccessMask = accessFlagsFor(use.access);
+
+            Access previousAccess;
+            if (lastAccess[use.image]) {
+                previousAccess = *lastAccess[use.image];
+
+                // reading something that's already readable doesn't need a barrier
+                if (previousAccess == Access::Read && use.access == Access::Read) {
+                    continue;
+                }
+
+                barrier.oldLayout = layoutFor(previousAccess);
+            } else {
+                // the first use this frame, so the old contents are thrown away
+                // the memory was last used by the image before this one in the same slot, or by this image in the previous frame
+                if (use.access == Access::Read || !use.clear) {
+                    qWarning() << "Render graph image" << image.name << "is used before anything writes to it";
+                }
+
+                const auto &slotImages = m_memorySlots[image.memorySlot].images;
+                const auto position = std::find(slotImages.cbegin(), slotImages.cend(), use.image);
+                const ResourceId previous = position == slotImages.cbegin() ? slotImages.back() : *(position - 1);
+
+                previousAccess = finalAccess(previous);
+                barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+
+            // reads only need to finish before we write, so there's nothing to make available
+            barrier.srcAccessMask = previousAccess == Access::Read ? 0 : accessFlagsFor(previousAccess);
+
+            pass.srcStages |= stagesFor(previousAccess);
+            pass.dstStages |= stagesFor(use.access);
+            pass.barriers.push_back(barrier);
+
+            lastAccess[use.image] = use.access;
+        }
+    }
+
+    m_finalBarriers.clear();
+    m_finalSrcStages = 0;
+
+    for (size_t i = 0; i < m_images.size(); i++) {
+        const auto &image = m_images[i];
+        if (!image.output || !lastAccess[i] || *lastAccess[i] == Access::Read) {
+            continue;
+        }
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image.texture.image;
+        barrier.subresourceRange.aspectMask = isDepthFormat(image.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.oldLayout = layoutFor(*lastAccess[i]);
+        barrier.newLayout = layoutFor(Access::Read);
+        barrier.srcAccessMask = accessFlagsFor(*lastAccess[i]);
+        barrier.dstAccessMask = accessFlagsFor(Access::Read);
+
+        m_finalSrcStages |= stagesFor(*lastAccess[i]);
+        m_finalBarriers.push_back(barrier);
+    }
+}
+
+void RenderGraph::destroyImages()
+{
+    const bool hasImages = std::any_of(m_images.cbegin(), m_images.cend(), [](const Image &image) {
+        return image.texture.image != VK_NULL_HANDLE;
+    });
+    if (!hasImages) {
+        return;
+    }
+
+    // the previous frames may still be using them
+    vkDeviceWaitIdle(m_device.device);
+
+    for (auto &image : m_images) {
+        vkDestroyImageView(m_device.device, image.texture.imageView, nullptr);
+        vkDestroyImage(m_device.device, image.texture.image, nullptr);
+        image.texture = {};
+    }
+
+    for (const auto &slot : m_memorySlots) {
+        m_device.allocator->free(slot.allocation);
+    }
+    m_memorySlots.clear();
+}
+
+VkImageLayout RenderGraph::layoutFor(const Access access)
+{
+    switch (access) {
+    case Access::ColorWrite:
+        return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    case Access::DepthWrite:
+        return VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+    case Access::Read:
+        return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    return VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+VkPipelineStageFlags RenderGraph::stagesFor(const Access access)
+{
+    switch (access) {
+    case Access::ColorWrite:
+        return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    case Access::DepthWrite:
+        return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    case Access::Read:
+        return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
+
+    return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+}
+
+VkAccessFlags RenderGraph::accessFlagsFor(const Access access)
+{
+    switch (access) {
+    case Access::ColorWrite:
+        return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    case Access::DepthWrite:
+        return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    case Access::Read:
+        return VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    return 0;
+}
+
+bool RenderGraph::isDepthFormat(const VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -4,19 +4,33 @@
 #include "rendermanager.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <fstream>
 #include <glm/gtc/matrix_transform.hpp>
+#include <optional>
 #include <valarray>
 #include <vector>
 #include <vulkan/vulkan.h>
 
+#include "framescheduler.h"
 #include "gamerenderer.h"
 #include "imgui.h"
 #include "imguipass.h"
+#include "memoryallocator.h"
+#include "pipelinecache.h"
+#include "profiler.h"
+#include "samplercache.h"
 #include "simplerenderer.h"
+#include "stagingring.h"
 #include "swapchain.h"
+#include "texturecache.h"
+#include "textureuploader.h"
+#include "trace.h"
+#include "uniformring.h"
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
                                       const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
@@ -129,10 +143,14 @@ RenderManager::RenderManager(GameData *data)
 
     // we want to choose the portability subset on platforms that
     // support it, this is a requirement of the portability spec
-    std::vector<const char *> deviceExtensions = {"VK_KHR_swapchain"};
+    std::vector<const char *> deviceExtensions;
     for (auto extension : extensionProperties) {
         if (!strcmp(extension.extensionName, "VK_KHR_portability_subset"))
             deviceExtensions.push_back("VK_KHR_portability_subset");
+
+        // headless drivers may not have it, which is fine as long as only initOffscreen() is used
+        if (!strcmp(extension.extensionName, "VK_KHR_swapchain"))
+            deviceExtensions.push_back("VK_KHR_swapchain");
     }
 
     uint32_t graphicsFamilyIndex = 0, presentFamilyIndex = 0;
@@ -153,6 +171,19 @@ RenderManager::RenderManager(GameData *data)
         i++;
     }
 
+    // prefer a dedicated transfer family for texture uploads, these usually map to the copy engine
+    uint32_t transferFamilyIndex = graphicsFamilyIndex;
+    i = 0;
+    for (const auto &queueFamily : queueFamilies) {
+        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT
+            && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            transferFamilyIndex = i;
+            break;
+        }
+
+        i++;
+    }
+
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
     if (graphicsFamilyIndex == presentFamilyIndex) {
@@ -193,15 +224,41 @@ RenderManager::RenderManager(GameData *data)
         }
     }
 
+    const float transferQueuePriority = 1.0f;
+    if (transferFamilyIndex != graphicsFamilyIndex) {
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = transferFamilyIndex;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &transferQueuePriority;
+
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    VkPhysicalDeviceVulkan12Features supported12Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+
+    VkPhysicalDeviceFeatures2 supportedFeatures2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    supportedFeatures2.pNext = &supported12Features;
+    vkGetPhysicalDeviceFeatures2(m_device->physicalDevice, &supportedFeatures2);
+
+    const VkPhysicalDeviceFeatures &supportedFeatures = supportedFeatures2.features;
+
     VkPhysicalDeviceFeatures enabledFeatures{};
     enabledFeatures.shaderClipDistance = VK_TRUE;
     enabledFeatures.shaderCullDistance = VK_TRUE;
+    enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
+    m_device->textureCompressionBC = supportedFeatures.textureCompressionBC;
+    m_device->drawIndirectCount = supportedFeatures.multiDrawIndirect && supported12Features.drawIndirectCount;
 
     VkPhysicalDeviceVulkan11Features enabled11Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
     enabled11Features.shaderDrawParameters = VK_TRUE;
 
     VkPhysicalDeviceVulkan12Features enabled12Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
     enabled12Features.vulkanMemoryModel = VK_TRUE;
+    enabled12Features.timelineSemaphore = VK_TRUE;
+    enabled12Features.drawIndirectCount = supported12Features.drawIndirectCount;
     enabled12Features.pNext = &enabled11Features;
 
     VkPhysicalDeviceVulkan13Features enabled13Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
@@ -223,6 +280,20 @@ RenderManager::RenderManager(GameData *data)
     // get queues
     vkGetDeviceQueue(m_device->device, graphicsFamilyIndex, 0, &m_device->graphicsQueue);
     vkGetDeviceQueue(m_device->device, presentFamilyIndex, 0, &m_device->presentQueue);
+    vkGetDeviceQueue(m_device->device, transferFamilyIndex, 0, &m_device->transferQueue);
+
+    m_device->graphicsFamilyIndex = graphicsFamilyIndex;
+    m_device->transferFamilyIndex = transferFamilyIndex;
+
+    m_device->allocator = new MemoryAllocator(*m_device);
+    m_device->stagingRing = new StagingRing(*m_device, 32 * 1024 * 1024);
+    m_device->textureUploader = new TextureUploader(*m_device);
+    m_device->samplerCache = new SamplerCache(*m_device);
+    m_device->pipelineCache = new PipelineCache(*m_device);
+    m_device->profiler = new Profiler(*m_device);
+    m_device->frameScheduler = new FrameScheduler(*m_device);
+
+    m_textureCache = new TextureCache(*this);
 
     // command pool
     VkCommandPoolCreateInfo poolInfo = {};
@@ -240,19 +311,86 @@ RenderManager::RenderManager(GameData *data)
     poolSize2.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSize2.descriptorCount = 150;
 
-    const std::array poolSizes = {poolSize, poolSize2};
+    // per-frame data is bound from a UniformRing with dynamic offsets
+    VkDescriptorPoolSize dynamicStoragePoolSize = {};
+    dynamicStoragePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    dynamicStoragePoolSize.descriptorCount = 150;
+
+    VkDescriptorPoolSize dynamicUniformPoolSize = {};
+    dynamicUniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    dynamicUniformPoolSize.descriptorCount = 300;
+
+    // the game renderer uses separate images, samplers and plain uniform buffers
+    VkDescriptorPoolSize uniformPoolSize = {};
+    uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uniformPoolSize.descriptorCount = 300;
+
+    VkDescriptorPoolSize sampledImagePoolSize = {};
+    sampledImagePoolSize.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    sampledImagePoolSize.descriptorCount = 300;
+
+    VkDescriptorPoolSize samplerPoolSize = {};
+    samplerPoolSize.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    samplerPoolSize.descriptorCount = 150;
+
+    const std::array poolSizes =
+        {poolSize, poolSize2, dynamicStoragePoolSize, dynamicUniformPoolSize, uniformPoolSize, sampledImagePoolSize, samplerPoolSize};
 
     VkDescriptorPoolCreateInfo poolCreateInfo = {};
     poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolCreateInfo.poolSizeCount = poolSizes.size();
     poolCreateInfo.pPoolSizes = poolSizes.data();
     poolCreateInfo.maxSets = 150;
+    // renderers free their sets when they're replaced on resize
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
     vkCreateDescriptorPool(m_device->device, &poolCreateInfo, nullptr, &m_device->descriptorPool);
 
+    // periodically logs the frame time histogram, to compare hitches between changes
+    m_logFrameTimes = qgetenv("NOVUS_FRAME_HISTOGRAM") == QByteArrayLiteral("1");
+
     qInfo() << "Initialized renderer!";
 }
 
+RenderManager::~RenderManager()
+{
+    vkDeviceWaitIdle(m_device->device);
+    m_device->frameScheduler->waitIdle();
+
+    delete m_renderer;
+    m_renderer = nullptr;
+    delete m_imGuiPass;
+    delete m_textureCache;
+
+    destroyBlitPipeline();
+    for (const auto framebuffer : m_framebuffers) {
+        vkDestroyFramebuffer(m_device->device, framebuffer, nullptr);
+    }
+    vkDestroyRenderPass(m_device->device, m_renderPass, nullptr);
+
+    for (auto &[model, uploaded] : m_uploadedModels) {
+        m_device->destroyBuffer(uploaded.drawObject.vertexBuffer);
+        m_device->destroyBuffer(uploaded.drawObject.indexBuffer);
+    }
+    m_uploadedModels.clear();
+
+    if (m_readbackBuffer.buffer != VK_NULL_HANDLE) {
+        m_device->destroyBuffer(m_readbackBuffer);
+    }
+
+    delete m_device->frameScheduler;
+    delete m_device->profiler;
+    delete m_device->pipelineCache;
+    delete m_device->samplerCache;
+    delete m_device->textureUploader;
+    delete m_device->stagingRing;
+    m_device->stagingRing = nullptr;
+
+    // everything sub-allocated from it was returned above, so its blocks can be freed
+    delete m_device->allocator;
+    m_device->allocator = nullptr;
+}
+
 bool RenderManager::initSwapchain(VkSurfaceKHR surface, int width, int height)
 {
     if (m_device->swapChain == nullptr) {
@@ -261,15 +399,54 @@ bool RenderManager::initSwapchain(VkSurfaceKHR surface, int width, int height)
         m_device->swapChain->resize(surface, width, height);
     }
 
-    // allocate command buffers
-    for (int i = 0; i < 3; i++) {
-        VkCommandBufferAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = m_device->commandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+    // a zero sized window doesn't get a swapchain, so try again once it has a size
+    if (m_device->swapChain->swapchain == VK_NULL_HANDLE) {
+        qWarning() << "Couldn't create a swapchain for a" << width << "x" << height << "surface";
+        return false;
+    }
+
+    return initFrameResources();
+}
+
+bool RenderManager::initOffscreen(const int width, const int height)
+{
+    if (m_device->swapChain != nullptr) {
+        qWarning() << "The renderer already has a swapchain, it can't be switched to offscreen rendering";
+        return false;
+    }
+
+    m_device->swapChain = new SwapChain(*m_device, width, height);
+
+    m_readbackBuffer = m_device->createBuffer(width * height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    return initFrameResources();
+}
+
+bool RenderManager::initFrameResources()
+{
+    const bool offscreen = m_device->swapChain->isOffscreen();
+
+    // what draws into the swapchain is created again for the new one, and frames in flight may still use the old resources
+    // the renderer is kept, along with its compiled pipelines and descriptor sets, and only resized
+    if (m_renderer != nullptr) {
+        m_device->frameScheduler->waitIdle();
 
-        vkAllocateCommandBuffers(m_device->device, &allocInfo, &m_commandBuffers[i]);
+        delete m_imGuiPass;
+        m_imGuiPass = nullptr;
+
+        destroyBlitPipeline();
+
+        for (const auto framebuffer : m_framebuffers) {
+            vkDestroyFramebuffer(m_device->device, framebuffer, nullptr);
+        }
+        m_framebuffers.clear();
+
+        vkDestroyRenderPass(m_device->device, m_renderPass, nullptr);
+        m_renderPass = VK_NULL_HANDLE;
+    }
+
+    if (!offscreen) {
+        m_device->frameScheduler->setSwapchainImageCount(static_cast<uint32_t>(m_device->swapChain->swapchainImages.size()));
     }
 
     VkAttachmentDescription colorAttachment = {};
@@ -280,7 +457,7 @@ bool RenderManager::initSwapchain(VkSurfaceKHR surface, int width, int height)
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment = 0;
@@ -313,13 +490,18 @@ bool RenderManager::initSwapchain(VkSurfaceKHR surface, int width, int height)
 
     vkCreateRenderPass(m_device->device, &renderPassInfo, nullptr, &m_renderPass);
 
-    ImGui::SetCurrentContext(ctx);
-    m_imGuiPass = new ImGuiPass(*this);
+    // nothing draws an ImGui frame without a window
+    if (!offscreen) {
+        ImGui::SetCurrentContext(ctx);
+        m_imGuiPass = new ImGuiPass(*this);
+    }
 
-    if (qgetenv("NOVUS_USE_NEW_RENDERER") == QByteArrayLiteral("1")) {
-        m_renderer = new GameRenderer(*m_device, m_data);
-    } else {
-        m_renderer = new SimpleRenderer(*m_device);
+    if (m_renderer == nullptr) {
+        if (qgetenv("NOVUS_USE_NEW_RENDERER") == QByteArrayLiteral("1")) {
+            m_renderer = new GameRenderer(*m_device, m_data);
+        } else {
+            m_renderer = new SimpleRenderer(*m_device);
+        }
     }
 
     m_renderer->resize();
@@ -358,35 +540,59 @@ void RenderManager::destroySwapchain()
 
 void RenderManager::render(const std::vector<DrawObject> &models)
 {
-    vkWaitForFences(m_device->device,
-                    1,
-                    &m_device->swapChain->inFlightFences[m_device->swapChain->currentFrame],
-                    VK_TRUE,
-                    std::numeric_limits<uint64_t>::max());
+    Profiler &profiler = *m_device->profiler;
+    FrameScheduler &scheduler = *m_device->frameScheduler;
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    {
+        Profiler::CpuScope scope(profiler, "Wait for GPU");
+        commandBuffer = scheduler.beginFrame();
+    }
+
+    // waiting on the GPU isn't counted, only the time spent recording and submitting
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    const uint32_t frameIndex = scheduler.frameIndex();
+
+    // the GPU is done with this frame, so its staging data can be reused
+    m_device->stagingRing->retireFrame(frameIndex);
+
+    const bool offscreen = m_device->swapChain->isOffscreen();
 
     uint32_t imageIndex = 0;
-    VkResult result = vkAcquireNextImageKHR(m_device->device,
-                                            m_device->swapChain->swapchain,
-                                            std::numeric_limits<uint64_t>::max(),
-                                            m_device->swapChain->imageAvailableSemaphores[m_device->swapChain->currentFrame],
-                                            VK_NULL_HANDLE,
-                                            &imageIndex);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        return;
+    if (!offscreen) {
+        VkResult result = vkAcquireNextImageKHR(m_device->device,
+                                                m_device->swapChain->swapchain,
+                                                std::numeric_limits<uint64_t>::max(),
+                                                scheduler.imageAvailableSemaphore(),
+                                                VK_NULL_HANDLE,
+                                                &imageIndex);
+
+        // the frame wasn't submitted, so the next call records it again
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            return;
+        }
     }
 
-    VkCommandBuffer commandBuffer = m_commandBuffers[m_device->swapChain->currentFrame];
+    profiler.beginFrame(commandBuffer, frameIndex);
 
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    {
+        Profiler::CpuScope scope(profiler, "Uploads");
+        Profiler::GpuScope gpuScope(profiler, commandBuffer, "Uploads");
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        m_device->stagingRing->flush(commandBuffer, frameIndex);
+        m_device->textureUploader->submit();
+    }
 
     updateCamera(camera);
 
-    m_renderer->render(commandBuffer, m_device->swapChain->currentFrame, camera, models);
+    {
+        Profiler::CpuScope scope(profiler, "Renderer");
+        Profiler::GpuScope gpuScope(profiler, commandBuffer, "Renderer");
+
+        m_renderer->render(commandBuffer, frameIndex, camera, models);
+    }
 
     VkRenderPassBeginInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -406,54 +612,156 @@ void RenderManager::render(const std::vector<DrawObject> &models)
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+    {
+        Profiler::GpuScope scope(profiler, commandBuffer, "Blit");
 
-    vkCmdDraw(commandBuffer, 4, 1, 0, 0);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+
+        vkCmdDraw(commandBuffer, 4, 1, 0, 0);
+
+        profiler.count(Profiler::PipelineBinds);
+        profiler.count(Profiler::DescriptorBinds);
+        profiler.count(Profiler::DrawCalls);
+        profiler.count(Profiler::Triangles, 2);
+    }
 
     // Render offscreen texture, and overlay imgui
     if (m_imGuiPass != nullptr) {
+        Profiler::CpuScope scope(profiler, "ImGui");
+        Profiler::GpuScope gpuScope(profiler, commandBuffer, "ImGui");
+
         ImGui::SetCurrentContext(ctx);
         m_imGuiPass->render(commandBuffer);
     }
 
     vkCmdEndRenderPass(commandBuffer);
+
+    // the render pass left the image in TRANSFER_SRC_OPTIMAL, renderOffscreen() reads it once the frame is finished
+    if (offscreen) {
+        VkBufferImageCopy region = {};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {m_device->swapChain->extent.width, m_device->swapChain->extent.height, 1};
+
+        vkCmdCopyImageToBuffer(commandBuffer,
+                               m_device->swapChain->offscreenImage.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               m_readbackBuffer.buffer,
+                               1,
+                               &region);
+
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
     vkEndCommandBuffer(commandBuffer);
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {m_device->swapChain->imageAvailableSemaphores[m_device->swapChain->currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    // any texture the renderer considered ready is covered by this value, and waiting on it makes the upload visible to this queue
+    const uint64_t textureUploadValue = m_device->textureUploader->completedValue();
+
+    VkSemaphore waitSemaphores[] = {scheduler.imageAvailableSemaphore(), m_device->textureUploader->semaphore()};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT};
+    const uint64_t waitValues[] = {0, textureUploadValue};
+
+    // an offscreen image was never acquired, so only the texture uploads are waited on
+    const uint32_t firstWait = offscreen ? 1 : 0;
+
+    // the timeline tells the scheduler when the frame is finished, the binary semaphore is only there for presenting
+    VkSemaphore signalSemaphores[] = {scheduler.timelineSemaphore(), offscreen ? VK_NULL_HANDLE : scheduler.renderFinishedSemaphore(imageIndex)};
+    const uint64_t signalValues[] = {scheduler.frameValue(), 0};
+    const uint32_t signalCount = offscreen ? 1 : 2;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 2 - firstWait;
+    timelineInfo.pWaitSemaphoreValues = waitValues + firstWait;
+    timelineInfo.signalSemaphoreValueCount = signalCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 2 - firstWait;
+    submitInfo.pWaitSemaphores = waitSemaphores + firstWait;
+    submitInfo.pWaitDstStageMask = waitStages + firstWait;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
-
-    VkSemaphore signalSemaphores[] = {m_device->swapChain->renderFinishedSemaphores[m_device->swapChain->currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = signalCount;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkResetFences(m_device->device, 1, &m_device->swapChain->inFlightFences[m_device->swapChain->currentFrame]);
+    {
+        Profiler::CpuScope scope(profiler, "Submit");
 
-    if (vkQueueSubmit(m_device->graphicsQueue, 1, &submitInfo, m_device->swapChain->inFlightFences[m_device->swapChain->currentFrame]) != VK_SUCCESS)
-        return;
+        QMutexLocker queueLocker(&m_device->queueMutex);
+
+        if (vkQueueSubmit(m_device->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            return;
+
+        scheduler.endFrame();
+
+        // present
+        if (!offscreen) {
+            VkPresentInfoKHR presentInfo = {};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = &signalSemaphores[1];
+            VkSwapchainKHR swapChains[] = {m_device->swapChain->swapchain};
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = swapChains;
+            presentInfo.pImageIndices = &imageIndex;
+
+            vkQueuePresentKHR(m_device->presentQueue, &presentInfo);
+        }
+    }
+
+    profiler.endFrame();
+
+    m_frameTimes.record(frameTimer.nsecsElapsed() / 1000000.0);
+
+    if (m_logFrameTimes) {
+        if (!m_frameTimeLogTimer.isValid()) {
+            m_frameTimeLogTimer.start();
+        } else if (m_frameTimeLogTimer.hasExpired(10000)) {
+            qInfo() << "Frame times:" << m_frameTimes.summary();
+            m_frameTimeLogTimer.restart();
+        }
+    }
+}
+
+QByteArray RenderManager::renderOffscreen(const std::vector<DrawObject> &models)
+{
+    if (m_device->swapChain == nullptr || !m_device->swapChain->isOffscreen()) {
+        qWarning() << "renderOffscreen() needs initOffscreen() to be called first";
+        return {};
+    }
 
-    // present
-    VkPresentInfoKHR presentInfo = {};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    // textures and pipelines are prepared in the background, and a single image can't be fixed up by a later frame
+    // so frames are drawn until there's nothing left to wait on, and only the last one is kept
+    constexpr int maximumFrames = 100;
 
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-    VkSwapchainKHR swapChains[] = {m_device->swapChain->swapchain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
+    int frames = 0;
+    do {
+        render(models);
+        m_device->frameScheduler->waitIdle();
+    } while (hasPendingWork() && ++frames < maximumFrames);
 
-    vkQueuePresentKHR(m_device->presentQueue, &presentInfo);
+    if (frames == maximumFrames) {
+        qWarning() << "Gave up waiting on textures and pipelines after" << maximumFrames << "frames, the image may be missing some of them";
+    }
 
-    m_device->swapChain->currentFrame = (m_device->swapChain->currentFrame + 1) % 3;
+    return {static_cast<const char *>(m_readbackBuffer.allocation.mapped), static_cast<qsizetype>(m_readbackBuffer.size)};
+}
+
+const FrameTimeHistogram &RenderManager::frameTimes() const
+{
+    return m_frameTimes;
 }
 
 VkRenderPass RenderManager::presentationRenderPass() const
@@ -461,50 +769,338 @@ VkRenderPass RenderManager::presentationRenderPass() const
     return m_renderPass;
 }
 
+static int validLod(const physis_MDL &model, const int lod)
+{
+    if (lod != DrawObject::automaticLod && (lod < 0 || lod >= model.num_lod)) {
+        qWarning() << "Model doesn't have LOD" << lod << ", picking one automatically instead";
+        return DrawObject::automaticLod;
+    }
+
+    return lod;
+}
+
+static uint64_t nextDrawObjectId()
+{
+    static std::atomic<uint64_t> id = 1;
+    return id++;
+}
+
+static uint64_t nextTextureId()
+{
+    static std::atomic<uint64_t> id = 1;
+    return id++;
+}
+
 DrawObject RenderManager::addDrawObject(const physis_MDL &model, int lod)
 {
     DrawObject DrawObject;
-    DrawObject.model = model;
 
-    reloadDrawObject(DrawObject, lod);
+    // placing the same model again shares the buffers it was already uploaded to, so the renderers can instance it
+    if (const auto uploaded = m_uploadedModels.find(model.p_ptr); uploaded != m_uploadedModels.end()) {
+        shareUploadedModel(uploaded->second.drawObject, DrawObject);
+        DrawObject.lod = validLod(model, lod);
+    } else {
+        DrawObject.model = model;
+        reloadDrawObject(DrawObject, lod);
+    }
+
+    m_uploadedModels[model.p_ptr].refCount++;
+
+    // the rest pose, until the bones are filled in from a skeleton
+    DrawObject.boneData.assign(std::min<size_t>(model.num_affected_bones, DrawObject::maxBones), toBoneMatrix(glm::mat4(1.0f)));
+    DrawObject.boneDataVersion = UniformRing::nextVersion();
+
+    DrawObject.id = nextDrawObjectId();
 
     return DrawObject;
 }
 
-void RenderManager::reloadDrawObject(DrawObject &DrawObject, uint32_t lod)
+void RenderManager::refreshDrawObject(DrawObject &model)
 {
-    if (lod > DrawObject.model.num_lod)
+    if (const auto uploaded = m_uploadedModels.find(model.model.p_ptr); uploaded != m_uploadedModels.end()) {
+        shareUploadedModel(uploaded->second.drawObject, model);
+        model.lod = validLod(model.model, model.lod);
+    }
+}
+
+void RenderManager::releaseDrawObject(const physis_MDL &model)
+{
+    const auto uploaded = m_uploadedModels.find(model.p_ptr);
+    if (uploaded == m_uploadedModels.end()) {
         return;
+    }
 
-    DrawObject.parts.clear();
+    // other placements are still drawing from the buffers
+    if (--uploaded->second.refCount > 0) {
+        return;
+    }
 
-    for (uint32_t i = 0; i < DrawObject.model.lods[lod].num_parts; i++) {
-        RenderPart renderPart;
+    retireBuffers(uploaded->second.drawObject);
 
-        const physis_Part part = DrawObject.model.lods[lod].parts[i];
+    m_uploadedModels.erase(uploaded);
+}
 
-        renderPart.materialIndex = part.material_index;
+void RenderManager::retireBuffers(const DrawObject &model)
+{
+    // nothing is going to read them, and queued copies would otherwise be recorded after they're gone
+    m_device->stagingRing->cancel(model.vertexBuffer.buffer);
+    m_device->stagingRing->cancel(model.indexBuffer.buffer);
+
+    // frames in flight may still be drawing from them
+    m_device->frameScheduler->retire([device = m_device, vertexBuffer = model.vertexBuffer, indexBuffer = model.indexBuffer]() mutable {
+        device->destroyBuffer(vertexBuffer);
+        device->destroyBuffer(indexBuffer);
+    });
+}
 
-        size_t vertexSize = part.num_vertices * sizeof(Vertex);
-        renderPart.vertexBuffer = m_device->createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-        m_device->copyToBuffer(renderPart.vertexBuffer, (void *)part.vertices, vertexSize);
+void RenderManager::shareUploadedModel(const DrawObject &uploaded, DrawObject &model)
+{
+    model.model = uploaded.model;
+    model.lods = uploaded.lods;
+    model.vertexBuffer = uploaded.vertexBuffer;
+    model.indexBuffer = uploaded.indexBuffer;
+    model.boundingBox = uploaded.boundingBox;
+    model.boundingSphere = uploaded.boundingSphere;
+}
 
-        size_t indexSize = part.num_indices * sizeof(uint16_t);
-        renderPart.indexBuffer = m_device->createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-        m_device->copyToBuffer(renderPart.indexBuffer, (void *)part.indices, indexSize);
+void RenderManager::reloadDrawObject(DrawObject &DrawObject, const int lod)
+{
+    NOVUS_TRACE_SCOPE("RenderManager::reloadDrawObject");
+
+    DrawObject.lod = validLod(DrawObject.model, lod);
+    DrawObject.lods.clear();
+    DrawObject.lods.resize(std::max<uint32_t>(DrawObject.model.num_lod, 1));
+
+    // all parts of every LOD are packed into one vertex and index buffer, and drawn with offsets into them
+    size_t totalVertices = 0, totalIndices = 0;
+    for (uint32_t i = 0; i < DrawObject.model.num_lod; i++) {
+        const physis_LOD &modelLod = DrawObject.model.lods[i];
+        for (uint32_t j = 0; j < modelLod.num_parts; j++) {
+            totalVertices += modelLod.parts[j].num_vertices;
+            totalIndices += modelLod.parts[j].num_indices;
+        }
+    }
+
+    // the previous buffers are retired below, and must not be written to
+    DrawObject.vertexBuffer = {};
+    DrawObject.indexBuffer = {};
+
+    if (totalVertices > 0 && totalIndices > 0) {
+        // also read as a storage buffer when skinning in a compute shader
+        DrawObject.vertexBuffer = m_device->createBuffer(totalVertices * sizeof(Vertex),
+                                                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        DrawObject.indexBuffer = m_device->createBuffer(totalIndices * sizeof(uint16_t),
+                                                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    bool firstPart = true;
+    uint32_t vertexOffset = 0, firstIndex = 0;
+    for (uint32_t i = 0; i < DrawObject.model.num_lod; i++) {
+        const physis_LOD &modelLod = DrawObject.model.lods[i];
+        DrawObject.lods[i].firstVertex = vertexOffset;
+
+        for (uint32_t j = 0; j < modelLod.num_parts; j++) {
+            RenderPart renderPart;
+
+            const physis_Part part = modelLod.parts[j];
+
+            renderPart.materialIndex = part.material_index;
+
+            size_t vertexSize = part.num_vertices * sizeof(Vertex);
+            m_device->stagingRing->uploadToBuffer(DrawObject.vertexBuffer, part.vertices, vertexSize, vertexOffset * sizeof(Vertex));
+
+            size_t indexSize = part.num_indices * sizeof(uint16_t);
+            m_device->stagingRing->uploadToBuffer(DrawObject.indexBuffer, part.indices, indexSize, firstIndex * sizeof(uint16_t));
 
-        renderPart.numIndices = part.num_indices;
+            renderPart.numIndices = part.num_indices;
+            renderPart.firstIndex = firstIndex;
+            renderPart.vertexOffset = static_cast<int32_t>(vertexOffset);
 
-        DrawObject.parts.push_back(renderPart);
+            renderPart.boundingBox = BoundingBox::fromVertices(part.vertices, part.num_vertices);
+            renderPart.boundingSphere = BoundingSphere::fromVertices(renderPart.boundingBox, part.vertices, part.num_vertices);
+
+            if (firstPart) {
+                DrawObject.boundingBox = renderPart.boundingBox;
+                firstPart = false;
+            } else {
+                DrawObject.boundingBox = DrawObject.boundingBox.merged(renderPart.boundingBox);
+            }
+
+            vertexOffset += part.num_vertices;
+            firstIndex += part.num_indices;
+
+            DrawObject.lods[i].vertexCount += part.num_vertices;
+            DrawObject.lods[i].parts.push_back(renderPart);
+        }
     }
 
-    const size_t bufferSize = sizeof(glm::mat4) * 128;
-    DrawObject.boneInfoBuffer = m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    // the sphere around the whole model still has to look at every vertex, the part spheres can't just be merged
+    float radius = 0.0f;
+    DrawObject.boundingSphere.center = (DrawObject.boundingBox.min + DrawObject.boundingBox.max) * 0.5f;
+    for (uint32_t i = 0; i < DrawObject.model.num_lod; i++) {
+        const physis_LOD &modelLod = DrawObject.model.lods[i];
+        for (uint32_t j = 0; j < modelLod.num_parts; j++) {
+            const physis_Part &part = modelLod.parts[j];
+            radius = std::max(radius, BoundingSphere::fromVertices(DrawObject.boundingBox, part.vertices, part.num_vertices).radius);
+        }
+    }
+    DrawObject.boundingSphere.radius = radius;
+
+    DrawObject.boneDataVersion = UniformRing::nextVersion();
+
+    // the placements sharing the previous upload are pointed at this one with refreshDrawObject()
+    UploadedModel &uploaded = m_uploadedModels[DrawObject.model.p_ptr];
+    if (uploaded.drawObject.vertexBuffer.buffer != VK_NULL_HANDLE || uploaded.drawObject.indexBuffer.buffer != VK_NULL_HANDLE) {
+        retireBuffers(uploaded.drawObject);
+    }
+    uploaded.drawObject = DrawObject;
 }
 
 RenderTexture RenderManager::addTexture(const uint32_t width, const uint32_t height, const uint8_t *data, const uint32_t data_size)
+{
+    NOVUS_TRACE_SCOPE("RenderManager::addTexture");
+
+    RenderTexture newTexture = createTexture(width, height, 1, VK_FORMAT_R8G8B8A8_UNORM);
+    if (newTexture.handle == VK_NULL_HANDLE) {
+        return newTexture;
+    }
+
+    // the copy happens later on the transfer queue, until then renderers bind a placeholder
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {(uint32_t)width, (uint32_t)height, 1};
+
+    newTexture.uploadValue = m_device->textureUploader->queueUpload(newTexture.handle, 1, {region}, data, data_size);
+
+    return newTexture;
+}
+
+// The header at the start of every .tex file
+struct TexHeader {
+    uint32_t attribute;
+    uint32_t format;
+    uint16_t width;
+    uint16_t height;
+    uint16_t depth;
+    uint8_t mipLevels;
+    uint8_t arraySize;
+    uint32_t lodOffsets[3];
+    uint32_t offsetToSurface[13];
+};
+static_assert(sizeof(TexHeader) == 80);
+
+// Non-2D texture types, which we don't upload natively yet
+const uint32_t texAttributeCube = 0x4000;
+const uint32_t texAttribute3D = 0x1000000;
+const uint32_t texAttribute2DArray = 0x10000000;
+
+struct TexFormatInfo {
+    VkFormat format;
+    uint32_t blockSize; // in pixels, 4 for block compressed formats
+    uint32_t bytesPerBlock;
+};
+
+static std::optional<TexFormatInfo> texFormatInfo(const uint32_t format)
+{
+    switch (format) {
+    case 0x1450: // B8G8R8A8
+    case 0x1451: // B8G8R8X8
+        return TexFormatInfo{VK_FORMAT_B8G8R8A8_UNORM, 1, 4};
+    case 0x3420: // BC1
+        return TexFormatInfo{VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 8};
+    case 0x3430: // BC2
+        return TexFormatInfo{VK_FORMAT_BC2_UNORM_BLOCK, 4, 16};
+    case 0x3431: // BC3
+        return TexFormatInfo{VK_FORMAT_BC3_UNORM_BLOCK, 4, 16};
+    case 0x6120: // BC4
+        return TexFormatInfo{VK_FORMAT_BC4_UNORM_BLOCK, 4, 8};
+    case 0x6230: // BC5
+        return TexFormatInfo{VK_FORMAT_BC5_UNORM_BLOCK, 4, 16};
+    case 0x6432: // BC7
+        return TexFormatInfo{VK_FORMAT_BC7_UNORM_BLOCK, 4, 16};
+    default:
+        return std::nullopt;
+    }
+}
+
+RenderTexture RenderManager::addGameTexture(const physis_Buffer &file)
+{
+    NOVUS_TRACE_SCOPE("RenderManager::addGameTexture");
+
+    const auto decodeFallback = [this, &file]() -> RenderTexture {
+        auto texture = physis_texture_parse(file);
+        if (texture.rgba == nullptr) {
+            return {};
+        }
+
+        return addTexture(texture.width, texture.height, texture.rgba, texture.rgba_size);
+    };
+
+    if (file.data == nullptr || file.size < sizeof(TexHeader)) {
+        return {};
+    }
+
+    TexHeader header;
+    memcpy(&header, file.data, sizeof(TexHeader));
+
+    const auto formatInfo = texFormatInfo(header.format);
+    if (!formatInfo || !canSampleFormat(formatInfo->format) || header.depth > 1 || header.width == 0 || header.height == 0
+        || (header.attribute & (texAttributeCube | texAttribute3D | texAttribute2DArray))) {
+        return decodeFallback();
+    }
+
+    const uint32_t maxMipLevels = std::clamp<uint32_t>(header.mipLevels, 1, 13);
+
+    std::vector<VkBufferImageCopy> regions;
+    for (uint32_t i = 0; i < maxMipLevels; i++) {
+        const uint32_t mipWidth = std::max(header.width >> i, 1);
+        const uint32_t mipHeight = std::max(header.height >> i, 1);
+
+        const uint32_t blocksWide = (mipWidth + formatInfo->blockSize - 1) / formatInfo->blockSize;
+        const uint32_t blocksHigh = (mipHeight + formatInfo->blockSize - 1) / formatInfo->blockSize;
+        const uint64_t mipSize = static_cast<uint64_t>(blocksWide) * blocksHigh * formatInfo->bytesPerBlock;
+
+        // some files are missing their smaller mips, use as many as we can
+        const uint32_t offset = header.offsetToSurface[i];
+        if (offset < sizeof(TexHeader) || offset + mipSize > file.size || offset % formatInfo->bytesPerBlock != 0) {
+            break;
+        }
+
+        VkBufferImageCopy &region = regions.emplace_back();
+        region.bufferOffset = offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {mipWidth, mipHeight, 1};
+    }
+
+    if (regions.empty()) {
+        return decodeFallback();
+    }
+
+    const uint32_t mipLevels = regions.size();
+
+    RenderTexture newTexture = createTexture(header.width, header.height, mipLevels, formatInfo->format);
+    if (newTexture.handle == VK_NULL_HANDLE) {
+        return newTexture;
+    }
+
+    // the header is uploaded too, but it's much simpler than repacking the surfaces
+    newTexture.uploadValue = m_device->textureUploader->queueUpload(newTexture.handle, mipLevels, regions, file.data, file.size);
+
+    return newTexture;
+}
+
+RenderTexture RenderManager::createTexture(const uint32_t width, const uint32_t height, const uint32_t mipLevels, const VkFormat format)
 {
     RenderTexture newTexture = {};
+    newTexture.id = nextTextureId();
 
     VkImageCreateInfo imageInfo = {};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -512,128 +1108,137 @@ RenderTexture RenderManager::addTexture(const uint32_t width, const uint32_t hei
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.format = format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
+    // written on the transfer queue but sampled on the graphics queue, so avoid ownership transfers
+    const std::array queueFamilies = {m_device->graphicsFamilyIndex, m_device->transferFamilyIndex};
+    if (m_device->graphicsFamilyIndex != m_device->transferFamilyIndex) {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = queueFamilies.size();
+        imageInfo.pQueueFamilyIndices = queueFamilies.data();
+    }
+
     vkCreateImage(m_device->device, &imageInfo, nullptr, &newTexture.handle);
 
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(m_device->device, newTexture.handle, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = m_device->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    newTexture.allocation = m_device->allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
 
-    vkAllocateMemory(m_device->device, &allocInfo, nullptr, &newTexture.memory);
+    // game textures can be large, so running out of memory for one only leaves that texture out
+    if (newTexture.allocation.memory == VK_NULL_HANDLE) {
+        qWarning() << "Failed to allocate memory for a" << width << "x" << height << "texture";
+        vkDestroyImage(m_device->device, newTexture.handle, nullptr);
+        return {};
+    }
 
-    vkBindImageMemory(m_device->device, newTexture.handle, newTexture.memory, 0);
+    vkBindImageMemory(m_device->device, newTexture.handle, newTexture.allocation.memory, newTexture.allocation.offset);
 
-    // copy image data
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    VkImageSubresourceRange range = {};
+    range.levelCount = mipLevels;
+    range.layerCount = 1;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = data_size;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = newTexture.handle;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = imageInfo.format;
+    viewInfo.subresourceRange = range;
 
-    vkCreateBuffer(m_device->device, &bufferInfo, nullptr, &stagingBuffer);
+    vkCreateImageView(m_device->device, &viewInfo, nullptr, &newTexture.view);
 
-    // allocate staging memory
-    vkGetBufferMemoryRequirements(m_device->device, stagingBuffer, &memRequirements);
+    newTexture.sampler = m_device->samplerCache->sampler(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
-    allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        m_device->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    return newTexture;
+}
 
-    vkAllocateMemory(m_device->device, &allocInfo, nullptr, &stagingBufferMemory);
+bool RenderManager::canSampleFormat(const VkFormat format) const
+{
+    const bool isBlockCompressed = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+    if (isBlockCompressed && !m_device->textureCompressionBC) {
+        return false;
+    }
 
-    vkBindBufferMemory(m_device->device, stagingBuffer, stagingBufferMemory, 0);
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(m_device->physicalDevice, format, &properties);
 
-    // copy to staging buffer
-    void *mapped_data;
-    vkMapMemory(m_device->device, stagingBufferMemory, 0, data_size, 0, &mapped_data);
-    memcpy(mapped_data, data, data_size);
-    vkUnmapMemory(m_device->device, stagingBufferMemory);
+    const VkFormatFeatureFlags requiredFeatures =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+}
 
-    // copy staging buffer to image
-    VkCommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
+Device &RenderManager::device()
+{
+    return *m_device;
+}
 
-    VkImageSubresourceRange range = {};
-    range.baseMipLevel = 0;
-    range.levelCount = 1;
-    range.baseArrayLayer = 0;
-    range.layerCount = 1;
+void RenderManager::prepareMaterial(RenderMaterial &material)
+{
+    GameRenderer::prepareMaterial(material);
+}
 
-    m_device->inlineTransitionImageLayout(commandBuffer,
-                                          newTexture.handle,
-                                          imageInfo.format,
-                                          VK_IMAGE_ASPECT_COLOR_BIT,
-                                          range,
-                                          VK_IMAGE_LAYOUT_UNDEFINED,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+const CullingStatistics &RenderManager::cullingStatistics() const
+{
+    static const CullingStatistics noStatistics;
+    return m_renderer != nullptr ? m_renderer->cullingStatistics() : noStatistics;
+}
 
-    VkBufferImageCopy region = {};
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageExtent = {(uint32_t)width, (uint32_t)height, 1};
+bool RenderManager::hasPendingWork() const
+{
+    return !m_device->textureUploader->isIdle() || (m_renderer != nullptr && m_renderer->hasPendingWork());
+}
 
-    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, newTexture.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+bool RenderManager::isProfiling() const
+{
+    return m_device->profiler->isEnabled();
+}
 
-    m_device->inlineTransitionImageLayout(commandBuffer,
-                                          newTexture.handle,
-                                          imageInfo.format,
-                                          VK_IMAGE_ASPECT_COLOR_BIT,
-                                          range,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+void RenderManager::drawProfilerOverlay()
+{
+    if (!isProfiling()) {
+        return;
+    }
 
-    m_device->endSingleTimeCommands(commandBuffer);
+    if (ImGui::Begin("Profiler")) {
+        m_device->profiler->drawOverlay();
 
-    range = {};
-    range.levelCount = 1;
-    range.layerCount = 1;
-    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        ImGui::Separator();
 
-    VkImageViewCreateInfo viewInfo = {};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = newTexture.handle;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = imageInfo.format;
-    viewInfo.subresourceRange = range;
+        ImGui::Text("Staging uploads: %.1f KiB", m_device->stagingRing->bytesUploadedLastFrame() / 1024.0);
 
-    vkCreateImageView(m_device->device, &viewInfo, nullptr, &newTexture.view);
+        const auto memory = m_device->allocator->statistics();
+        ImGui::Text("Device memory: %.1f of %.1f MiB used, in %u blocks",
+                    memory.usedBytes / (1024.0 * 1024.0),
+                    memory.blockBytes / (1024.0 * 1024.0),
+                    memory.blockCount);
 
-    VkSamplerCreateInfo samplerInfo = {};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.maxLod = 1.0f;
+        const CullingStatistics &culling = cullingStatistics();
+        ImGui::Text("Objects: %u visible, %u culled", culling.visibleObjects, culling.culledObjects);
+        ImGui::Text("Parts: %u visible, %u culled", culling.visibleParts, culling.culledParts);
 
-    vkCreateSampler(m_device->device, &samplerInfo, nullptr, &newTexture.sampler);
+        ImGui::TextWrapped("Frame times: %s", m_frameTimes.summary().toUtf8().constData());
+    }
+    ImGui::End();
+}
 
-    return newTexture;
+TextureCache &RenderManager::textureCache()
+{
+    return *m_textureCache;
 }
 
-Device &RenderManager::device()
+void RenderManager::textureDestroyed(const uint64_t textureId)
 {
-    return *m_device;
+    if (m_renderer != nullptr) {
+        m_renderer->textureDestroyed(textureId);
+    }
 }
 
 void RenderManager::updateCamera(Camera &camera)
@@ -743,7 +1348,7 @@ void RenderManager::initBlitPipeline()
     createInfo.layout = m_pipelineLayout;
     createInfo.renderPass = m_renderPass;
 
-    vkCreateGraphicsPipelines(m_device->device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_pipeline);
+    vkCreateGraphicsPipelines(m_device->device, m_device->pipelineCache->handle(), 1, &createInfo, nullptr, &m_pipeline);
 
     VkSamplerCreateInfo samplerInfo = {};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -779,4 +1384,25 @@ void RenderManager::initBlitPipeline()
     multiDescriptorWrite2.dstBinding = 0;
 
     vkUpdateDescriptorSets(m_device->device, 1, &multiDescriptorWrite2, 0, nullptr);
+
+    // the pipeline keeps its own copy of the code
+    vkDestroyShaderModule(m_device->device, vertexShaderStageInfo.module, nullptr);
+    vkDestroyShaderModule(m_device->device, fragmentShaderStageInfo.module, nullptr);
+}
+
+void RenderManager::destroyBlitPipeline()
+{
+    if (m_descriptorSet != VK_NULL_HANDLE) {
+        vkFreeDescriptorSets(m_device->device, m_device->descriptorPool, 1, &m_descriptorSet);
+        m_descriptorSet = VK_NULL_HANDLE;
+    }
+
+    vkDestroySampler(m_device->device, m_sampler, nullptr);
+    m_sampler = VK_NULL_HANDLE;
+    vkDestroyPipeline(m_device->device, m_pipeline, nullptr);
+    m_pipeline = VK_NULL_HANDLE;
+    vkDestroyPipelineLayout(m_device->device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = VK_NULL_HANDLE;
+    vkDestroyDescriptorSetLayout(m_device->device, m_setLayout, nullptr);
+    m_setLayout = VK_NULL_HANDLE;
 }
@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "samplercache.h"
+
+#include "device.h"
+
+SamplerCache::SamplerCache(Device &device)
+    : m_device(device)
+{
+}
+
+SamplerCache::~SamplerCache()
+{
+    for (const auto &[key, sampler] : m_samplers) {
+        vkDestroySampler(m_device.device, sampler, nullptr);
+    }
+}
+
+VkSampler SamplerCache::sampler(const VkFilter filter, const VkSamplerAddressMode addressMode, const float maxLod)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const auto key = std::make_tuple(filter, addressMode, maxLod);
+    if (auto it = m_samplers.find(key); it != m_samplers.end()) {
+        return it->second;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = filter;
+    samplerInfo.minFilter = filter;
+    samplerInfo.addressModeU = addressMode;
+    samplerInfo.addressModeV = addressMode;
+    samplerInfo.addressModeW = addressMode;
+    samplerInfo.mipmapMode = filter == VK_FILTER_NEAREST ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.maxLod = maxLod;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    vkCreateSampler(m_device.device, &samplerInfo, nullptr, &sampler);
+
+    m_samplers[key] = sampler;
+
+    return sampler;
+}
@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "shadercache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+#include "dxbc_module.h"
+#include "dxbc_reader.h"
+
+// bump this whenever the translation itself changes, so old entries on disk are no longer used
+const QByteArray cacheVersion = QByteArrayLiteral("dxbc-spirv-1");
+
+const uint32_t spirvMagic = 0x07230203;
+
+ShaderCache::ShaderCache()
+{
+    const QDir cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    m_directory = cacheDir.absoluteFilePath(QStringLiteral("shaders"));
+}
+
+std::vector<uint32_t> ShaderCache::spirv(const QByteArrayView bytecode)
+{
+    const QByteArray shaderKey = key(bytecode);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (const auto it = m_cache.constFind(shaderKey); it != m_cache.cend()) {
+            return *it;
+        }
+    }
+
+    std::vector<uint32_t> code = loadFromDisk(shaderKey);
+    if (code.empty()) {
+        dxvk::DxbcReader reader(bytecode.constData(), bytecode.size());
+
+        dxvk::DxbcModule module(reader);
+
+        dxvk::DxbcModuleInfo info;
+        auto result = module.compile(info, "test");
+
+        code.resize(result.code.dwords());
+        memcpy(code.data(), result.code.data(), result.code.size());
+
+        saveToDisk(shaderKey, code);
+
+        QMutexLocker locker(&m_mutex);
+        m_translatedCount++;
+        qInfo() << "Translated shader" << shaderKey.toHex() << "(" << m_translatedCount << "translated this session)";
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(shaderKey, code);
+
+    return code;
+}
+
+QByteArray ShaderCache::key(const QByteArrayView bytecode) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(cacheVersion);
+    hash.addData(bytecode);
+
+    return hash.result();
+}
+
+std::vector<uint32_t> ShaderCache::loadFromDisk(const QByteArray &key) const
+{
+    QFile file(QDir(m_directory).absoluteFilePath(QString::fromLatin1(key.toHex()) + QStringLiteral(".spv")));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    const QByteArray data = file.readAll();
+
+    // anything that doesn't look like SPIR-V is treated as a miss, and overwritten after translating again
+    uint32_t magic = 0;
+    if (data.size() < static_cast<qsizetype>(sizeof(uint32_t)) || data.size() % sizeof(uint32_t) != 0) {
+        return {};
+    }
+    memcpy(&magic, data.constData(), sizeof(uint32_t));
+    if (magic != spirvMagic) {
+        return {};
+    }
+
+    std::vector<uint32_t> code(data.size() / sizeof(uint32_t));
+    memcpy(code.data(), data.constData(), data.size());
+
+    return code;
+}
+
+void ShaderCache::saveToDisk(const QByteArray &key, const std::vector<uint32_t> &code) const
+{
+    if (!QDir().mkpath(m_directory)) {
+        return;
+    }
+
+    QSaveFile file(QDir(m_directory).absoluteFilePath(QString::fromLatin1(key.toHex()) + QStringLiteral(".spv")));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open the shader cache in" << m_directory;
+        return;
+    }
+
+    file.write(reinterpret_cast<const char *>(code.data()), static_cast<qint64>(code.size() * sizeof(uint32_t)));
+    file.commit();
+}
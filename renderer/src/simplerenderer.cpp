@@ -2,16 +2,48 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "simplerenderer.h"
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
 #include <glm/ext/matrix_transform.hpp>
 
 #include "camera.h"
 #include "device.h"
 #include "drawobject.h"
+#include "pipelinecache.h"
+#include "profiler.h"
 #include "swapchain.h"
+#include "textureuploader.h"
+
+// the bones are bound with the range of the model's own palette, which can't be empty
+static size_t boneDataSize(const size_t boneCount)
+{
+    return sizeof(glm::mat3x4) * std::max<size_t>(boneCount, 1);
+}
+
+// below this, handing models to another thread costs more than recording them
+const size_t minimumModelsPerThread = 32;
 
 SimpleRenderer::SimpleRenderer(Device &device)
     : m_device(device)
+    , m_uniformRing(device, 4 * 1024 * 1024)
+    , m_skinning(device)
 {
+    m_parallelRecording = qgetenv("NOVUS_PARALLEL_RECORDING") == QByteArrayLiteral("1");
+    m_instancing = qgetenv("NOVUS_NO_INSTANCING") != QByteArrayLiteral("1");
+
+    if (qgetenv("NOVUS_GPU_CULLING") == QByteArrayLiteral("1")) {
+        if (m_device.drawIndirectCount) {
+            m_gpuCulling = true;
+            initGpuCulling();
+        } else {
+            qWarning() << "GPU culling needs multiDrawIndirect and drawIndirectCount, which this device doesn't support";
+        }
+    }
+    m_recordingThreads.setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+
     m_dummyTex = m_device.createDummyTexture();
 
     VkSamplerCreateInfo samplerInfo = {};
@@ -27,10 +59,56 @@ SimpleRenderer::SimpleRenderer(Device &device)
     vkCreateSampler(m_device.device, &samplerInfo, nullptr, &m_sampler);
 }
 
+SimpleRenderer::~SimpleRenderer()
+{
+    m_recordingThreads.waitForDone();
+
+    for (auto &pools : m_recordingPools) {
+        for (const auto &recordingPool : pools) {
+            // also frees its command buffer
+            vkDestroyCommandPool(m_device.device, recordingPool.commandPool, nullptr);
+        }
+    }
+
+    for (auto &instanceBuffer : m_instanceBuffers) {
+        m_device.destroyBuffer(instanceBuffer.buffer);
+    }
+
+    for (auto &frame : m_gpuCullingFrames) {
+        m_device.destroyBuffer(frame.instances);
+        m_device.destroyBuffer(frame.commands);
+        m_device.destroyBuffer(frame.counts);
+        if (frame.descriptorSet != VK_NULL_HANDLE) {
+            vkFreeDescriptorSets(m_device.device, m_device.descriptorPool, 1, &frame.descriptorSet);
+        }
+    }
+
+    vkDestroyPipeline(m_device.device, m_cullPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device.device, m_cullPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device.device, m_cullSetLayout, nullptr);
+
+    for (const auto &[key, descriptorSet] : cachedDescriptors) {
+        vkFreeDescriptorSets(m_device.device, m_device.descriptorPool, 1, &descriptorSet);
+    }
+
+    destroySizedResources();
+    vkDestroyDescriptorSetLayout(m_device.device, m_setLayout, nullptr);
+    vkDestroyRenderPass(m_device.device, m_renderPass, nullptr);
+
+    m_device.destroyTexture(m_dummyTex);
+    vkDestroySampler(m_device.device, m_sampler, nullptr);
+}
+
 void SimpleRenderer::resize()
 {
-    initRenderPass();
-    initDescriptors();
+    // the render pass and descriptor set layout don't depend on the size, so they're kept along with the sets using them
+    if (m_renderPass == VK_NULL_HANDLE) {
+        initRenderPass();
+        initDescriptors();
+    } else {
+        destroySizedResources();
+    }
+
     initPipeline();
     initTextures(m_device.swapChain->extent.width, m_device.swapChain->extent.height);
 
@@ -48,6 +126,27 @@ void SimpleRenderer::resize()
     vkCreateFramebuffer(m_device.device, &framebufferInfo, nullptr, &m_framebuffer);
 }
 
+void SimpleRenderer::destroySizedResources()
+{
+    for (auto pipeline : {&m_pipeline,
+                          &m_skinnedPipeline,
+                          &m_pipelineWireframe,
+                          &m_skinnedPipelineWireframe,
+                          &m_instancedPipeline,
+                          &m_instancedPipelineWireframe}) {
+        vkDestroyPipeline(m_device.device, *pipeline, nullptr);
+        *pipeline = VK_NULL_HANDLE;
+    }
+    vkDestroyPipelineLayout(m_device.device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = VK_NULL_HANDLE;
+
+    vkDestroyFramebuffer(m_device.device, m_framebuffer, nullptr);
+    m_framebuffer = VK_NULL_HANDLE;
+
+    m_device.destroyTexture(m_compositeTexture);
+    m_device.destroyTexture(m_depthTexture);
+}
+
 void SimpleRenderer::render(VkCommandBuffer commandBuffer, uint32_t currentFrame, Camera &camera, const std::vector<DrawObject> &models)
 {
     VkRenderPassBeginInfo renderPassInfo = {};
@@ -66,44 +165,91 @@ void SimpleRenderer::render(VkCommandBuffer commandBuffer, uint32_t currentFrame
     renderPassInfo.pClearValues = clearValues.data();
     renderPassInfo.renderArea.extent = m_device.swapChain->extent;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    Profiler &profiler = *m_device.profiler;
 
-    for (auto model : models) {
-        if (model.skinned) {
-            if (m_wireframe) {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skinnedPipelineWireframe);
-            } else {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skinnedPipeline);
-            }
-        } else {
-            if (m_wireframe) {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineWireframe);
-            } else {
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-            }
-        }
+    m_uniformRing.beginFrame(currentFrame);
+    profiler.count(Profiler::UniformBytes, m_uniformRing.bytesWrittenLastFrame());
+    profiler.count(Profiler::UniformDrops, m_uniformRing.droppedLastFrame());
+
+    {
+        Profiler::CpuScope scope(profiler, "Prepare models");
+        prepareModels(models, camera);
+        prepareInstances(currentFrame);
+    }
+
+    const glm::mat4 viewProjection = camera.perspective * camera.view;
+
+    // the compute passes have to be recorded before the render pass begins
+    {
+        Profiler::GpuScope scope(profiler, commandBuffer, "Skinning");
+        m_skinning.update(commandBuffer, currentFrame, models, m_modelLods);
+    }
 
-        // copy bone data
-        {
-            const size_t bufferSize = sizeof(glm::mat4) * 128;
-            void *mapped_data = nullptr;
-            vkMapMemory(m_device.device, model.boneInfoBuffer.memory, 0, bufferSize, 0, &mapped_data);
+    if (m_gpuCulling) {
+        Profiler::GpuScope scope(profiler, commandBuffer, "GPU culling");
+        cullOnGpu(commandBuffer, currentFrame);
+    }
+
+    // splitting the models up only pays off once every thread gets enough of them
+    const bool parallel = !m_gpuCulling && m_parallelRecording && m_preparedModels.size() >= minimumModelsPerThread * 2;
+
+    // timestamps can't be written inside a render pass that's made up of secondary command buffers, so it's timed from the outside
+    Profiler::CpuScope recordScope(profiler, "Record models");
+    Profiler::GpuScope passScope(profiler, commandBuffer, "Main pass");
 
-            memcpy(mapped_data, model.boneData.data(), bufferSize);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
-            VkMappedMemoryRange range = {};
-            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-            range.memory = model.boneInfoBuffer.memory;
-            range.size = bufferSize;
-            vkFlushMappedMemoryRanges(m_device.device, 1, &range);
+    if (m_gpuCulling) {
+        recordIndirect(commandBuffer, currentFrame, viewProjection);
+    } else if (parallel) {
+        recordInParallel(commandBuffer, currentFrame, viewProjection);
+    } else {
+        recordInstances(commandBuffer, currentFrame, viewProjection);
+        recordModels(commandBuffer, 0, m_preparedModels.size(), viewProjection);
+    }
 
-            vkUnmapMemory(m_device.device, model.boneInfoBuffer.memory);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void SimpleRenderer::prepareModels(const std::vector<DrawObject> &models, Camera &camera)
+{
+    m_preparedModels.clear();
+    m_preparedParts.clear();
+    m_modelLods.assign(models.size(), nullptr);
+
+    m_culler.beginFrame(camera);
+    m_lodSelector.beginFrame(camera);
+
+    for (size_t i = 0; i < models.size(); i++) {
+        const auto &model = models[i];
+        const RenderLod &lod = m_lodSelector.select(model, model.position);
+
+        if (!m_culler.isVisible(model, lod, model.position)) {
+            continue;
+        }
+
+        // bone data is only copied again once it changes, otherwise the copy already in this frame's region is reused
+        const uint64_t boneKey = model.id;
+        auto boneOffset = m_uniformRing.find(boneKey, model.boneDataVersion);
+        if (!boneOffset) {
+            boneOffset = m_uniformRing.push(boneKey,
+                                            model.boneDataVersion,
+                                            model.boneData.data(),
+                                            model.boneData.size() * sizeof(glm::mat3x4),
+                                            boneDataSize(model.boneData.size()));
+            // the ring warns about it and the profiler counts it, there is nothing else to bind the bones from
+            if (!boneOffset) {
+                continue;
+            }
         }
 
-        for (const auto &part : model.parts) {
+        m_preparedModels.push_back({&model, &lod, *boneOffset, m_preparedParts.size()});
+        m_modelLods[i] = &lod;
+
+        for (const auto &part : lod.parts) {
             RenderMaterial defaultMaterial = {};
 
-            RenderMaterial *material = nullptr;
+            const RenderMaterial *material = nullptr;
 
             if (static_cast<size_t>(part.materialIndex) >= model.materials.size()) {
                 material = &defaultMaterial;
@@ -111,27 +257,89 @@ void SimpleRenderer::render(VkCommandBuffer commandBuffer, uint32_t currentFrame
                 material = &model.materials[part.materialIndex];
             }
 
-            const auto h = hash(model, *material);
-            if (!cachedDescriptors.count(h)) {
-                if (auto descriptor = createDescriptorFor(model, *material); descriptor != VK_NULL_HANDLE) {
-                    cachedDescriptors[h] = descriptor;
+            // until every texture is uploaded, the model shares a descriptor made up of placeholders
+            if (!texturesReady(*material)) {
+                defaultMaterial.type = material->type;
+                material = &defaultMaterial;
+            }
+
+            PreparedPart &preparedPart = m_preparedParts.emplace_back();
+            preparedPart.materialType = static_cast<int>(material->type);
+
+            // left without a descriptor, so recordModels() skips it. with GPU culling, parts are tested in cull.comp instead
+            if (!m_gpuCulling && !m_culler.isVisible(part, model.position)) {
+                continue;
+            }
+
+            const auto key = descriptorKey(*material, model.boneData.size());
+            if (!cachedDescriptors.count(key)) {
+                if (auto descriptor = createDescriptorFor(*material, model.boneData.size()); descriptor != VK_NULL_HANDLE) {
+                    cachedDescriptors[key] = descriptor;
                 } else {
                     continue;
                 }
             }
 
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &cachedDescriptors[h], 0, nullptr);
+            preparedPart.descriptorSet = cachedDescriptors[key];
+        }
+    }
+}
 
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &part.vertexBuffer.buffer, offsets);
-            vkCmdBindIndexBuffer(commandBuffer, part.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+void SimpleRenderer::recordModels(VkCommandBuffer commandBuffer, const size_t begin, const size_t end, const glm::mat4 &viewProjection)
+{
+    // this may run on several threads at once, so the counters are only added up at the end
+    uint64_t pipelineBinds = 0, descriptorBinds = 0, drawCalls = 0, triangles = 0;
+
+    for (size_t i = begin; i < end; i++) {
+        const PreparedModel &prepared = m_preparedModels[i];
+        const DrawObject &model = *prepared.model;
+        if (prepared.instanced) {
+            continue;
+        }
+
+        // models already skinned in a compute shader are drawn like unskinned ones, from a buffer that only holds the drawn LOD
+        const SkinningPass::SkinnedVertices skinnedVertices = m_skinning.skinnedVertices(model);
+        const VkBuffer vertexBuffer = skinnedVertices.buffer != VK_NULL_HANDLE ? skinnedVertices.buffer : model.vertexBuffer.buffer;
+
+        if (model.skinned && skinnedVertices.buffer == VK_NULL_HANDLE) {
+            if (m_wireframe) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skinnedPipelineWireframe);
+            } else {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skinnedPipeline);
+            }
+        } else {
+            if (m_wireframe) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineWireframe);
+            } else {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+            }
+        }
+        pipelineBinds++;
 
-            glm::mat4 vp = camera.perspective * camera.view;
+        // every part shares the same buffers
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
-            vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &vp);
+        auto m = glm::mat4(1.0f);
+        m = glm::translate(m, model.position);
 
-            auto m = glm::mat4(1.0f);
-            m = glm::translate(m, model.position);
+        for (size_t j = 0; j < prepared.lod->parts.size(); j++) {
+            const auto &part = prepared.lod->parts[j];
+            const PreparedPart &preparedPart = m_preparedParts[prepared.firstPart + j];
+            if (preparedPart.descriptorSet == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &preparedPart.descriptorSet, 1, &prepared.boneOffset);
+            descriptorBinds++;
+
+            vkCmdPushConstants(commandBuffer,
+                               m_pipelineLayout,
+                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                               0,
+                               sizeof(glm::mat4),
+                               &viewProjection);
 
             vkCmdPushConstants(commandBuffer,
                                m_pipelineLayout,
@@ -148,19 +356,211 @@ void SimpleRenderer::render(VkCommandBuffer commandBuffer, uint32_t currentFrame
                                sizeof(int),
                                &test);
 
-            int type = (int)material->type;
             vkCmdPushConstants(commandBuffer,
                                m_pipelineLayout,
                                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
                                sizeof(glm::mat4) * 2 + sizeof(int),
                                sizeof(int),
-                               &type);
+                               &preparedPart.materialType);
 
-            vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, 0, 0, 0);
+            vkCmdDrawIndexed(commandBuffer, part.numIndices, 1, part.firstIndex, part.vertexOffset - skinnedVertices.firstVertex, 0);
+            drawCalls++;
+            triangles += part.numIndices / 3;
         }
     }
 
-    vkCmdEndRenderPass(commandBuffer);
+    Profiler &profiler = *m_device.profiler;
+    profiler.count(Profiler::PipelineBinds, pipelineBinds);
+    profiler.count(Profiler::DescriptorBinds, descriptorBinds);
+    profiler.count(Profiler::DrawCalls, drawCalls);
+    profiler.count(Profiler::Triangles, triangles);
+}
+
+void SimpleRenderer::prepareInstances(const uint32_t currentFrame)
+{
+    m_instanceBatches.clear();
+
+    // the indirect draws are already grouped per model
+    if (!m_instancing || m_gpuCulling) {
+        return;
+    }
+
+    // placements of the same mesh share its buffers, so a part is identified by where its indices start
+    std::map<std::tuple<VkBuffer, uint32_t, VkDescriptorSet, int>, size_t> batchIndices;
+
+    for (auto &prepared : m_preparedModels) {
+        const DrawObject &model = *prepared.model;
+
+        // every skinned placement has its own pose
+        if (model.skinned) {
+            continue;
+        }
+
+        prepared.instanced = true;
+
+        const glm::mat4 transform = glm::translate(glm::mat4(1.0f), model.position);
+
+        for (size_t j = 0; j < prepared.lod->parts.size(); j++) {
+            const auto &part = prepared.lod->parts[j];
+            const PreparedPart &preparedPart = m_preparedParts[prepared.firstPart + j];
+            if (preparedPart.descriptorSet == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            const auto key = std::make_tuple(model.vertexBuffer.buffer, part.firstIndex, preparedPart.descriptorSet, preparedPart.materialType);
+
+            auto batchIndex = batchIndices.find(key);
+            if (batchIndex == batchIndices.end()) {
+                batchIndex = batchIndices.emplace(key, m_instanceBatches.size()).first;
+
+                InstanceBatch &batch = m_instanceBatches.emplace_back();
+                batch.model = &model;
+                batch.part = &part;
+                batch.descriptorSet = preparedPart.descriptorSet;
+                batch.materialType = preparedPart.materialType;
+                batch.boneOffset = prepared.boneOffset;
+            }
+
+            m_instanceBatches[batchIndex->second].transforms.push_back(transform);
+        }
+    }
+
+    size_t instanceCount = 0;
+    for (auto &batch : m_instanceBatches) {
+        batch.firstInstance = instanceCount;
+        instanceCount += batch.transforms.size();
+    }
+
+    if (instanceCount == 0) {
+        return;
+    }
+
+    // the FrameScheduler waited for this frame before render() was called, so its buffer is free to reuse
+    auto &instanceBuffer = m_instanceBuffers[currentFrame % m_instanceBuffers.size()];
+    if (instanceCount > instanceBuffer.capacity) {
+        m_device.destroyBuffer(instanceBuffer.buffer);
+
+        // with some room to grow, so adding a few models doesn't recreate it every frame
+        instanceBuffer.capacity = std::max(instanceCount * 2, instanceBuffer.capacity);
+        instanceBuffer.buffer = m_device.createBuffer(instanceBuffer.capacity * sizeof(glm::mat4), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    }
+
+    auto transforms = static_cast<glm::mat4 *>(instanceBuffer.buffer.allocation.mapped);
+    for (const auto &batch : m_instanceBatches) {
+        std::copy(batch.transforms.cbegin(), batch.transforms.cend(), transforms + batch.firstInstance);
+    }
+}
+
+void SimpleRenderer::recordInstances(VkCommandBuffer commandBuffer, const uint32_t currentFrame, const glm::mat4 &viewProjection)
+{
+    if (m_instanceBatches.empty()) {
+        return;
+    }
+
+    const auto &instanceBuffer = m_instanceBuffers[currentFrame % m_instanceBuffers.size()];
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_wireframe ? m_instancedPipelineWireframe : m_instancedPipeline);
+
+    Profiler &profiler = *m_device.profiler;
+    profiler.count(Profiler::PipelineBinds);
+
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &viewProjection);
+
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    for (const auto &batch : m_instanceBatches) {
+        // batches of the same mesh are next to each other, so its buffers are usually bound once
+        if (batch.model->vertexBuffer.buffer != boundVertexBuffer) {
+            boundVertexBuffer = batch.model->vertexBuffer.buffer;
+
+            const std::array<VkBuffer, 2> vertexBuffers = {batch.model->vertexBuffer.buffer, instanceBuffer.buffer.buffer};
+            const std::array<VkDeviceSize, 2> offsets = {0, 0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), offsets.data());
+            vkCmdBindIndexBuffer(commandBuffer, batch.model->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+        }
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &batch.descriptorSet, 1, &batch.boneOffset);
+
+        vkCmdPushConstants(commandBuffer,
+                           m_pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           sizeof(glm::mat4) * 2 + sizeof(int),
+                           sizeof(int),
+                           &batch.materialType);
+
+        vkCmdDrawIndexed(commandBuffer, batch.part->numIndices, batch.transforms.size(), batch.part->firstIndex, batch.part->vertexOffset, batch.firstInstance);
+
+        profiler.count(Profiler::DescriptorBinds);
+        profiler.count(Profiler::DrawCalls);
+        profiler.count(Profiler::Triangles, static_cast<uint64_t>(batch.part->numIndices / 3) * batch.transforms.size());
+    }
+}
+
+void SimpleRenderer::recordInParallel(VkCommandBuffer commandBuffer, const uint32_t currentFrame, const glm::mat4 &viewProjection)
+{
+    const size_t threadCount = std::min<size_t>(m_recordingThreads.maxThreadCount(), m_preparedModels.size() / minimumModelsPerThread);
+
+    // the FrameScheduler waited for this frame before render() was called, so its pools are free to reset
+    auto &pools = m_recordingPools[currentFrame % m_recordingPools.size()];
+    while (pools.size() < threadCount) {
+        RecordingPool &recordingPool = pools.emplace_back();
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = m_device.graphicsFamilyIndex;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        vkCreateCommandPool(m_device.device, &poolInfo, nullptr, &recordingPool.commandPool);
+
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = recordingPool.commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocateInfo.commandBufferCount = 1;
+
+        vkAllocateCommandBuffers(m_device.device, &allocateInfo, &recordingPool.commandBuffer);
+    }
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = m_renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = m_framebuffer;
+
+    const size_t modelsPerThread = (m_preparedModels.size() + threadCount - 1) / threadCount;
+
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
+    for (size_t i = 0; i < threadCount; i++) {
+        const size_t begin = i * modelsPerThread;
+        const size_t end = std::min(begin + modelsPerThread, m_preparedModels.size());
+        if (begin >= end) {
+            break;
+        }
+
+        RecordingPool &recordingPool = pools[i];
+        secondaryCommandBuffers.push_back(recordingPool.commandBuffer);
+
+        // each job has its own pool, so nothing here needs a lock
+        m_recordingThreads.start([this, &recordingPool, &inheritanceInfo, &viewProjection, currentFrame, begin, end] {
+            vkResetCommandPool(m_device.device, recordingPool.commandPool, 0);
+
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+            vkBeginCommandBuffer(recordingPool.commandBuffer, &beginInfo);
+            // the instanced draws cover models from every job, so only the first one records them
+            if (begin == 0) {
+                recordInstances(recordingPool.commandBuffer, currentFrame, viewProjection);
+            }
+            recordModels(recordingPool.commandBuffer, begin, end, viewProjection);
+            vkEndCommandBuffer(recordingPool.commandBuffer);
+        });
+    }
+
+    m_recordingThreads.waitForDone();
+
+    vkCmdExecuteCommands(commandBuffer, secondaryCommandBuffers.size(), secondaryCommandBuffers.data());
 }
 
 void SimpleRenderer::initRenderPass()
@@ -236,6 +636,12 @@ void SimpleRenderer::initPipeline()
     skinnedVertexShaderStageInfo.module = m_device.loadShaderFromDisk(":/shaders/skinned.vert.spv");
     skinnedVertexShaderStageInfo.pName = "main";
 
+    VkPipelineShaderStageCreateInfo instancedVertexShaderStageInfo = {};
+    instancedVertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    instancedVertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    instancedVertexShaderStageInfo.module = m_device.loadShaderFromDisk(":/shaders/instanced.vert.spv");
+    instancedVertexShaderStageInfo.pName = "main";
+
     VkPipelineShaderStageCreateInfo fragmentShaderStageInfo = {};
     fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragmentShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -371,25 +777,57 @@ void SimpleRenderer::initPipeline()
     createInfo.layout = m_pipelineLayout;
     createInfo.renderPass = m_renderPass;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_pipeline);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache->handle(), 1, &createInfo, nullptr, &m_pipeline);
 
     shaderStages[0] = skinnedVertexShaderStageInfo;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_skinnedPipeline);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache->handle(), 1, &createInfo, nullptr, &m_skinnedPipeline);
 
     rasterizer.polygonMode = VK_POLYGON_MODE_LINE;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_skinnedPipelineWireframe);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache->handle(), 1, &createInfo, nullptr, &m_skinnedPipelineWireframe);
 
     shaderStages[0] = vertexShaderStageInfo;
 
-    vkCreateGraphicsPipelines(m_device.device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_pipelineWireframe);
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache->handle(), 1, &createInfo, nullptr, &m_pipelineWireframe);
+
+    // the instanced pipeline reads the transform of each placement from a second vertex buffer, stepped per instance
+    VkVertexInputBindingDescription instanceBinding = {};
+    instanceBinding.binding = 1;
+    instanceBinding.stride = sizeof(glm::mat4);
+    instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    const std::array bindings = {binding, instanceBinding};
+
+    std::vector<VkVertexInputAttributeDescription> instancedAttributes(attributes.cbegin(), attributes.cend());
+    for (uint32_t i = 0; i < 4; i++) {
+        VkVertexInputAttributeDescription modelAttribute = {};
+        modelAttribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        modelAttribute.location = 8 + i;
+        modelAttribute.binding = 1;
+        modelAttribute.offset = sizeof(glm::vec4) * i;
+
+        instancedAttributes.push_back(modelAttribute);
+    }
+
+    vertexInputState.vertexBindingDescriptionCount = bindings.size();
+    vertexInputState.pVertexBindingDescriptions = bindings.data();
+    vertexInputState.vertexAttributeDescriptionCount = instancedAttributes.size();
+    vertexInputState.pVertexAttributeDescriptions = instancedAttributes.data();
+
+    shaderStages[0] = instancedVertexShaderStageInfo;
+
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache->handle(), 1, &createInfo, nullptr, &m_instancedPipelineWireframe);
+
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+
+    vkCreateGraphicsPipelines(m_device.device, m_device.pipelineCache->handle(), 1, &createInfo, nullptr, &m_instancedPipeline);
 }
 
 void SimpleRenderer::initDescriptors()
 {
     VkDescriptorSetLayoutBinding boneInfoBufferBinding = {};
-    boneInfoBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    boneInfoBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     boneInfoBufferBinding.descriptorCount = 1;
     boneInfoBufferBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     boneInfoBufferBinding.binding = 2;
@@ -434,22 +872,41 @@ void SimpleRenderer::initTextures(int width, int height)
     m_depthTexture = m_device.createTexture(width, height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
-uint64_t SimpleRenderer::hash(const DrawObject &model, const RenderMaterial &material)
+SimpleRenderer::DescriptorKey SimpleRenderer::descriptorKey(const RenderMaterial &material, const size_t boneCount)
+{
+    const auto textureId = [](const RenderTexture *texture) -> uint64_t {
+        return texture != nullptr ? texture->id : 0;
+    };
+
+    return {{textureId(material.diffuseTexture), textureId(material.normalTexture), textureId(material.specularTexture), textureId(material.multiTexture)},
+            boneCount};
+}
+
+void SimpleRenderer::textureDestroyed(const uint64_t textureId)
+{
+    for (auto it = cachedDescriptors.begin(); it != cachedDescriptors.end();) {
+        const auto &textureIds = it->first.first;
+        if (std::find(textureIds.cbegin(), textureIds.cend(), textureId) != textureIds.cend()) {
+            vkFreeDescriptorSets(m_device.device, m_device.descriptorPool, 1, &it->second);
+            it = cachedDescriptors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool SimpleRenderer::texturesReady(const RenderMaterial &material) const
 {
-    uint64_t hash = 0;
-    hash += reinterpret_cast<intptr_t>((void *)&model);
-    if (material.diffuseTexture)
-        hash += reinterpret_cast<intptr_t>((void *)material.diffuseTexture);
-    if (material.normalTexture)
-        hash += reinterpret_cast<intptr_t>((void *)material.normalTexture);
-    if (material.specularTexture)
-        hash += reinterpret_cast<intptr_t>((void *)material.specularTexture);
-    if (material.multiTexture)
-        hash += reinterpret_cast<intptr_t>((void *)material.multiTexture);
-    return hash;
+    for (const auto texture : {material.diffuseTexture, material.normalTexture, material.specularTexture, material.multiTexture}) {
+        if (texture && !m_device.textureUploader->isComplete(texture->uploadValue)) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
-VkDescriptorSet SimpleRenderer::createDescriptorFor(const DrawObject &model, const RenderMaterial &material)
+VkDescriptorSet SimpleRenderer::createDescriptorFor(const RenderMaterial &material, const size_t boneCount)
 {
     VkDescriptorSet set;
 
@@ -465,18 +922,17 @@ VkDescriptorSet SimpleRenderer::createDescriptorFor(const DrawObject &model, con
         return VK_NULL_HANDLE;
     }
 
-    const size_t bufferSize = sizeof(glm::mat4) * 128;
-
     std::vector<VkWriteDescriptorSet> writes;
 
+    // which model's bones are used is decided by the dynamic offset, so this set can be shared between models with as many bones
     VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = model.boneInfoBuffer.buffer;
-    bufferInfo.range = bufferSize;
+    bufferInfo.buffer = m_uniformRing.buffer();
+    bufferInfo.range = boneDataSize(boneCount);
 
     VkWriteDescriptorSet descriptorWrite = {};
     descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrite.dstSet = set;
-    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     descriptorWrite.descriptorCount = 1;
     descriptorWrite.pBufferInfo = &bufferInfo;
     descriptorWrite.dstBinding = 2;
@@ -563,6 +1019,273 @@ VkDescriptorSet SimpleRenderer::createDescriptorFor(const DrawObject &model, con
     return set;
 }
 
+void SimpleRenderer::initGpuCulling()
+{
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindings.size();
+    layoutInfo.pBindings = bindings.data();
+
+    vkCreateDescriptorSetLayout(m_device.device, &layoutInfo, nullptr, &m_cullSetLayout);
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    vkCreatePipelineLayout(m_device.device, &pipelineLayoutInfo, nullptr, &m_cullPipelineLayout);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = m_device.loadShaderFromDisk(":/shaders/cull.comp.spv");
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_cullPipelineLayout;
+
+    vkCreateComputePipelines(m_device.device, m_device.pipelineCache->handle(), 1, &pipelineInfo, nullptr, &m_cullPipeline);
+
+    vkDestroyShaderModule(m_device.device, pipelineInfo.stage.module, nullptr);
+
+    for (auto &frame : m_gpuCullingFrames) {
+        VkDescriptorSetAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = m_device.descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &m_cullSetLayout;
+
+        vkAllocateDescriptorSets(m_device.device, &allocateInfo, &frame.descriptorSet);
+    }
+}
+
+void SimpleRenderer::cullOnGpu(VkCommandBuffer commandBuffer, const uint32_t currentFrame)
+{
+    // the FrameScheduler waited for this frame before render() was called, so its buffers are free to reuse
+    auto &frame = m_gpuCullingFrames[currentFrame % m_gpuCullingFrames.size()];
+
+    // what the GPU culled the last time it used these buffers, which is a few frames behind
+    if (frame.instanceCount > 0) {
+        const auto counts = static_cast<const uint32_t *>(frame.counts.allocation.mapped);
+
+        uint32_t visible = 0;
+        for (uint32_t i = 0; i < frame.groupCount; i++) {
+            visible += counts[i];
+        }
+        m_culler.addPartStatistics(visible, frame.instanceCount - visible);
+    }
+
+    // parts of a model that share a descriptor are drawn with one indirect call
+    m_indirectGroups.clear();
+
+    std::vector<GpuInstance> instances;
+    instances.reserve(m_preparedParts.size());
+
+    for (size_t i = 0; i < m_preparedModels.size(); i++) {
+        const PreparedModel &prepared = m_preparedModels[i];
+        const DrawObject &model = *prepared.model;
+        const size_t modelGroups = m_indirectGroups.size();
+        // the same buffer recordIndirect() binds, which for skinned vertices only starts at the drawn LOD
+        const int32_t firstVertex = m_skinning.skinnedVertices(model).firstVertex;
+
+        for (size_t j = 0; j < prepared.lod->parts.size(); j++) {
+            const auto &part = prepared.lod->parts[j];
+            const PreparedPart &preparedPart = m_preparedParts[prepared.firstPart + j];
+            if (preparedPart.descriptorSet == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            auto group = std::find_if(m_indirectGroups.begin() + modelGroups, m_indirectGroups.end(), [&preparedPart](const IndirectGroup &group) {
+                return group.descriptorSet == preparedPart.descriptorSet && group.materialType == preparedPart.materialType;
+            });
+            if (group == m_indirectGroups.end()) {
+                group = m_indirectGroups.insert(m_indirectGroups.end(), {i, preparedPart.descriptorSet, preparedPart.materialType, 0, 0});
+            }
+            group->maxCount++;
+
+            GpuInstance &instance = instances.emplace_back();
+            instance.sphere = glm::vec4(part.boundingSphere.center + model.position, part.boundingSphere.radius);
+            instance.indexCount = part.numIndices;
+            instance.firstIndex = part.firstIndex;
+            instance.vertexOffset = part.vertexOffset - firstVertex;
+            instance.group = std::distance(m_indirectGroups.begin(), group);
+        }
+    }
+
+    // every group gets room for all of its parts, in case none are culled
+    uint32_t firstCommand = 0;
+    for (auto &group : m_indirectGroups) {
+        group.firstCommand = firstCommand;
+        firstCommand += group.maxCount;
+    }
+
+    for (auto &instance : instances) {
+        instance.firstCommand = m_indirectGroups[instance.group].firstCommand;
+    }
+
+    frame.instanceCount = instances.size();
+    frame.groupCount = m_indirectGroups.size();
+
+    if (instances.empty()) {
+        return;
+    }
+
+    if (instances.size() > frame.instanceCapacity || m_indirectGroups.size() > frame.groupCapacity) {
+        m_device.destroyBuffer(frame.instances);
+        m_device.destroyBuffer(frame.commands);
+        m_device.destroyBuffer(frame.counts);
+
+        // with some room to grow, so adding a few models doesn't recreate them every frame
+        frame.instanceCapacity = std::max(instances.size() * 2, frame.instanceCapacity);
+        frame.groupCapacity = std::max(m_indirectGroups.size() * 2, frame.groupCapacity);
+
+        frame.instances = m_device.createBuffer(frame.instanceCapacity * sizeof(GpuInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        frame.commands = m_device.createBuffer(frame.instanceCapacity * sizeof(VkDrawIndexedIndirectCommand),
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        frame.counts = m_device.createBuffer(frame.groupCapacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+        std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+        bufferInfos[0] = {frame.instances.buffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[1] = {frame.commands.buffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {frame.counts.buffer, 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 3> writes = {};
+        for (uint32_t i = 0; i < writes.size(); i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = frame.descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+
+        vkUpdateDescriptorSets(m_device.device, writes.size(), writes.data(), 0, nullptr);
+    }
+
+    // host writes are visible to the GPU once the command buffer is submitted, so no barrier is needed for these
+    memcpy(frame.instances.allocation.mapped, instances.data(), instances.size() * sizeof(GpuInstance));
+    memset(frame.counts.allocation.mapped, 0, m_indirectGroups.size() * sizeof(uint32_t));
+
+    CullPushConstants pushConstants = {};
+    std::copy(m_culler.frustum().planes().cbegin(), m_culler.frustum().planes().cend(), pushConstants.planes.begin());
+    pushConstants.instanceCount = instances.size();
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (instances.size() + 63) / 64, 1, 1);
+
+    Profiler &profiler = *m_device.profiler;
+    profiler.count(Profiler::PipelineBinds);
+    profiler.count(Profiler::DescriptorBinds);
+    profiler.count(Profiler::Dispatches);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+}
+
+void SimpleRenderer::recordIndirect(VkCommandBuffer commandBuffer, const uint32_t currentFrame, const glm::mat4 &viewProjection)
+{
+    const auto &frame = m_gpuCullingFrames[currentFrame % m_gpuCullingFrames.size()];
+
+    Profiler &profiler = *m_device.profiler;
+
+    size_t boundModel = m_preparedModels.size();
+    for (size_t i = 0; i < m_indirectGroups.size(); i++) {
+        const IndirectGroup &group = m_indirectGroups[i];
+        const PreparedModel &prepared = m_preparedModels[group.model];
+        const DrawObject &model = *prepared.model;
+
+        // groups are in model order, so the model's state only has to be set up once
+        if (group.model != boundModel) {
+            boundModel = group.model;
+
+            const SkinningPass::SkinnedVertices skinnedVertices = m_skinning.skinnedVertices(model);
+            const VkBuffer vertexBuffer = skinnedVertices.buffer != VK_NULL_HANDLE ? skinnedVertices.buffer : model.vertexBuffer.buffer;
+
+            if (model.skinned && skinnedVertices.buffer == VK_NULL_HANDLE) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_wireframe ? m_skinnedPipelineWireframe : m_skinnedPipeline);
+            } else {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_wireframe ? m_pipelineWireframe : m_pipeline);
+            }
+            profiler.count(Profiler::PipelineBinds);
+
+            VkDeviceSize offsets[] = {0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+
+            const glm::mat4 m = glm::translate(glm::mat4(1.0f), model.position);
+            const int test = 0;
+
+            vkCmdPushConstants(commandBuffer,
+                               m_pipelineLayout,
+                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                               0,
+                               sizeof(glm::mat4),
+                               &viewProjection);
+            vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4), sizeof(glm::mat4), &m);
+            vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4) * 2, sizeof(int), &test);
+        }
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &group.descriptorSet, 1, &prepared.boneOffset);
+        vkCmdPushConstants(commandBuffer,
+                           m_pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           sizeof(glm::mat4) * 2 + sizeof(int),
+                           sizeof(int),
+                           &group.materialType);
+
+        vkCmdDrawIndexedIndirectCount(commandBuffer,
+                                      frame.commands.buffer,
+                                      group.firstCommand * sizeof(VkDrawIndexedIndirectCommand),
+                                      frame.counts.buffer,
+                                      i * sizeof(uint32_t),
+                                      group.maxCount,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+
+        // how many of the group's draws survive culling is only known on the GPU, so triangles aren't counted here
+        profiler.count(Profiler::DescriptorBinds);
+        profiler.count(Profiler::DrawCalls);
+    }
+}
+
+const CullingStatistics &SimpleRenderer::cullingStatistics() const
+{
+    return m_culler.statistics();
+}
+
+bool SimpleRenderer::hasPendingWork() const
+{
+    // placeholder textures are only waiting on the TextureUploader, which RenderManager already checks
+    return false;
+}
+
 Texture &SimpleRenderer::getCompositeTexture()
 {
     return m_compositeTexture;
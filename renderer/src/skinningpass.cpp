@@ -0,0 +1,331 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "skinningpass.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cstddef>
+
+#include <physis.hpp>
+
+#include "device.h"
+#include "drawobject.h"
+#include "pipelinecache.h"
+#include "profiler.h"
+
+// the shader reads vertices as words
+static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0);
+
+// how many models can be skinned at once, each one needs a descriptor set
+const uint32_t maxSkinnedModels = 256;
+
+// the bones are bound with the range of the model's own palette, which can't be empty
+static size_t boneDataSize(const size_t boneCount)
+{
+    return sizeof(glm::mat3x4) * std::max<size_t>(boneCount, 1);
+}
+
+SkinningPass::SkinningPass(Device &device)
+    : m_device(device)
+    , m_boneRing(device, 1024 * 1024)
+{
+    m_enabled = qgetenv("NOVUS_NO_COMPUTE_SKINNING") != QByteArrayLiteral("1");
+    if (m_enabled) {
+        initPipeline();
+    }
+}
+
+SkinningPass::~SkinningPass()
+{
+    for (auto &[id, skinnedModel] : m_models) {
+        m_device.destroyBuffer(skinnedModel.vertices);
+    }
+
+    for (auto &buffers : m_retiredBuffers) {
+        for (auto &buffer : buffers) {
+            m_device.destroyBuffer(buffer);
+        }
+    }
+
+    vkDestroyPipeline(m_device.device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device.device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device.device, m_setLayout, nullptr);
+    vkDestroyDescriptorPool(m_device.device, m_descriptorPool, nullptr);
+}
+
+bool SkinningPass::enabled() const
+{
+    return m_enabled;
+}
+
+void SkinningPass::update(VkCommandBuffer commandBuffer,
+                          const uint32_t currentFrame,
+                          const std::vector<DrawObject> &models,
+                          const std::vector<const RenderLod *> &lods)
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    // the FrameScheduler waited for this frame before render() was called, so nothing retired the last time it was recorded is in use anymore
+    auto &retiredBuffers = m_retiredBuffers[currentFrame % m_retiredBuffers.size()];
+    for (auto &buffer : retiredBuffers) {
+        m_device.destroyBuffer(buffer);
+    }
+    retiredBuffers.clear();
+
+    auto &retiredDescriptorSets = m_retiredDescriptorSets[currentFrame % m_retiredDescriptorSets.size()];
+    if (!retiredDescriptorSets.empty()) {
+        vkFreeDescriptorSets(m_device.device, m_descriptorPool, retiredDescriptorSets.size(), retiredDescriptorSets.data());
+        retiredDescriptorSets.clear();
+    }
+
+    m_boneRing.beginFrame(currentFrame);
+    m_device.profiler->count(Profiler::UniformDrops, m_boneRing.droppedLastFrame());
+
+    for (auto &[id, skinnedModel] : m_models) {
+        skinnedModel.seen = false;
+    }
+
+    std::vector<std::pair<SkinnedModel *, const DrawObject *>> changedModels;
+    for (size_t i = 0; i < models.size(); i++) {
+        const auto &model = models[i];
+        if (!model.skinned || model.vertexBuffer.buffer == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        SkinnedModel &skinnedModel = m_models[model.id];
+        skinnedModel.seen = true;
+
+        // kept for when it's drawn again, but there's no reason to skin it while it isn't
+        const RenderLod *lod = lods[i];
+        if (lod == nullptr || lod->vertexCount == 0) {
+            continue;
+        }
+
+        // the model is new, was reloaded into new buffers, switched to another LOD or has a palette of another size
+        if (skinnedModel.source != model.vertexBuffer.buffer || skinnedModel.firstVertex != lod->firstVertex
+            || skinnedModel.vertexCount != lod->vertexCount || skinnedModel.boneCount != model.boneData.size()) {
+            release(skinnedModel, currentFrame);
+            createSkinnedModel(skinnedModel, model, *lod);
+        }
+
+        if (skinnedModel.descriptorSet == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        if (!skinnedModel.skinned || skinnedModel.boneDataVersion != model.boneDataVersion) {
+            changedModels.emplace_back(&skinnedModel, &model);
+        }
+    }
+
+    for (auto it = m_models.begin(); it != m_models.end();) {
+        if (!it->second.seen) {
+            release(it->second, currentFrame);
+            it = m_models.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (changedModels.empty()) {
+        return;
+    }
+
+    // earlier frames may still be drawing the vertices that are about to be overwritten
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+    Profiler &profiler = *m_device.profiler;
+    profiler.count(Profiler::PipelineBinds);
+
+    for (auto [skinnedModel, model] : changedModels) {
+        const auto boneOffset = m_boneRing.push(model->boneData.data(), model->boneData.size() * sizeof(glm::mat3x4), boneDataSize(skinnedModel->boneCount));
+        if (!boneOffset) {
+            // it's skinned while drawing until there's room again
+            skinnedModel->skinned = false;
+            continue;
+        }
+
+        PushConstants pushConstants;
+        pushConstants.firstVertex = skinnedModel->firstVertex;
+        pushConstants.vertexCount = skinnedModel->vertexCount;
+        pushConstants.stride = sizeof(Vertex) / sizeof(uint32_t);
+        pushConstants.positionOffset = offsetof(Vertex, position) / sizeof(uint32_t);
+        pushConstants.normalOffset = offsetof(Vertex, normal) / sizeof(uint32_t);
+        pushConstants.bitangentOffset = offsetof(Vertex, bitangent) / sizeof(uint32_t);
+        pushConstants.boneWeightOffset = offsetof(Vertex, bone_weight) / sizeof(uint32_t);
+        pushConstants.boneIdOffset = offsetof(Vertex, bone_id) / sizeof(uint32_t);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &skinnedModel->descriptorSet, 1, &*boneOffset);
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+        vkCmdDispatch(commandBuffer, (pushConstants.vertexCount + 63) / 64, 1, 1);
+        profiler.count(Profiler::DescriptorBinds);
+        profiler.count(Profiler::Dispatches);
+
+        skinnedModel->boneDataVersion = model->boneDataVersion;
+        skinnedModel->skinned = true;
+    }
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+}
+
+SkinningPass::SkinnedVertices SkinningPass::skinnedVertices(const DrawObject &model) const
+{
+    if (!m_enabled || !model.skinned) {
+        return {};
+    }
+
+    const auto it = m_models.find(model.id);
+    if (it == m_models.end() || !it->second.skinned) {
+        return {};
+    }
+
+    return {it->second.vertices.buffer, static_cast<int32_t>(it->second.firstVertex)};
+}
+
+void SkinningPass::initPipeline()
+{
+    VkDescriptorPoolSize storagePoolSize = {};
+    storagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storagePoolSize.descriptorCount = maxSkinnedModels * 2;
+
+    VkDescriptorPoolSize dynamicStoragePoolSize = {};
+    dynamicStoragePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    dynamicStoragePoolSize.descriptorCount = maxSkinnedModels;
+
+    const std::array poolSizes = {storagePoolSize, dynamicStoragePoolSize};
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = maxSkinnedModels;
+
+    vkCreateDescriptorPool(m_device.device, &poolInfo, nullptr, &m_descriptorPool);
+
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindings.size();
+    layoutInfo.pBindings = bindings.data();
+
+    vkCreateDescriptorSetLayout(m_device.device, &layoutInfo, nullptr, &m_setLayout);
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    vkCreatePipelineLayout(m_device.device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = m_device.loadShaderFromDisk(":/shaders/skinning.comp.spv");
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    vkCreateComputePipelines(m_device.device, m_device.pipelineCache->handle(), 1, &pipelineInfo, nullptr, &m_pipeline);
+
+    vkDestroyShaderModule(m_device.device, pipelineInfo.stage.module, nullptr);
+}
+
+bool SkinningPass::createSkinnedModel(SkinnedModel &skinnedModel, const DrawObject &model, const RenderLod &lod)
+{
+    // also set when this fails, so it isn't tried again every frame
+    skinnedModel.source = model.vertexBuffer.buffer;
+    skinnedModel.firstVertex = lod.firstVertex;
+    skinnedModel.vertexCount = lod.vertexCount;
+    skinnedModel.boneCount = model.boneData.size();
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = m_descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &m_setLayout;
+
+    if (vkAllocateDescriptorSets(m_device.device, &allocateInfo, &skinnedModel.descriptorSet) != VK_SUCCESS) {
+        qWarning() << "Can't skin more than" << maxSkinnedModels << "models in a compute shader, the rest are skinned while drawing";
+        skinnedModel.descriptorSet = VK_NULL_HANDLE;
+        return false;
+    }
+
+    skinnedModel.vertices = m_device.createBuffer(lod.vertexCount * sizeof(Vertex),
+                                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+    bufferInfos[0] = {model.vertexBuffer.buffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[1] = {skinnedModel.vertices.buffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[2] = {m_boneRing.buffer(), 0, boneDataSize(skinnedModel.boneCount)};
+
+    std::array<VkWriteDescriptorSet, 3> writes = {};
+    for (uint32_t i = 0; i < writes.size(); i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = skinnedModel.descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = i == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(m_device.device, writes.size(), writes.data(), 0, nullptr);
+
+    return true;
+}
+
+void SkinningPass::release(SkinnedModel &skinnedModel, const uint32_t currentFrame)
+{
+    // frames that are still in flight may be drawing from these
+    if (skinnedModel.vertices.buffer != VK_NULL_HANDLE) {
+        m_retiredBuffers[currentFrame % m_retiredBuffers.size()].push_back(skinnedModel.vertices);
+    }
+
+    if (skinnedModel.descriptorSet != VK_NULL_HANDLE) {
+        m_retiredDescriptorSets[currentFrame % m_retiredDescriptorSets.size()].push_back(skinnedModel.descriptorSet);
+    }
+
+    skinnedModel = {};
+}
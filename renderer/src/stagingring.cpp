@@ -0,0 +1,178 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "stagingring.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "device.h"
+
+// keeps every copy offset aligned to the optimalBufferCopyOffsetAlignment of most hardware
+const VkDeviceSize copyAlignment = 16;
+
+StagingRing::StagingRing(Device &device, const VkDeviceSize size)
+    : m_device(device)
+{
+    m_buffer = m_device.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+}
+
+StagingRing::~StagingRing()
+{
+    m_device.destroyBuffer(m_buffer);
+}
+
+void StagingRing::uploadToBuffer(const Buffer &buffer, const void *data, const size_t size, const VkDeviceSize offset)
+{
+    if (size == 0) {
+        return;
+    }
+
+    const VkDeviceSize ringSize = m_buffer.size;
+    const VkDeviceSize alignedSize = (size + copyAlignment - 1) & ~(copyAlignment - 1);
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        // allocations can't straddle the end of the ring, so skip to the beginning if needed
+        VkDeviceSize start = m_head;
+        if ((start % ringSize) + alignedSize > ringSize) {
+            start += ringSize - (start % ringSize);
+        }
+
+        if (start + alignedSize - m_tail <= ringSize) {
+            const VkDeviceSize ringOffset = start % ringSize;
+            memcpy(static_cast<uint8_t *>(m_buffer.allocation.mapped) + ringOffset, data, size);
+
+            PendingCopy copy;
+            copy.destination = buffer.buffer;
+            copy.region.srcOffset = ringOffset;
+            copy.region.dstOffset = offset;
+            copy.region.size = size;
+            m_pendingCopies.push_back(copy);
+
+            m_head = start + alignedSize;
+            m_pendingBytes += size;
+            return;
+        }
+    }
+
+    uploadImmediately(buffer, data, size, offset);
+}
+
+void StagingRing::flush(VkCommandBuffer commandBuffer, const uint32_t frameIndex)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_frameHeads[frameIndex] = m_head;
+    m_lastFrameBytes = m_pendingBytes;
+    m_pendingBytes = 0;
+
+    if (m_pendingCopies.empty()) {
+        return;
+    }
+
+    // group copies into the same buffer, so they can be recorded in one command
+    std::stable_sort(m_pendingCopies.begin(), m_pendingCopies.end(), [](const PendingCopy &a, const PendingCopy &b) {
+        return a.destination < b.destination;
+    });
+
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < m_pendingCopies.size(); i++) {
+        regions.push_back(m_pendingCopies[i].region);
+
+        const bool lastOfDestination = i + 1 == m_pendingCopies.size() || m_pendingCopies[i + 1].destination != m_pendingCopies[i].destination;
+        if (lastOfDestination) {
+            vkCmdCopyBuffer(commandBuffer, m_buffer.buffer, m_pendingCopies[i].destination, regions.size(), regions.data());
+            regions.clear();
+        }
+    }
+
+    m_pendingCopies.clear();
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+}
+
+void StagingRing::cancel(VkBuffer buffer)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // their part of the ring is still released with the frame, like any other copy
+    m_pendingCopies.erase(std::remove_if(m_pendingCopies.begin(),
+                                         m_pendingCopies.end(),
+                                         [buffer](const PendingCopy &copy) {
+                                             return copy.destination == buffer;
+                                         }),
+                          m_pendingCopies.end());
+}
+
+void StagingRing::retireFrame(const uint32_t frameIndex)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_tail = std::max(m_tail, m_frameHeads[frameIndex]);
+}
+
+VkDeviceSize StagingRing::bytesUploadedLastFrame() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_lastFrameBytes;
+}
+
+void StagingRing::uploadImmediately(const Buffer &buffer, const void *data, const size_t size, const VkDeviceSize offset)
+{
+    auto stagingBuffer = m_device.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    m_device.copyToBuffer(stagingBuffer, const_cast<void *>(data), size);
+
+    VkCommandBuffer commandBuffer = m_device.beginSingleTimeCommands();
+
+    // earlier copies into the same buffer still waiting in the ring have to land first, or they would overwrite this one
+    {
+        QMutexLocker locker(&m_mutex);
+
+        std::vector<VkBufferCopy> earlierRegions;
+        auto firstLater = std::stable_partition(m_pendingCopies.begin(), m_pendingCopies.end(), [&buffer](const PendingCopy &copy) {
+            return copy.destination != buffer.buffer;
+        });
+        for (auto it = firstLater; it != m_pendingCopies.end(); ++it) {
+            earlierRegions.push_back(it->region);
+        }
+        m_pendingCopies.erase(firstLater, m_pendingCopies.end());
+
+        // their data stays in the ring until the next flushed frame retires, which is after this blocking copy
+        if (!earlierRegions.empty()) {
+            vkCmdCopyBuffer(commandBuffer, m_buffer.buffer, buffer.buffer, earlierRegions.size(), earlierRegions.data());
+
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    VkBufferCopy region = {};
+    region.dstOffset = offset;
+    region.size = size;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer.buffer, buffer.buffer, 1, &region);
+
+    m_device.endSingleTimeCommands(commandBuffer);
+
+    m_device.destroyBuffer(stagingBuffer);
+}
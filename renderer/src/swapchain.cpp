@@ -3,6 +3,9 @@
 
 #include "swapchain.h"
 
+#include <QDebug>
+#include <algorithm>
+
 #include "device.h"
 
 SwapChain::SwapChain(Device &device, VkSurfaceKHR surface, int width, int height)
@@ -11,6 +14,21 @@ SwapChain::SwapChain(Device &device, VkSurfaceKHR surface, int width, int height
     resize(surface, width, height);
 }
 
+SwapChain::SwapChain(Device &device, const int width, const int height)
+    : m_device(device)
+    , m_offscreen(true)
+{
+    // the same format a surface is usually created with, so the renderers don't behave any differently
+    surfaceFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    extent.width = width;
+    extent.height = height;
+
+    offscreenImage = m_device.createTexture(width, height, surfaceFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    swapchainImages = {offscreenImage.image};
+    swapchainViews = {offscreenImage.imageView};
+}
+
 void SwapChain::resize(VkSurfaceKHR surface, int width, int height)
 {
     vkQueueWaitIdle(m_device.presentQueue);
@@ -49,12 +67,7 @@ void SwapChain::resize(VkSurfaceKHR surface, int width, int height)
         }
     }
 
-    VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
-    for (const auto &availablePresentMode : presentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            swapchainPresentMode = availablePresentMode;
-        }
-    }
+    const VkPresentModeKHR swapchainPresentMode = choosePresentMode(presentModes);
 
     uint32_t imageCount = capabilities.minImageCount + 1;
     if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
@@ -79,6 +92,7 @@ void SwapChain::resize(VkSurfaceKHR surface, int width, int height)
     createInfo.clipped = VK_TRUE;
 
     surfaceFormat = swapchainSurfaceFormat.format;
+    presentMode = swapchainPresentMode;
 
     VkSwapchainKHR oldSwapchain = swapchain;
     createInfo.oldSwapchain = oldSwapchain;
@@ -115,17 +129,38 @@ void SwapChain::resize(VkSurfaceKHR surface, int width, int height)
 
         vkCreateImageView(m_device.device, &view_create_info, nullptr, &swapchainViews[i]);
     }
+}
 
-    VkSemaphoreCreateInfo semaphoreInfo = {};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+bool SwapChain::isOffscreen() const
+{
+    return m_offscreen;
+}
 
-    VkFenceCreateInfo fenceCreateInfo = {};
-    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+VkPresentModeKHR SwapChain::choosePresentMode(const std::vector<VkPresentModeKHR> &presentModes) const
+{
+    const auto isAvailable = [&presentModes](const VkPresentModeKHR mode) {
+        return std::find(presentModes.cbegin(), presentModes.cend(), mode) != presentModes.cend();
+    };
+
+    const QByteArray requested = qgetenv("NOVUS_PRESENT_MODE");
+    if (!requested.isEmpty()) {
+        VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
+        if (requested == QByteArrayLiteral("mailbox")) {
+            mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        } else if (requested == QByteArrayLiteral("immediate")) {
+            mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        } else if (requested != QByteArrayLiteral("fifo")) {
+            qWarning() << "Unknown present mode" << requested << ", expected fifo, mailbox or immediate";
+        }
+
+        // FIFO is the only mode every device has to support
+        if (isAvailable(mode)) {
+            return mode;
+        }
 
-    for (size_t i = 0; i < 3; i++) {
-        vkCreateSemaphore(m_device.device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]);
-        vkCreateSemaphore(m_device.device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]);
-        vkCreateFence(m_device.device, &fenceCreateInfo, nullptr, &inFlightFences[i]);
+        qWarning() << "Present mode" << requested << "isn't supported, falling back to fifo";
+        return VK_PRESENT_MODE_FIFO_KHR;
     }
+
+    return isAvailable(VK_PRESENT_MODE_MAILBOX_KHR) ? VK_PRESENT_MODE_MAILBOX_KHR : VK_PRESENT_MODE_FIFO_KHR;
 }
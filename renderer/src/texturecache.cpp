@@ -0,0 +1,157 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "texturecache.h"
+
+#include <QDebug>
+
+#include "framescheduler.h"
+#include "memoryallocator.h"
+#include "rendermanager.h"
+#include "textureuploader.h"
+
+// how much memory textures without any references may keep using, before the least recently used are destroyed
+const VkDeviceSize unusedBudget = 256 * 1024 * 1024;
+
+TextureCache::TextureCache(RenderManager &renderer)
+    : m_renderer(renderer)
+{
+}
+
+TextureCache::~TextureCache()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (const auto &entry : m_entries) {
+        if (entry.refCount > 0) {
+            qWarning() << "Texture" << m_paths.value(entry.texture) << "is still referenced while the cache is destroyed";
+        }
+        destroy(entry.texture);
+    }
+
+    m_entries.clear();
+    m_paths.clear();
+    m_unused.clear();
+    m_unusedBytes = 0;
+}
+
+RenderTexture *TextureCache::acquire(const QString &path, const std::function<physis_Buffer()> &loadFile)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_entries.find(path);
+    while (it != m_entries.end() && it->loading) {
+        m_loadFinished.wait(&m_mutex);
+        it = m_entries.find(path);
+    }
+
+    if (it != m_entries.end()) {
+        if (it->refCount == 0) {
+            m_unused.erase(it->unused);
+            m_unusedBytes -= it->texture->allocation.size;
+        }
+
+        it->refCount++;
+        return it->texture;
+    }
+
+    // claim it, so other threads asking for the same texture wait for this load instead of starting their own
+    Entry loadingEntry;
+    loadingEntry.loading = true;
+    m_entries[path] = loadingEntry;
+
+    // loading and uploading happens outside of the lock, so different textures can be loaded in parallel
+    locker.unlock();
+    const auto texture = m_renderer.addGameTexture(loadFile());
+    locker.relock();
+
+    if (texture.handle == VK_NULL_HANDLE) {
+        m_entries.remove(path);
+        m_loadFinished.wakeAll();
+        return nullptr;
+    }
+
+    Entry &entry = m_entries[path];
+    entry.texture = new RenderTexture(texture);
+    entry.refCount = 1;
+    entry.loading = false;
+
+    m_paths[entry.texture] = path;
+
+    m_loadFinished.wakeAll();
+
+    return entry.texture;
+}
+
+void TextureCache::release(RenderTexture *texture)
+{
+    if (texture == nullptr) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    const auto path = m_paths.value(texture);
+    auto it = m_entries.find(path);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    if (it->refCount <= 0) {
+        qWarning() << "Texture" << path << "was released more times than it was acquired";
+        return;
+    }
+
+    it->refCount--;
+    if (it->refCount == 0) {
+        it->unused = m_unused.insert(m_unused.end(), path);
+        m_unusedBytes += texture->allocation.size;
+
+        evict();
+    }
+}
+
+qsizetype TextureCache::residentCount()
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_entries.size();
+}
+
+void TextureCache::evict()
+{
+    while (m_unusedBytes > unusedBudget && !m_unused.empty()) {
+        const QString path = m_unused.front();
+        m_unused.pop_front();
+
+        const Entry entry = m_entries.take(path);
+        m_paths.remove(entry.texture);
+        m_unusedBytes -= entry.texture->allocation.size;
+
+        destroy(entry.texture);
+    }
+}
+
+void TextureCache::destroy(RenderTexture *texture)
+{
+    if (texture == nullptr) {
+        return;
+    }
+
+    // frames in flight may still sample it, and its upload may not even be finished yet
+    RenderManager *renderer = &m_renderer;
+    Device *device = &m_renderer.device();
+    device->frameScheduler->retire([renderer, device, texture] {
+        device->textureUploader->wait(texture->uploadValue);
+
+        // the descriptor sets pointing at its view go first, so none are left for a texture created later
+        renderer->textureDestroyed(texture->id);
+
+        vkDestroyImageView(device->device, texture->view, nullptr);
+        vkDestroyImage(device->device, texture->handle, nullptr);
+        device->allocator->free(texture->allocation);
+
+        // the sampler belongs to the SamplerCache
+        delete texture;
+    });
+}
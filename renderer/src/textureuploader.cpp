@@ -0,0 +1,260 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "textureuploader.h"
+
+#include <cstring>
+#include <limits>
+
+#include "device.h"
+
+// if this much data is waiting, submit it right away instead of waiting for the next frame
+const size_t maxPendingBytes = 64 * 1024 * 1024;
+
+TextureUploader::TextureUploader(Device &device)
+    : m_device(device)
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = m_device.transferFamilyIndex;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    vkCreateCommandPool(m_device.device, &poolInfo, nullptr, &m_commandPool);
+
+    VkSemaphoreTypeCreateInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    vkCreateSemaphore(m_device.device, &semaphoreInfo, nullptr, &m_semaphore);
+}
+
+TextureUploader::~TextureUploader()
+{
+    submit();
+    wait(m_nextValue - 1);
+
+    vkDestroySemaphore(m_device.device, m_semaphore, nullptr);
+    vkDestroyCommandPool(m_device.device, m_commandPool, nullptr);
+}
+
+uint64_t TextureUploader::queueUpload(VkImage image, const uint32_t mipLevels, const std::vector<VkBufferImageCopy> &regions, const void *data, const size_t size)
+{
+    // the staging copy is done outside of the lock, so multiple threads can fill their buffers at once
+    PendingUpload upload;
+    upload.image = image;
+    upload.mipLevels = mipLevels;
+    upload.stagingBuffer = m_device.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    upload.regions = regions;
+
+    memcpy(upload.stagingBuffer.allocation.mapped, data, size);
+
+    uint64_t value;
+    bool shouldSubmit;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        value = m_nextValue;
+        m_pendingUploads.push_back(std::move(upload));
+        m_pendingBytes += size;
+
+        shouldSubmit = m_pendingBytes > maxPendingBytes;
+    }
+
+    if (shouldSubmit) {
+        submit();
+    }
+
+    return value;
+}
+
+void TextureUploader::submit()
+{
+    QMutexLocker locker(&m_mutex);
+
+    collectFinishedBatches();
+
+    if (m_pendingUploads.empty()) {
+        return;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    Batch batch;
+    batch.value = m_nextValue;
+    vkAllocateCommandBuffers(m_device.device, &allocInfo, &batch.commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+    // this may be a transfer-only queue, so these barriers can only reference transfer stages
+    // the graphics queue waits on the timeline semaphore before sampling, which makes the writes visible
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.reserve(m_pendingUploads.size());
+
+    for (const auto &upload : m_pendingUploads) {
+        VkImageMemoryBarrier &barrier = barriers.emplace_back();
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.image = upload.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = upload.mipLevels;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    vkCmdPipelineBarrier(batch.commandBuffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         barriers.size(),
+                         barriers.data());
+
+    for (const auto &upload : m_pendingUploads) {
+        vkCmdCopyBufferToImage(batch.commandBuffer,
+                               upload.stagingBuffer.buffer,
+                               upload.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               upload.regions.size(),
+                               upload.regions.data());
+    }
+
+    for (auto &barrier : barriers) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier(batch.commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         barriers.size(),
+                         barriers.data());
+
+    vkEndCommandBuffer(batch.commandBuffer);
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_semaphore;
+
+    {
+        QMutexLocker queueLocker(&m_device.queueMutex);
+        vkQueueSubmit(m_device.transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    }
+
+    for (auto &upload : m_pendingUploads) {
+        batch.stagingBuffers.push_back(upload.stagingBuffer);
+    }
+
+    m_batches.push_back(std::move(batch));
+    m_pendingUploads.clear();
+    m_pendingBytes = 0;
+    m_nextValue++;
+}
+
+bool TextureUploader::isComplete(const uint64_t value) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return value <= m_completedValue;
+}
+
+void TextureUploader::wait(const uint64_t value)
+{
+    if (value == 0) {
+        return;
+    }
+
+    bool pending;
+    {
+        QMutexLocker locker(&m_mutex);
+        pending = value >= m_nextValue;
+    }
+
+    if (pending) {
+        submit();
+    }
+
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_semaphore;
+    waitInfo.pValues = &value;
+
+    vkWaitSemaphores(m_device.device, &waitInfo, std::numeric_limits<uint64_t>::max());
+
+    QMutexLocker locker(&m_mutex);
+    collectFinishedBatches();
+}
+
+bool TextureUploader::isIdle() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_pendingUploads.empty() && m_batches.empty();
+}
+
+uint64_t TextureUploader::completedValue() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_completedValue;
+}
+
+VkSemaphore TextureUploader::semaphore() const
+{
+    return m_semaphore;
+}
+
+void TextureUploader::collectFinishedBatches()
+{
+    vkGetSemaphoreCounterValue(m_device.device, m_semaphore, &m_completedValue);
+
+    auto it = m_batches.begin();
+    while (it != m_batches.end()) {
+        if (it->value > m_completedValue) {
+            ++it;
+            continue;
+        }
+
+        for (auto &stagingBuffer : it->stagingBuffers) {
+            m_device.destroyBuffer(stagingBuffer);
+        }
+        vkFreeCommandBuffers(m_device.device, m_commandPool, 1, &it->commandBuffer);
+
+        it = m_batches.erase(it);
+    }
+}
@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "uniformring.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "device.h"
+
+UniformRing::UniformRing(Device &device, const VkDeviceSize sizePerFrame)
+    : m_device(device)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_device.physicalDevice, &properties);
+
+    m_alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+    m_regionSize = (sizePerFrame + m_alignment - 1) & ~(m_alignment - 1);
+
+    m_buffer = m_device.createBuffer(m_regionSize * m_regions.size(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+}
+
+UniformRing::~UniformRing()
+{
+    m_device.destroyBuffer(m_buffer);
+}
+
+void UniformRing::beginFrame(const uint32_t frameIndex)
+{
+    m_lastFrameBytes = m_bytesWritten;
+    m_bytesWritten = 0;
+    m_lastFrameDropped = m_dropped;
+    m_dropped = 0;
+    m_currentRegion = frameIndex;
+
+    // a full ring stays full every frame, so only warn every few seconds
+    if (m_lastFrameDropped > 0 && (!m_dropWarningTimer.isValid() || m_dropWarningTimer.hasExpired(5000))) {
+        qWarning() << "Uniform ring is full," << m_lastFrameDropped << "pushes didn't fit into the last frame's" << m_regionSize << "bytes and were dropped";
+        m_dropWarningTimer.start();
+    }
+
+    // keyed data stays around so it can be reused, but once the region is half full everything is thrown out
+    // this leaves at least half of the region for the frame that is about to be recorded
+    auto &region = m_regions[m_currentRegion];
+    if (region.head > m_regionSize / 2) {
+        region.head = 0;
+        region.entries.clear();
+    }
+}
+
+std::optional<uint32_t> UniformRing::push(const void *data, const size_t size, const size_t reservedSize)
+{
+    auto &region = m_regions[m_currentRegion];
+
+    const VkDeviceSize alignedSize = (std::max(size, reservedSize) + m_alignment - 1) & ~(m_alignment - 1);
+    if (region.head + alignedSize > m_regionSize) {
+        m_dropped++;
+        return std::nullopt;
+    }
+
+    const VkDeviceSize offset = m_regionSize * m_currentRegion + region.head;
+    memcpy(static_cast<uint8_t *>(m_buffer.allocation.mapped) + offset, data, size);
+
+    region.head += alignedSize;
+    m_bytesWritten += size;
+
+    return static_cast<uint32_t>(offset);
+}
+
+std::optional<uint32_t> UniformRing::push(const uint64_t key, const uint64_t version, const void *data, const size_t size, const size_t reservedSize)
+{
+    const auto offset = push(data, size, reservedSize);
+    if (offset) {
+        m_regions[m_currentRegion].entries[key] = Entry{version, *offset};
+    }
+
+    return offset;
+}
+
+std::optional<uint32_t> UniformRing::find(const uint64_t key, const uint64_t version) const
+{
+    const auto &entries = m_regions[m_currentRegion].entries;
+    if (const auto it = entries.find(key); it != entries.cend() && it->second.version == version) {
+        return it->second.offset;
+    }
+
+    return std::nullopt;
+}
+
+VkBuffer UniformRing::buffer() const
+{
+    return m_buffer.buffer;
+}
+
+VkDeviceSize UniformRing::bytesWrittenLastFrame() const
+{
+    return m_lastFrameBytes;
+}
+
+uint32_t UniformRing::droppedLastFrame() const
+{
+    return m_lastFrameDropped;
+}
+
+uint64_t UniformRing::nextVersion()
+{
+    // DrawObjects are copied around freely, so versions are unique across all of them instead of per object
+    static std::atomic<uint64_t> version = 1;
+    return version++;
+}
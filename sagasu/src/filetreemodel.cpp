@@ -4,6 +4,7 @@
 #include "filetreemodel.h"
 #include "filetypes.h"
 #include "physis.hpp"
+#include "trace.h"
 
 #include <KLocalizedString>
 #include <QIcon>
@@ -15,6 +16,8 @@ FileTreeModel::FileTreeModel(HashDatabase &database, bool showUnknown, const QSt
     , m_showUnknown(showUnknown)
     , m_database(database)
 {
+    NOVUS_TRACE_SCOPE("FileTreeModel::FileTreeModel");
+
     rootItem = new TreeInformation();
     rootItem->type = TreeType::Root;
 
@@ -0,0 +1,267 @@
+// SPDX-FileCopyrightText: 2024 Joshua Goins <josh@redstrate.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QThread>
+#include <QtConcurrent>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <physis.hpp>
+#include <physis_logger.h>
+
+#include "rendermanager.h"
+#include "settings.h"
+#include "trace.h"
+
+struct ThumbnailJob {
+    // the name of the PNG, without the extension
+    QString name;
+    // a path in the game data, or a loose file on disk
+    QString path;
+};
+
+struct LoadedModel {
+    physis_MDL mdl{};
+    qint64 loadNsecs = 0;
+};
+
+/// Turns the rows at positions @p first to @p last (inclusive) of the Item sheet into the model they equip, as a Hyur Midlander male.
+static std::vector<ThumbnailJob> itemJobs(GameData *data, const int first, const int last)
+{
+    std::vector<ThumbnailJob> jobs;
+
+    auto exh = physis_parse_excel_sheet_header(physis_gamedata_extract_file(data, "exd/item.exh"));
+    if (exh == nullptr) {
+        qWarning() << "Failed to read the Item sheet header";
+        return jobs;
+    }
+
+    int position = 0;
+    for (uint32_t page = 0; page < exh->page_count && position <= last; page++) {
+        const auto exd = physis_gamedata_read_excel_sheet(data, "Item", exh, Language::English, page);
+
+        for (unsigned int i = 0; i < exd.row_count && position <= last; i++, position++) {
+            if (position < first) {
+                continue;
+            }
+
+            // same columns as GearListModel in Armoury
+            const auto row = exd.row_data[i];
+            const auto primaryModel = row.column_data[47].u_int64._0;
+
+            int16_t parts[4];
+            memcpy(parts, &primaryModel, sizeof(int16_t) * 4);
+
+            if (parts[0] == 0) {
+                continue;
+            }
+
+            const Slot slot = physis_slot_from_id(row.column_data[17].u_int8._0);
+
+            jobs.push_back({QStringLiteral("item_%1").arg(position),
+                            QLatin1String(physis_build_equipment_path(parts[0], Race::Hyur, Subrace::Midlander, Gender::Male, slot))});
+        }
+    }
+
+    return jobs;
+}
+
+/// Points the camera at @p model, so its bounding sphere fills the image.
+static void frameModel(Camera &camera, const DrawObject &model)
+{
+    const BoundingSphere &sphere = model.boundingSphere;
+    const float radius = std::max(sphere.radius, 0.01f);
+    const float distance = radius / std::sin(glm::radians(camera.fieldOfView) * 0.5f);
+
+    camera.nearPlane = std::max(distance - radius * 2.0f, 0.01f);
+    camera.farPlane = distance + radius * 2.0f;
+
+    // the same up vector as MDLPart, so the thumbnails match what the viewers show
+    camera.view = glm::lookAt(sphere.center + glm::vec3(0.0f, 0.0f, distance), sphere.center, glm::vec3(0, -1, 0));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    setup_physis_logging();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Renders MDL files to PNG thumbnails, without needing a window."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("paths"), QStringLiteral("Game paths or loose MDL files to render."), QStringLiteral("[paths...]"));
+
+    QCommandLineOption itemsOption(QStringLiteral("items"),
+                                   QStringLiteral("Also render the models equipped by these rows of the Item sheet, for example 1600-1700."),
+                                   QStringLiteral("first-last"));
+    parser.addOption(itemsOption);
+
+    QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Directory to write the thumbnails to."), QStringLiteral("dir"), QStringLiteral("."));
+    parser.addOption(outputOption);
+
+    QCommandLineOption sizeOption(QStringLiteral("size"), QStringLiteral("Width and height of each thumbnail."), QStringLiteral("pixels"), QStringLiteral("256"));
+    parser.addOption(sizeOption);
+
+    QCommandLineOption lodOption(QStringLiteral("lod"), QStringLiteral("Level of detail to render."), QStringLiteral("lod"), QStringLiteral("0"));
+    parser.addOption(lodOption);
+
+    QCommandLineOption gameOption(QStringLiteral("game"),
+                                  QStringLiteral("Game directory, instead of the one set in the Novus SDK launcher."),
+                                  QStringLiteral("dir"));
+    parser.addOption(gameOption);
+
+    QCommandLineOption traceOption(QStringLiteral("trace"), QStringLiteral("Write a Chrome trace of loading and rendering to this file."), QStringLiteral("file"));
+    parser.addOption(traceOption);
+
+    parser.process(app);
+
+    if (parser.isSet(traceOption)) {
+        startTracing(parser.value(traceOption));
+    }
+
+    const QString gameDir = parser.isSet(gameOption) ? parser.value(gameOption) : getGameDirectory();
+    const std::string gameDirStd = gameDir.toStdString();
+    GameData *data = physis_gamedata_initialize(gameDirStd.c_str());
+
+    std::vector<ThumbnailJob> jobs;
+    for (const QString &path : parser.positionalArguments()) {
+        jobs.push_back({QFileInfo(path).completeBaseName(), path});
+    }
+
+    if (parser.isSet(itemsOption)) {
+        const QStringList range = parser.value(itemsOption).split(QLatin1Char('-'));
+        bool firstValid = false, lastValid = false;
+        const int first = range.value(0).toInt(&firstValid);
+        const int last = range.size() > 1 ? range.value(1).toInt(&lastValid) : first;
+
+        if (!firstValid || (range.size() > 1 && !lastValid) || last < first) {
+            qWarning() << "Invalid item range" << parser.value(itemsOption);
+            return 1;
+        }
+
+        const auto items = itemJobs(data, first, last);
+        jobs.insert(jobs.end(), items.begin(), items.end());
+    }
+
+    if (jobs.empty()) {
+        parser.showHelp(1);
+    }
+
+    const QDir outputDir(parser.value(outputOption));
+    if (!outputDir.mkpath(QStringLiteral("."))) {
+        qWarning() << "Failed to create" << outputDir.path();
+        return 1;
+    }
+
+    const int size = std::max(parser.value(sizeOption).toInt(), 1);
+    const int lod = parser.value(lodOption).toInt();
+
+    // one device renders every thumbnail, while the models are read and parsed on other threads
+    RenderManager renderer(data);
+    if (!renderer.initOffscreen(size, size)) {
+        return 1;
+    }
+
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+
+    std::function<LoadedModel(const ThumbnailJob &)> loadModel = [data](const ThumbnailJob &job) -> LoadedModel {
+        NOVUS_TRACE_SCOPE("Load model", job.path);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        const std::string pathStd = job.path.toStdString();
+        const physis_Buffer buffer = QFileInfo::exists(job.path) ? physis_read_file(pathStd.c_str()) : physis_gamedata_extract_file(data, pathStd.c_str());
+
+        LoadedModel loaded;
+        if (buffer.data != nullptr) {
+            loaded.mdl = physis_mdl_parse(buffer);
+        }
+        loaded.loadNsecs = timer.nsecsElapsed();
+
+        return loaded;
+    };
+
+    // the future keeps every result until it's destroyed, so models are loaded a batch at a time instead of all at once
+    const size_t batchSize = static_cast<size_t>(std::max(QThread::idealThreadCount(), 1)) * 2;
+    const auto loadBatch = [&jobs, &loadModel, batchSize](const size_t first) {
+        const auto begin = jobs.cbegin() + static_cast<std::ptrdiff_t>(first);
+        const auto end = jobs.cbegin() + static_cast<std::ptrdiff_t>(std::min(first + batchSize, jobs.size()));
+        return QtConcurrent::mapped(begin, end, loadModel);
+    };
+
+    int rendered = 0;
+    qint64 loadNsecs = 0;
+    qint64 renderNsecs = 0;
+
+    QFuture<LoadedModel> nextBatch = loadBatch(0);
+    for (size_t first = 0; first < jobs.size(); first += batchSize) {
+        // the next batch loads while this one is rendered, so at most two batches of models are parsed at a time
+        const QFuture<LoadedModel> batch = nextBatch;
+        if (first + batchSize < jobs.size()) {
+            nextBatch = loadBatch(first + batchSize);
+        }
+
+        const size_t count = std::min(batchSize, jobs.size() - first);
+        for (size_t i = 0; i < count; i++) {
+            const ThumbnailJob &job = jobs[first + i];
+            const LoadedModel loaded = batch.resultAt(static_cast<int>(i));
+            loadNsecs += loaded.loadNsecs;
+
+            if (loaded.mdl.p_ptr == nullptr || loaded.mdl.num_lod == 0) {
+                qWarning() << "Failed to load" << job.path;
+                continue;
+            }
+
+            NOVUS_TRACE_SCOPE("Render thumbnail", job.name);
+
+            QElapsedTimer renderTimer;
+            renderTimer.start();
+
+            DrawObject model = renderer.addDrawObject(loaded.mdl, std::min(lod, static_cast<int>(loaded.mdl.num_lod) - 1));
+            model.name = job.name;
+            model.position = glm::vec3(0.0f);
+
+            // thumbnails are untextured, the same default material MDLPart uses when a model has none
+            RenderMaterial &material = model.materials.emplace_back();
+            renderer.prepareMaterial(material);
+
+            frameModel(renderer.camera, model);
+
+            const QByteArray pixels = renderer.renderOffscreen({model});
+            renderer.releaseDrawObject(loaded.mdl);
+
+            renderNsecs += renderTimer.nsecsElapsed();
+
+            if (pixels.isEmpty()) {
+                qWarning() << "Failed to render" << job.path;
+                continue;
+            }
+
+            // BGRA8 is laid out the same as QImage's 32-bit formats on little endian machines
+            const QImage image(reinterpret_cast<const uchar *>(pixels.constData()), size, size, size * 4, QImage::Format_RGB32);
+
+            const QString fileName = outputDir.filePath(job.name + QStringLiteral(".png"));
+            if (!image.save(fileName)) {
+                qWarning() << "Failed to write" << fileName;
+                continue;
+            }
+
+            rendered++;
+        }
+    }
+
+    const double seconds = totalTimer.nsecsElapsed() / 1000000000.0;
+    qInfo() << "Rendered" << rendered << "of" << jobs.size() << "thumbnails in" << seconds << "s," << rendered / seconds << "thumbnails per second";
+    qInfo() << "Loading took" << loadNsecs / 1000000.0 << "ms across all threads, rendering took" << renderNsecs / 1000000.0 << "ms";
+
+    stopTracing();
+
+    return rendered == static_cast<int>(jobs.size()) ? 0 : 1;
+}